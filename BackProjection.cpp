@@ -0,0 +1,376 @@
+/*
+ * File:   BackProjection.cpp
+ * Author: Jan Dufek
+ */
+
+#include "BackProjection.hpp"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BACK_PROJECTION_X86
+#include <immintrin.h>
+#endif
+
+// Fixed point precision of the HSV conversion, the same as in OpenCV
+#define HSV_SHIFT 12
+
+/**
+ * Back projection of one row. Scalar version, used also for the ends of rows
+ * in the SIMD versions.
+ *
+ * @param BGR BGR pixels
+ * @param back_projection output
+ * @param start first pixel
+ * @param end pixel after the last one
+ * @param gate_table saturation and value gate
+ * @param hue_table hue to back projection
+ * @param hue_division_table
+ */
+static void back_project_row_scalar(const uchar * BGR, uchar * back_projection, int start, int end, const uchar * gate_table, const uchar * hue_table, const int * hue_division_table) {
+
+    for (int x = start; x < end; x++) {
+
+        int b = BGR[3 * x];
+        int g = BGR[3 * x + 1];
+        int r = BGR[3 * x + 2];
+
+        int value = max(b, max(g, r));
+        int difference = value - min(b, min(g, r));
+
+        if (!gate_table[(value << 8) | difference]) {
+            back_projection[x] = 0;
+            continue;
+        }
+
+        // Hue the same way as OpenCV computes it
+        int value_is_red = value == r ? -1 : 0;
+        int value_is_green = value == g ? -1 : 0;
+
+        int hue = (value_is_red & (g - b)) + (~value_is_red & ((value_is_green & (b - r + 2 * difference)) + ((~value_is_green) & (r - g + 4 * difference))));
+        hue = (hue * hue_division_table[difference] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+        hue += hue < 0 ? 180 : 0;
+
+        back_projection[x] = hue_table[hue];
+    }
+}
+
+#ifdef BACK_PROJECTION_X86
+
+/**
+ * Back projection of one row using SSE4.1. Four pixels at a time. Table look
+ * ups are done per lane as SSE has no gather.
+ *
+ */
+__attribute__((target("sse4.1")))
+static void back_project_row_sse41(const uchar * BGR, uchar * back_projection, int cols, const uchar * gate_table, const uchar * hue_table, const int * hue_division_table) {
+
+    const __m128i blue_shuffle = _mm_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1);
+    const __m128i green_shuffle = _mm_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1);
+    const __m128i red_shuffle = _mm_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+    const __m128i rounding = _mm_set1_epi32(1 << (HSV_SHIFT - 1));
+    const __m128i hue_range = _mm_set1_epi32(180);
+    const __m128i zero = _mm_setzero_si128();
+
+    alignas(16) int value_lanes[4];
+    alignas(16) int difference_lanes[4];
+    alignas(16) int hue_lanes[4];
+
+    int x = 0;
+
+    // 16 bytes are loaded for 4 pixels, so stop before the end of the row
+    for (; x + 6 <= cols; x += 4) {
+
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (BGR + 3 * x));
+
+        __m128i b = _mm_shuffle_epi8(pixels, blue_shuffle);
+        __m128i g = _mm_shuffle_epi8(pixels, green_shuffle);
+        __m128i r = _mm_shuffle_epi8(pixels, red_shuffle);
+
+        __m128i value = _mm_max_epi32(b, _mm_max_epi32(g, r));
+        __m128i difference = _mm_sub_epi32(value, _mm_min_epi32(b, _mm_min_epi32(g, r)));
+
+        _mm_store_si128((__m128i *) value_lanes, value);
+        _mm_store_si128((__m128i *) difference_lanes, difference);
+
+        __m128i hue_division = _mm_setr_epi32(hue_division_table[difference_lanes[0]], hue_division_table[difference_lanes[1]], hue_division_table[difference_lanes[2]], hue_division_table[difference_lanes[3]]);
+
+        __m128i value_is_red = _mm_cmpeq_epi32(value, r);
+        __m128i value_is_green = _mm_cmpeq_epi32(value, g);
+
+        __m128i difference_2 = _mm_add_epi32(difference, difference);
+        __m128i hue_red = _mm_sub_epi32(g, b);
+        __m128i hue_green = _mm_add_epi32(_mm_sub_epi32(b, r), difference_2);
+        __m128i hue_blue = _mm_add_epi32(_mm_sub_epi32(r, g), _mm_add_epi32(difference_2, difference_2));
+
+        __m128i hue = _mm_add_epi32(_mm_and_si128(value_is_red, hue_red), _mm_andnot_si128(value_is_red, _mm_add_epi32(_mm_and_si128(value_is_green, hue_green), _mm_andnot_si128(value_is_green, hue_blue))));
+        hue = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(hue, hue_division), rounding), HSV_SHIFT);
+        hue = _mm_add_epi32(hue, _mm_and_si128(_mm_cmpgt_epi32(zero, hue), hue_range));
+
+        _mm_store_si128((__m128i *) hue_lanes, hue);
+
+        for (int i = 0; i < 4; i++) {
+            back_projection[x + i] = hue_table[hue_lanes[i]] & gate_table[(value_lanes[i] << 8) | difference_lanes[i]];
+        }
+    }
+
+    back_project_row_scalar(BGR, back_projection, x, cols, gate_table, hue_table, hue_division_table);
+}
+
+/**
+ * Back projection of one row using AVX2. Eight pixels at a time, table look
+ * ups use gathers.
+ *
+ */
+__attribute__((target("avx2")))
+static void back_project_row_avx2(const uchar * BGR, uchar * back_projection, int cols, const uchar * gate_table, const uchar * hue_table, const int * hue_division_table) {
+
+    const __m256i pixel_offsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+    const __m256i rounding = _mm256_set1_epi32(1 << (HSV_SHIFT - 1));
+    const __m256i hue_range = _mm256_set1_epi32(180);
+    const __m256i zero = _mm256_setzero_si256();
+
+    // Moves the lowest byte of each 32 bit lane to the beginning of its 128 bit half
+    const __m256i pack_shuffle = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    int x = 0;
+
+    // Each gather reads 4 bytes per pixel, so stop before the end of the row
+    for (; x + 8 < cols; x += 8) {
+
+        __m256i pixels = _mm256_i32gather_epi32((const int *) (BGR + 3 * x), pixel_offsets, 1);
+
+        __m256i b = _mm256_and_si256(pixels, byte_mask);
+        __m256i g = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byte_mask);
+        __m256i r = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), byte_mask);
+
+        __m256i value = _mm256_max_epi32(b, _mm256_max_epi32(g, r));
+        __m256i difference = _mm256_sub_epi32(value, _mm256_min_epi32(b, _mm256_min_epi32(g, r)));
+
+        // Saturation and value gate
+        __m256i gate = _mm256_and_si256(_mm256_i32gather_epi32((const int *) gate_table, _mm256_or_si256(_mm256_slli_epi32(value, 8), difference), 1), byte_mask);
+
+        __m256i value_is_red = _mm256_cmpeq_epi32(value, r);
+        __m256i value_is_green = _mm256_cmpeq_epi32(value, g);
+
+        __m256i difference_2 = _mm256_add_epi32(difference, difference);
+        __m256i hue_red = _mm256_sub_epi32(g, b);
+        __m256i hue_green = _mm256_add_epi32(_mm256_sub_epi32(b, r), difference_2);
+        __m256i hue_blue = _mm256_add_epi32(_mm256_sub_epi32(r, g), _mm256_add_epi32(difference_2, difference_2));
+
+        __m256i hue = _mm256_add_epi32(_mm256_and_si256(value_is_red, hue_red), _mm256_andnot_si256(value_is_red, _mm256_add_epi32(_mm256_and_si256(value_is_green, hue_green), _mm256_andnot_si256(value_is_green, hue_blue))));
+        __m256i hue_division = _mm256_i32gather_epi32(hue_division_table, difference, 4);
+        hue = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(hue, hue_division), rounding), HSV_SHIFT);
+        hue = _mm256_add_epi32(hue, _mm256_and_si256(_mm256_cmpgt_epi32(zero, hue), hue_range));
+
+        __m256i result = _mm256_and_si256(_mm256_i32gather_epi32((const int *) hue_table, hue, 1), gate);
+
+        // Store the lowest bytes of the lanes
+        result = _mm256_shuffle_epi8(result, pack_shuffle);
+        int low = _mm_cvtsi128_si32(_mm256_castsi256_si128(result));
+        int high = _mm_cvtsi128_si32(_mm256_extracti128_si256(result, 1));
+        memcpy(back_projection + x, &low, 4);
+        memcpy(back_projection + x + 4, &high, 4);
+    }
+
+    back_project_row_scalar(BGR, back_projection, x, cols, gate_table, hue_table, hue_division_table);
+}
+
+#endif
+
+BackProjection::BackProjection() {
+
+    // Same tables as OpenCV uses for 8-bit BGR to HSV conversion
+    saturation_division_table[0] = 0;
+    hue_division_table[0] = 0;
+    for (int i = 1; i < 256; i++) {
+        saturation_division_table[i] = saturate_cast<int> ((255 << HSV_SHIFT) / (1. * i));
+        hue_division_table[i] = saturate_cast<int> ((180 << HSV_SHIFT) / (6. * i));
+    }
+
+    memset(gate_table, 0, sizeof (gate_table));
+    memset(hue_table, 0, sizeof (hue_table));
+
+    gate_saturation_min = -1;
+    gate_saturation_max = -1;
+    gate_value_min = -1;
+    gate_value_max = -1;
+
+    // Best supported instruction set
+    instruction_set = BACK_PROJECTION_SCALAR;
+    set_instruction_set(BACK_PROJECTION_AVX2);
+}
+
+BackProjection::BackProjection(const BackProjection& orig) {
+}
+
+BackProjection::~BackProjection() {
+}
+
+/**
+ * Compute back projection of the BGR frame.
+ *
+ * @param BGR_frame blured frame
+ * @param hue_lookup_table 1x256 back projection of each hue, see create_hue_table
+ * @param equalization_table 1x256 value equalization look up table
+ * @param saturation_min
+ * @param saturation_max
+ * @param value_min minimum of equalized value
+ * @param value_max maximum of equalized value
+ * @param back_projection
+ */
+void BackProjection::compute(const Mat& BGR_frame, const Mat& hue_lookup_table, const Mat& equalization_table, int saturation_min, int saturation_max, int value_min, int value_max, Mat& back_projection) {
+
+    CV_Assert(BGR_frame.type() == CV_8UC3 && hue_lookup_table.total() == 256 && equalization_table.total() == 256);
+
+    update_gate_table(equalization_table, saturation_min, saturation_max, value_min, value_max);
+
+    memcpy(hue_table, hue_lookup_table.ptr(), 256);
+
+    back_projection.create(BGR_frame.size(), CV_8U);
+
+    for (int row = 0; row < BGR_frame.rows; row++) {
+
+        const uchar * BGR = BGR_frame.ptr(row);
+        uchar * output = back_projection.ptr(row);
+
+        switch (instruction_set) {
+
+#ifdef BACK_PROJECTION_X86
+
+            case BACK_PROJECTION_AVX2:
+                back_project_row_avx2(BGR, output, BGR_frame.cols, gate_table, hue_table, hue_division_table);
+                break;
+
+            case BACK_PROJECTION_SSE41:
+                back_project_row_sse41(BGR, output, BGR_frame.cols, gate_table, hue_table, hue_division_table);
+                break;
+
+#endif
+
+            default:
+                back_project_row_scalar(BGR, output, 0, BGR_frame.cols, gate_table, hue_table, hue_division_table);
+        }
+    }
+}
+
+/**
+ * Compute gate table for given parameters unless it is already computed.
+ *
+ * @param equalization_table
+ * @param saturation_min
+ * @param saturation_max
+ * @param value_min
+ * @param value_max
+ */
+void BackProjection::update_gate_table(const Mat& equalization_table, int saturation_min, int saturation_max, int value_min, int value_max) {
+
+    if (saturation_min == gate_saturation_min && saturation_max == gate_saturation_max && value_min == gate_value_min && value_max == gate_value_max && !gate_equalization_table.empty() && memcmp(gate_equalization_table.ptr(), equalization_table.ptr(), 256) == 0) {
+        return;
+    }
+
+    const uchar * equalization = equalization_table.ptr();
+
+    for (int value = 0; value < 256; value++) {
+
+        bool value_in_range = equalization[value] >= value_min && equalization[value] <= value_max;
+
+        for (int difference = 0; difference < 256; difference++) {
+
+            // Saturation the same way as OpenCV computes it
+            int saturation = (difference * saturation_division_table[value] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+
+            gate_table[(value << 8) | difference] = value_in_range && saturation >= saturation_min && saturation <= saturation_max ? 255 : 0;
+        }
+    }
+
+    equalization_table.copyTo(gate_equalization_table);
+    gate_saturation_min = saturation_min;
+    gate_saturation_max = saturation_max;
+    gate_value_min = value_min;
+    gate_value_max = value_max;
+}
+
+/**
+ * Compute histogram of value (V) of the BGR frame without converting it to HSV.
+ * Value is the maximum of the BGR components. Only every step-th pixel of every
+ * step-th row is counted.
+ *
+ * @param BGR_frame
+ * @param step sampling step
+ * @param histogram 256 bins
+ * @return number of counted pixels
+ */
+int BackProjection::value_histogram(const Mat& BGR_frame, int step, int * histogram) {
+
+    memset(histogram, 0, 256 * sizeof (int));
+
+    int samples = 0;
+
+    for (int row = 0; row < BGR_frame.rows; row += step) {
+        const uchar * BGR = BGR_frame.ptr(row);
+        for (int x = 0; x < BGR_frame.cols; x += step) {
+            histogram[max(BGR[3 * x], max(BGR[3 * x + 1], BGR[3 * x + 2]))]++;
+            samples++;
+        }
+    }
+
+    return samples;
+}
+
+/**
+ * Create hue look up table by back projecting every hue. This gives exactly the
+ * values calcBackProject gives for the histogram.
+ *
+ * @param histogram hue histogram
+ * @param histogram_ranges hue range of the histogram
+ * @return 1x256 table
+ */
+Mat BackProjection::create_hue_table(const Mat& histogram, const float * histogram_ranges) {
+
+    Mat hues(1, 256, CV_8U);
+    for (int i = 0; i < 256; i++) {
+        hues.at<uchar>(i) = i;
+    }
+
+    Mat hue_table;
+    calcBackProject(&hues, 1, 0, histogram, hue_table, &histogram_ranges);
+
+    return hue_table;
+}
+
+int BackProjection::get_instruction_set() {
+    return instruction_set;
+}
+
+/**
+ * Set instruction set of the kernel. If it is not supported by the processor,
+ * the best supported one below it is used.
+ *
+ * @param s
+ */
+void BackProjection::set_instruction_set(int s) {
+
+    instruction_set = BACK_PROJECTION_SCALAR;
+
+#ifdef BACK_PROJECTION_X86
+
+    if (s >= BACK_PROJECTION_AVX2 && checkHardwareSupport(CV_CPU_AVX2)) {
+        instruction_set = BACK_PROJECTION_AVX2;
+    } else if (s >= BACK_PROJECTION_SSE41 && checkHardwareSupport(CV_CPU_SSE4_1)) {
+        instruction_set = BACK_PROJECTION_SSE41;
+    }
+
+#endif
+}
+
+string BackProjection::get_instruction_set_name(int s) {
+    switch (s) {
+        case BACK_PROJECTION_AVX2:
+            return "AVX2";
+        case BACK_PROJECTION_SSE41:
+            return "SSE4.1";
+        default:
+            return "scalar";
+    }
+}
@@ -0,0 +1,84 @@
+/*
+ * File:   BackProjection.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef BACKPROJECTION_HPP
+#define BACKPROJECTION_HPP
+
+#include "opencv2/opencv.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Instruction set used by the back projection kernel
+enum BackProjectionInstructionSet {
+    BACK_PROJECTION_SCALAR,
+    BACK_PROJECTION_SSE41,
+    BACK_PROJECTION_AVX2
+};
+
+/**
+ * Single pass histogram back projection of a BGR frame. Gives exactly the same
+ * result as this chain used by the tracker:
+ *
+ * cvtColor(BGR, HSV, COLOR_BGR2HSV)
+ * equalize value (V) with a look up table
+ * inRange(HSV, (0, S min, V min), (180, S max, V max), mask)
+ * mixChannels to get hue
+ * calcBackProject(hue, histogram)
+ * back projection &= mask
+ *
+ * Each pixel is read once and the back projection is written directly. The
+ * HSV conversion is the integer one OpenCV uses for 8-bit images. Saturation
+ * and value gate depends only on the maximum and the range of the BGR
+ * components, so it is precomputed into a table.
+ */
+class BackProjection {
+public:
+
+    BackProjection();
+    BackProjection(const BackProjection& orig);
+    virtual ~BackProjection();
+
+    void compute(const Mat&, const Mat&, const Mat&, int, int, int, int, Mat&);
+
+    static int value_histogram(const Mat&, int, int *);
+
+    static Mat create_hue_table(const Mat&, const float *);
+
+    int get_instruction_set();
+
+    void set_instruction_set(int);
+
+    static string get_instruction_set_name(int);
+
+private:
+
+    void update_gate_table(const Mat&, int, int, int, int);
+
+    // Instruction set of the kernel
+    int instruction_set;
+
+    // Fixed point reciprocals used by the HSV conversion
+    int saturation_division_table[256];
+    int hue_division_table[256];
+
+    // Saturation and value gate indexed by (value << 8) | (value - minimum).
+    // Padded so that the SIMD kernels can read four bytes at any index.
+    uchar gate_table[256 * 256 + 4];
+
+    // Hue to back projection look up table, padded the same way
+    uchar hue_table[256 + 4];
+
+    // Parameters the gate table was computed for
+    Mat gate_equalization_table;
+    int gate_saturation_min;
+    int gate_saturation_max;
+    int gate_value_min;
+    int gate_value_max;
+
+};
+
+#endif /* BACKPROJECTION_HPP */
+
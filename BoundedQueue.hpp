@@ -0,0 +1,260 @@
+/*
+ * File:   BoundedQueue.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+using namespace std;
+
+// What happens when an item is pushed into a full queue
+enum QueuePolicy {
+
+    // Producer waits until there is free space. Nothing is lost.
+    QUEUE_BLOCK,
+
+    // The oldest item in the queue is overwritten by the new one.
+    QUEUE_DROP_OLDEST,
+
+    // Same as drop oldest, but the consumer always takes the newest item and
+    // discards everything older.
+    QUEUE_KEEP_LATEST
+};
+
+/**
+ * Bounded ring buffer connecting one producer thread with one consumer thread.
+ */
+template <class T>
+class BoundedQueue {
+public:
+
+    BoundedQueue(int c, int p = QUEUE_BLOCK) : buffer(c) {
+        capacity = c;
+        policy = p;
+        head = 0;
+        count = 0;
+        closed = false;
+        pushed = 0;
+        dropped = 0;
+        peak_count = 0;
+        count_sum = 0;
+    }
+
+    virtual ~BoundedQueue() {
+    }
+
+    /**
+     * Push item into the queue. Depending on the policy it either waits for
+     * free space or overwrites the oldest item.
+     *
+     * @param item
+     * @return false if the queue was closed
+     */
+    bool push(const T& item) {
+        unique_lock<mutex> lock(queue_mutex);
+
+        if (policy == QUEUE_BLOCK) {
+            not_full.wait(lock, [this] {
+                return count < capacity || closed;
+            });
+        }
+
+        if (closed) {
+            return false;
+        }
+
+        if (count == capacity) {
+
+            // Overwrite the oldest item
+            head = (head + 1) % capacity;
+            count--;
+            dropped++;
+        }
+
+        buffer[(head + count) % capacity] = item;
+        count++;
+        pushed++;
+
+        // Occupancy statistics
+        if (count > peak_count) {
+            peak_count = count;
+        }
+        count_sum += count;
+
+        not_empty.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Pop item from the queue. Waits until there is an item or the queue is
+     * closed.
+     *
+     * @param item
+     * @return false if the queue was closed and there are no more items
+     */
+    bool pop(T& item) {
+        unique_lock<mutex> lock(queue_mutex);
+
+        not_empty.wait(lock, [this] {
+            return count > 0 || closed;
+        });
+
+        return take(item);
+    }
+
+    /**
+     * Pop item from the queue. Waits at most given number of milliseconds.
+     *
+     * @param item
+     * @param milliseconds
+     * @return false if there was no item
+     */
+    bool pop_for(T& item, int milliseconds) {
+        unique_lock<mutex> lock(queue_mutex);
+
+        not_empty.wait_for(lock, chrono::milliseconds(milliseconds), [this] {
+            return count > 0 || closed;
+        });
+
+        return take(item);
+    }
+
+    /**
+     * Close the queue. Waiting producer and consumer are released. Items
+     * already in the queue can still be popped.
+     *
+     */
+    void close() {
+        lock_guard<mutex> lock(queue_mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+    bool is_closed() {
+        lock_guard<mutex> lock(queue_mutex);
+        return closed;
+    }
+
+    int size() {
+        lock_guard<mutex> lock(queue_mutex);
+        return count;
+    }
+
+    int get_capacity() {
+        return capacity;
+    }
+
+    /**
+     * Get the highest number of items that were in the queue at once.
+     *
+     * @return
+     */
+    int get_peak_size() {
+        lock_guard<mutex> lock(queue_mutex);
+        return peak_count;
+    }
+
+    /**
+     * Get average number of items in the queue right after a push.
+     *
+     * @return
+     */
+    double get_mean_size() {
+        lock_guard<mutex> lock(queue_mutex);
+        return pushed > 0 ? (double) count_sum / pushed : 0;
+    }
+
+    /**
+     * Get number of items that were accepted by the queue.
+     *
+     * @return
+     */
+    long get_pushed() {
+        lock_guard<mutex> lock(queue_mutex);
+        return pushed;
+    }
+
+    /**
+     * Get number of items that were overwritten or discarded before being
+     * consumed.
+     *
+     * @return
+     */
+    long get_dropped() {
+        lock_guard<mutex> lock(queue_mutex);
+        return dropped;
+    }
+
+private:
+
+    /**
+     * Take item from the buffer. Queue mutex has to be locked.
+     *
+     * @param item
+     * @return
+     */
+    bool take(T& item) {
+        if (count == 0) {
+            return false;
+        }
+
+        if (policy == QUEUE_KEEP_LATEST && count > 1) {
+
+            // Discard everything but the newest item
+            int newest = (head + count - 1) % capacity;
+            for (int i = 0; i < count - 1; i++) {
+                buffer[(head + i) % capacity] = T();
+            }
+            dropped += count - 1;
+            head = newest;
+            count = 1;
+        }
+
+        item = buffer[head];
+
+        // Release the slot so that it does not hold the item longer than needed
+        buffer[head] = T();
+
+        head = (head + 1) % capacity;
+        count--;
+
+        not_full.notify_one();
+
+        return true;
+    }
+
+    vector<T> buffer;
+
+    int capacity;
+    int policy;
+
+    // Index of the oldest item
+    int head;
+
+    // Number of items in the buffer
+    int count;
+
+    bool closed;
+
+    // Statistics
+    long pushed;
+    long dropped;
+    int peak_count;
+    long count_sum;
+
+    mutex queue_mutex;
+    condition_variable not_empty;
+    condition_variable not_full;
+
+};
+
+#endif /* BOUNDEDQUEUE_HPP */
+
@@ -0,0 +1,269 @@
+/*
+ * File:   BoxBlur.cpp
+ * Author: Jan Dufek
+ */
+
+#include "BoxBlur.hpp"
+#include <string.h>
+
+// Fixed point precision of division by the box width
+#define BOX_BLUR_SHIFT 22
+
+/**
+ * Reflect index outside of the line the same way as BORDER_REFLECT_101.
+ *
+ * @param x
+ * @param length
+ * @return index within the line
+ */
+static inline int reflect_101(int x, int length) {
+
+    if (length == 1) {
+        return 0;
+    }
+
+    while (x < 0 || x >= length) {
+        x = x < 0 ? -x : 2 * length - 2 - x;
+    }
+
+    return x;
+}
+
+/**
+ * Box filter of one line of BGR pixels.
+ *
+ * @param source
+ * @param destination
+ * @param length number of pixels
+ * @param radius
+ */
+static void box_line(const uchar * source, uchar * destination, int length, int radius) {
+
+    if (radius == 0) {
+        memcpy(destination, source, 3 * length);
+        return;
+    }
+
+    unsigned scale = ((1u << BOX_BLUR_SHIFT) + radius) / (2 * radius + 1);
+    unsigned rounding = 1u << (BOX_BLUR_SHIFT - 1);
+
+    int sum[3] = {0, 0, 0};
+    for (int k = -radius; k <= radius; k++) {
+        const uchar * pixel = source + 3 * reflect_101(k, length);
+        sum[0] += pixel[0];
+        sum[1] += pixel[1];
+        sum[2] += pixel[2];
+    }
+
+    for (int x = 0; x < length; x++) {
+
+        destination[3 * x] = (uchar) (((unsigned) sum[0] * scale + rounding) >> BOX_BLUR_SHIFT);
+        destination[3 * x + 1] = (uchar) (((unsigned) sum[1] * scale + rounding) >> BOX_BLUR_SHIFT);
+        destination[3 * x + 2] = (uchar) (((unsigned) sum[2] * scale + rounding) >> BOX_BLUR_SHIFT);
+
+        // Slide the window
+        int in = x + radius + 1;
+        int out = x - radius;
+        const uchar * pixel_in = source + 3 * (in < length ? in : reflect_101(in, length));
+        const uchar * pixel_out = source + 3 * (out >= 0 ? out : reflect_101(out, length));
+        sum[0] += pixel_in[0] - pixel_out[0];
+        sum[1] += pixel_in[1] - pixel_out[1];
+        sum[2] += pixel_in[2] - pixel_out[2];
+    }
+}
+
+/**
+ * Horizontal boxes applied to stripes of rows.
+ */
+class HorizontalBoxes : public ParallelLoopBody {
+public:
+
+    HorizontalBoxes(const Mat& s, Mat& d, const int * r, int n) : source(s), destination(d), radii(r), stripes(n) {
+    }
+
+    virtual void operator()(const Range& range) const {
+
+        int first_row = source.rows * range.start / stripes;
+        int last_row = source.rows * range.end / stripes;
+
+        vector<uchar> line_1(3 * source.cols);
+        vector<uchar> line_2(3 * source.cols);
+
+        for (int row = first_row; row < last_row; row++) {
+            box_line(source.ptr(row), line_1.data(), source.cols, radii[0]);
+            box_line(line_1.data(), line_2.data(), source.cols, radii[1]);
+            box_line(line_2.data(), destination.ptr(row), source.cols, radii[2]);
+        }
+    }
+
+private:
+
+    const Mat& source;
+    Mat& destination;
+    const int * radii;
+    int stripes;
+
+};
+
+/**
+ * Vertical box applied to stripes of rows. Keeps running sums of whole rows.
+ * Only the output region of the source is written to the destination.
+ */
+class VerticalBox : public ParallelLoopBody {
+public:
+
+    VerticalBox(const Mat& s, Mat& d, int r, Rect o, int n) : source(s), destination(d), radius(r), output(o), stripes(n) {
+    }
+
+    virtual void operator()(const Range& range) const {
+
+        int first_row = output.y + output.height * range.start / stripes;
+        int last_row = output.y + output.height * range.end / stripes;
+
+        int length = 3 * output.width;
+        int offset = 3 * output.x;
+
+        unsigned scale = ((1u << BOX_BLUR_SHIFT) + radius) / (2 * radius + 1);
+        unsigned rounding = 1u << (BOX_BLUR_SHIFT - 1);
+
+        vector<int> sum(length, 0);
+        for (int k = -radius; k <= radius; k++) {
+            const uchar * row = source.ptr(reflect_101(first_row + k, source.rows)) + offset;
+            for (int i = 0; i < length; i++) {
+                sum[i] += row[i];
+            }
+        }
+
+        for (int y = first_row; y < last_row; y++) {
+
+            uchar * row = destination.ptr(y - output.y);
+            for (int i = 0; i < length; i++) {
+                row[i] = (uchar) (((unsigned) sum[i] * scale + rounding) >> BOX_BLUR_SHIFT);
+            }
+
+            // Slide the window
+            int in = y + radius + 1;
+            int out = y - radius;
+            const uchar * row_in = source.ptr(in < source.rows ? in : reflect_101(in, source.rows)) + offset;
+            const uchar * row_out = source.ptr(out >= 0 ? out : reflect_101(out, source.rows)) + offset;
+            for (int i = 0; i < length; i++) {
+                sum[i] += row_in[i] - row_out[i];
+            }
+        }
+    }
+
+private:
+
+    const Mat& source;
+    Mat& destination;
+    int radius;
+    Rect output;
+    int stripes;
+
+};
+
+/**
+ * Apply vertical box filter in parallel.
+ *
+ * @param source
+ * @param destination
+ * @param radius
+ * @param output region of the source written to the destination
+ */
+static void vertical_box(const Mat& source, Mat& destination, int radius, Rect output) {
+
+    // Each stripe starts by summing the whole window, so stripes are made at
+    // least as high as the window to keep the cost independent of the radius
+    int stripes = max(1, min(getNumThreads(), output.height / (2 * radius + 1)));
+
+    parallel_for_(Range(0, stripes), VerticalBox(source, destination, radius, output, stripes));
+}
+
+BoxBlur::BoxBlur() {
+}
+
+BoxBlur::BoxBlur(const BoxBlur& orig) {
+}
+
+BoxBlur::~BoxBlur() {
+}
+
+/**
+ * Blur the region of the frame. The result approximates
+ * GaussianBlur(frame(region), blured_frame, Size(kernel_size, kernel_size), 0, 0).
+ * Pixels around the region are read from the rest of the frame.
+ *
+ * @param frame BGR frame
+ * @param region region of the frame to blur
+ * @param blured_frame blured region
+ * @param kernel_size size of the Gaussian kernel
+ */
+void BoxBlur::apply(const Mat& frame, Rect region, Mat& blured_frame, int kernel_size) {
+
+    CV_Assert(frame.type() == CV_8UC3);
+
+    if (kernel_size <= 1) {
+        frame(region).copyTo(blured_frame);
+        return;
+    }
+
+    lock_guard<mutex> lock(buffers_mutex);
+
+    int radii[BOX_BLUR_PASSES];
+    get_box_radii(kernel_size, radii);
+
+    // Region with enough pixels around it for all the passes
+    int border = radii[0] + radii[1] + radii[2];
+    Rect expanded_region = Rect(region.x - border, region.y - border, region.width + 2 * border, region.height + 2 * border) & Rect(0, 0, frame.cols, frame.rows);
+    Mat source = frame(expanded_region);
+    Rect all(0, 0, source.cols, source.rows);
+
+    horizontal.create(source.size(), CV_8UC3);
+    vertical.create(source.size(), CV_8UC3);
+    blured_frame.create(region.size(), CV_8UC3);
+
+    int stripes = max(1, getNumThreads());
+    parallel_for_(Range(0, stripes), HorizontalBoxes(source, horizontal, radii, stripes));
+
+    vertical_box(horizontal, vertical, radii[0], all);
+    vertical_box(vertical, horizontal, radii[1], all);
+    vertical_box(horizontal, blured_frame, radii[2], region - expanded_region.tl());
+}
+
+/**
+ * Get sigma of the Gaussian kernel of given size the same way as GaussianBlur
+ * computes it when sigma is 0.
+ *
+ * @param kernel_size
+ * @return
+ */
+double BoxBlur::get_sigma(int kernel_size) {
+    return 0.3 * ((kernel_size - 1) * 0.5 - 1) + 0.8;
+}
+
+/**
+ * Get radii of the stacked boxes whose variance is the closest to the variance
+ * of the Gaussian kernel of given size.
+ *
+ * @param kernel_size
+ * @param radii BOX_BLUR_PASSES radii
+ */
+void BoxBlur::get_box_radii(int kernel_size, int * radii) {
+
+    double variance = get_sigma(kernel_size) * get_sigma(kernel_size);
+    int n = BOX_BLUR_PASSES;
+
+    // Width of equal boxes with the same variance, rounded down to odd
+    int lower_width = (int) floor(sqrt(12 * variance / n + 1));
+    if (lower_width % 2 == 0) {
+        lower_width--;
+    }
+    int upper_width = lower_width + 2;
+
+    // Number of narrower boxes
+    int lower_boxes = cvRound((12 * variance - n * lower_width * lower_width - 4 * n * lower_width - 3 * n) / (-4 * lower_width - 4));
+
+    for (int i = 0; i < n; i++) {
+        radii[i] = ((i < lower_boxes ? lower_width : upper_width) - 1) / 2;
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * File:   BoxBlur.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef BOXBLUR_HPP
+#define BOXBLUR_HPP
+
+#include <mutex>
+#include "opencv2/opencv.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Number of stacked box filters approximating the Gaussian
+#define BOX_BLUR_PASSES 3
+
+/**
+ * Approximation of Gaussian blur by stacked box filters. Each box filter is
+ * computed with a running sum, so the cost per pixel does not depend on the
+ * kernel size. Three boxes are within a few gray levels of the Gaussian.
+ *
+ * Horizontal boxes are applied to each row in a line buffer, vertical ones
+ * keep running sums of whole rows. Both are split to row stripes processed in
+ * parallel. Borders are reflected the same way as GaussianBlur does it.
+ */
+class BoxBlur {
+public:
+
+    BoxBlur();
+    BoxBlur(const BoxBlur& orig);
+    virtual ~BoxBlur();
+
+    void apply(const Mat&, Rect, Mat&, int);
+
+    static void get_box_radii(int, int *);
+
+    static double get_sigma(int);
+
+private:
+
+    // Intermediate results reused between frames
+    Mat horizontal;
+    Mat vertical;
+
+    // The buffers can be used by one frame at a time
+    mutex buffers_mutex;
+
+};
+
+#endif /* BOXBLUR_HPP */
+
@@ -0,0 +1,160 @@
+/*
+ * File:   CaptureThread.cpp
+ * Author: Jan Dufek
+ */
+
+#include "CaptureThread.hpp"
+#include "Trace.hpp"
+#include <iostream>
+
+/**
+ * Capture thread reading frames from the video input into a bounded frame
+ * buffer.
+ *
+ * @param f video input
+ * @param s settings
+ * @param first_frame_number number assigned to the first captured frame
+ */
+CaptureThread::CaptureThread(FrameSource& f, Settings& s, long first_frame_number) {
+
+    frame_source = &f;
+    settings = &s;
+
+    // Frames from video file are never dropped. Live stream frames are dropped
+    // according to the policy so that the processing works with recent frames.
+    frame_buffer = new BoundedQueue<CapturedFrame>(settings->FRAME_BUFFER_SIZE, frame_source->is_live() ? settings->frame_buffer_policy : QUEUE_BLOCK);
+
+    running = false;
+    frame_number = first_frame_number;
+    stale_frames = 0;
+
+}
+
+CaptureThread::CaptureThread(const CaptureThread& orig) {
+}
+
+CaptureThread::~CaptureThread() {
+    stop();
+    delete frame_buffer;
+}
+
+/**
+ * Start capturing frames.
+ *
+ */
+void CaptureThread::start() {
+    running = true;
+    capture_thread = thread(&CaptureThread::run, this);
+}
+
+/**
+ * Stop capturing frames and wait for the capture thread to finish.
+ *
+ */
+void CaptureThread::stop() {
+    running = false;
+    frame_buffer->close();
+
+    if (capture_thread.joinable()) {
+        capture_thread.join();
+    }
+}
+
+/**
+ * Capture loop.
+ *
+ */
+void CaptureThread::run() {
+
+    Trace::set_thread_name("Capture");
+
+    while (running) {
+
+        // New frame has to be allocated every time, otherwise the video input
+        // would decode into the memory of the frame that is still being processed
+        CapturedFrame captured_frame;
+
+        // Read one frame
+        bool captured;
+        {
+            TraceScope trace_scope("Capture");
+            captured = frame_source->read(captured_frame.frame);
+        }
+
+        // Save the capture time
+        captured_frame.capture_time = chrono::steady_clock::now();
+
+        // End of the video input
+        if (!captured) {
+            break;
+        }
+
+        captured_frame.frame_number = frame_number++;
+
+        // Store the frame
+        if (!frame_buffer->push(captured_frame)) {
+            break;
+        }
+    }
+
+    // Let the consumer know that there will be no more frames
+    frame_buffer->close();
+
+}
+
+/**
+ * Get next frame for processing. Waits until a frame is available.
+ *
+ * @param captured_frame
+ * @return false if the video input ended
+ */
+bool CaptureThread::read(CapturedFrame& captured_frame) {
+
+    if (!frame_buffer->pop(captured_frame)) {
+        return false;
+    }
+
+    // Check the age of the frame
+    chrono::steady_clock::duration age = chrono::steady_clock::now() - captured_frame.capture_time;
+    if (chrono::duration_cast<chrono::milliseconds>(age).count() > settings->stale_frame_age) {
+        stale_frames++;
+    }
+
+    return true;
+}
+
+/**
+ * Get number of frames read from the video input.
+ *
+ * @return
+ */
+long CaptureThread::get_captured_frames() {
+    return frame_buffer->get_pushed();
+}
+
+/**
+ * Get number of frames that were dropped without being processed.
+ *
+ * @return
+ */
+long CaptureThread::get_dropped_frames() {
+    return frame_buffer->get_dropped();
+}
+
+/**
+ * Get number of frames that were older than stale frame age when processed.
+ *
+ * @return
+ */
+long CaptureThread::get_stale_frames() {
+    return stale_frames;
+}
+
+/**
+ * Print capture statistics to the console.
+ *
+ */
+void CaptureThread::print_statistics() {
+    cout << "Captured frames: " << get_captured_frames() << " Dropped frames: " << get_dropped_frames() << " Stale frames: " << get_stale_frames() << endl;
+}
+
@@ -0,0 +1,73 @@
+/*
+ * File:   CaptureThread.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef CAPTURETHREAD_HPP
+#define CAPTURETHREAD_HPP
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+#include "BoundedQueue.hpp"
+#include "FrameSource.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Frame together with the time it was taken from the video input
+struct CapturedFrame {
+    Mat frame;
+    long frame_number;
+    chrono::steady_clock::time_point capture_time;
+};
+
+class CaptureThread {
+public:
+    CaptureThread(FrameSource&, Settings&, long);
+    CaptureThread(const CaptureThread& orig);
+    virtual ~CaptureThread();
+
+    void start();
+
+    void stop();
+
+    bool read(CapturedFrame&);
+
+    long get_captured_frames();
+
+    long get_dropped_frames();
+
+    long get_stale_frames();
+
+    void print_statistics();
+
+private:
+
+    void run();
+
+    // Video input
+    FrameSource * frame_source;
+
+    // Program settings
+    Settings * settings;
+
+    // Frames waiting for processing
+    BoundedQueue<CapturedFrame> * frame_buffer;
+
+    thread capture_thread;
+
+    atomic<bool> running;
+
+    // Number of the next captured frame
+    long frame_number;
+
+    // Frames older than stale frame age when read
+    atomic<long> stale_frames;
+
+};
+
+#endif /* CAPTURETHREAD_HPP */
+
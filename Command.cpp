@@ -6,14 +6,24 @@
 #include "Command.hpp"
 
 Command::Command() {
+    throttle = 0;
+    rudder = 0;
+    distance_to_target = 0;
+    angle_error_to_target = 0;
 }
 
 Command::Command(const Command& orig) {
+    throttle = orig.throttle;
+    rudder = orig.rudder;
+    distance_to_target = orig.distance_to_target;
+    angle_error_to_target = orig.angle_error_to_target;
 }
 
 Command::Command(double t, double r) {
     throttle = t;
-    rudder = t;
+    rudder = r;
+    distance_to_target = 0;
+    angle_error_to_target = 0;
 }
 
 Command::~Command() {
@@ -0,0 +1,231 @@
+/*
+ * File:   CommandThread.cpp
+ * Author: Jan Dufek
+ */
+
+#include "CommandThread.hpp"
+#include "Trace.hpp"
+#include <iostream>
+
+/**
+ * Command thread sending commands at the command rate.
+ *
+ * @param c communication with EMILY
+ * @param s settings
+ */
+CommandThread::CommandThread(Communication& c, Settings& s) {
+
+    communication = &c;
+    settings = &s;
+    control = new Control(s);
+
+    running = false;
+    pose_known = false;
+    velocity_known = false;
+
+    sent_commands = 0;
+    stale_commands = 0;
+    missed_deadlines = 0;
+    extrapolation_time = 0;
+    extrapolated_commands = 0;
+
+}
+
+CommandThread::CommandThread(const CommandThread& orig) {
+}
+
+CommandThread::~CommandThread() {
+    stop();
+    delete control;
+}
+
+/**
+ * Start sending commands.
+ *
+ */
+void CommandThread::start() {
+    running = true;
+    command_thread = thread(&CommandThread::run, this);
+}
+
+/**
+ * Stop sending commands and wait for the command thread to finish.
+ *
+ */
+void CommandThread::stop() {
+
+    {
+        lock_guard<mutex> lock(pose_mutex);
+        running = false;
+    }
+    stop_condition.notify_all();
+
+    if (command_thread.joinable()) {
+        command_thread.join();
+    }
+}
+
+/**
+ * Replace the latest pose by the output of the control stage for a new frame.
+ *
+ * @param command command of the control stage
+ * @param steering true if the command is computed from the pose
+ * @param location ground location of EMILY
+ * @param angle heading of EMILY
+ * @param target ground target location
+ * @param capture_time time the frame was taken from the video input
+ */
+void CommandThread::update(Command& command, bool steering, Point2d location, double angle, Point2d target, chrono::steady_clock::time_point capture_time) {
+
+    lock_guard<mutex> lock(pose_mutex);
+
+    // Velocity is measured between consecutive poses while steering
+    if (steering && pose_known && pose.steering) {
+
+        double time_difference = chrono::duration<double>(capture_time - pose.capture_time).count();
+
+        if (time_difference > 0) {
+
+            Point2d measured_velocity = (location - pose.location) * (1 / time_difference);
+
+            if (velocity_known) {
+                velocity += (measured_velocity - velocity) * settings->COMMAND_VELOCITY_SMOOTHING;
+            } else {
+                velocity = measured_velocity;
+                velocity_known = true;
+            }
+        }
+
+    } else if (!steering) {
+        velocity_known = false;
+    }
+
+    pose.command = command;
+    pose.steering = steering;
+    pose.location = location;
+    pose.angle = angle;
+    pose.target = target;
+    pose.capture_time = capture_time;
+    pose_known = true;
+}
+
+/**
+ * Get command to be sent now. Must be called with the pose mutex locked.
+ *
+ * @param now time of sending
+ * @param capture_time capture time of the frame of the pose the command is
+ * computed from. Not set if the command does not depend on a pose.
+ * @return command to send
+ */
+Command * CommandThread::get_command(chrono::steady_clock::time_point now, chrono::steady_clock::time_point& capture_time) {
+
+    if (!pose_known) {
+        return new Command(0, 0);
+    }
+
+    double age = chrono::duration<double>(now - pose.capture_time).count();
+
+    // Tracking stopped delivering poses, do not act on old information
+    if (age > settings->command_timeout) {
+        stale_commands++;
+        return new Command(0, 0);
+    }
+
+    capture_time = pose.capture_time;
+
+    if (!pose.steering) {
+        return new Command(pose.command);
+    }
+
+    // Target was reached since the last pose
+    if (target_reached) {
+        return new Command(0, 0);
+    }
+
+    Point2d location = pose.location;
+
+    if (velocity_known) {
+        location += velocity * age;
+        extrapolation_time += age;
+        extrapolated_commands++;
+    }
+
+    return control->get_control_commands(location.x, location.y, pose.angle, pose.target.x, pose.target.y);
+}
+
+/**
+ * Command loop.
+ *
+ */
+void CommandThread::run() {
+
+    Trace::set_thread_name("Command");
+
+    chrono::steady_clock::duration period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1 / settings->command_rate));
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now();
+
+    unique_lock<mutex> lock(pose_mutex);
+
+    while (running) {
+
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+        chrono::steady_clock::time_point capture_time = chrono::steady_clock::time_point::min();
+        Command * command = get_command(now, capture_time);
+
+        // Control stage can update the pose while sending
+        lock.unlock();
+
+        {
+            TraceScope trace_scope("Send");
+            communication->send_command(* command);
+        }
+
+        delete command;
+
+        if (capture_time != chrono::steady_clock::time_point::min()) {
+            send_latency.record(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - capture_time).count());
+        }
+
+        lock.lock();
+
+        sent_commands++;
+
+        // Keep the rate, but do not send several commands at once after a
+        // delay
+        deadline += period;
+        if (deadline < now) {
+            missed_deadlines++;
+            deadline = now + period;
+        }
+
+        stop_condition.wait_until(lock, deadline, [this] {
+            return !running;
+        });
+    }
+}
+
+/**
+ * Get latency from capture of the frame of the pose to sending the command
+ * computed from it. Stops of stale poses are not counted.
+ *
+ * @return
+ */
+LatencyHistogram& CommandThread::get_send_latency() {
+    return send_latency;
+}
+
+/**
+ * Print command statistics to the console.
+ *
+ */
+void CommandThread::print_statistics() {
+
+    lock_guard<mutex> lock(pose_mutex);
+
+    cout << "Sent commands: " << sent_commands << " Stale stops: " << stale_commands << " Missed deadlines: " << missed_deadlines;
+    if (extrapolated_commands > 0) {
+        cout << " Mean extrapolation: " << extrapolation_time / extrapolated_commands * 1000 << " ms";
+    }
+    cout << endl;
+}
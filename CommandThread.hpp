@@ -0,0 +1,107 @@
+/*
+ * File:   CommandThread.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef COMMANDTHREAD_HPP
+#define COMMANDTHREAD_HPP
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+#include "Command.hpp"
+#include "Control.hpp"
+#include "Communication.hpp"
+#include "LatencyHistogram.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Latest output of the control stage
+struct CommandPose {
+
+    // Command of the control stage. It is sent as it is unless steering.
+    Command command;
+
+    // Steering to the target, the command is computed again from the
+    // extrapolated pose
+    bool steering;
+
+    // Ground location of EMILY, its heading and the ground target location
+    Point2d location;
+    double angle;
+    Point2d target;
+
+    // Time the frame of the pose was taken from the video input
+    chrono::steady_clock::time_point capture_time;
+};
+
+/**
+ * Thread sending commands to EMILY at a fixed rate, independent of the frame
+ * rate of the tracking. Location of the latest pose is extrapolated to the
+ * time of sending with the estimated velocity. When no new pose came for the
+ * command timeout, EMILY is stopped.
+ */
+class CommandThread {
+public:
+    CommandThread(Communication&, Settings&);
+    CommandThread(const CommandThread& orig);
+    virtual ~CommandThread();
+
+    void start();
+
+    void stop();
+
+    void update(Command&, bool, Point2d, double, Point2d, chrono::steady_clock::time_point);
+
+    void print_statistics();
+
+    LatencyHistogram& get_send_latency();
+
+private:
+
+    void run();
+
+    Command * get_command(chrono::steady_clock::time_point, chrono::steady_clock::time_point&);
+
+    Communication * communication;
+
+    // Program settings
+    Settings * settings;
+
+    // Control of this thread, the control stage has its own
+    Control * control;
+
+    thread command_thread;
+
+    // Protects everything below
+    mutex pose_mutex;
+    condition_variable stop_condition;
+
+    bool running;
+
+    // Latest pose
+    CommandPose pose;
+    bool pose_known;
+
+    // Estimated velocity of EMILY in ground units per second
+    Point2d velocity;
+    bool velocity_known;
+
+    // Statistics
+    long sent_commands;
+    long stale_commands;
+    long missed_deadlines;
+    double extrapolation_time;
+    long extrapolated_commands;
+
+    // Latency from capture of the frame of the pose to sending the command
+    LatencyHistogram send_latency;
+
+};
+
+#endif /* COMMANDTHREAD_HPP */
+
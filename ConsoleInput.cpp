@@ -0,0 +1,167 @@
+/*
+ * File:   ConsoleInput.cpp
+ * Author: Jan Dufek
+ */
+
+#include "ConsoleInput.hpp"
+#include <iostream>
+#include <sstream>
+#include <poll.h>
+#include <unistd.h>
+
+/**
+ * Operator input from the standard input.
+ *
+ * @param sz size of the processed video
+ */
+ConsoleInput::ConsoleInput(Size sz) {
+    video_size = sz;
+    running = false;
+}
+
+ConsoleInput::ConsoleInput(const ConsoleInput& orig) {
+}
+
+ConsoleInput::~ConsoleInput() {
+    stop();
+}
+
+/**
+ * Start reading commands.
+ *
+ */
+void ConsoleInput::start() {
+    running = true;
+    input_thread = thread(&ConsoleInput::run, this);
+}
+
+/**
+ * Stop reading commands and wait for the input thread to finish.
+ *
+ */
+void ConsoleInput::stop() {
+    running = false;
+
+    if (input_thread.joinable()) {
+        input_thread.join();
+    }
+}
+
+/**
+ * Input loop. Standard input is polled with a timeout so that the thread can
+ * be stopped without waiting for the next line.
+ *
+ */
+void ConsoleInput::run() {
+
+    // Characters read but not terminated by a new line yet
+    string line_buffer;
+
+    char buffer[256];
+
+    while (running) {
+
+        struct pollfd standard_input = {STDIN_FILENO, POLLIN, 0};
+
+        if (poll(&standard_input, 1, 100) <= 0) {
+            continue;
+        }
+
+        ssize_t length = read(STDIN_FILENO, buffer, sizeof (buffer));
+
+        // End of input
+        if (length <= 0) {
+            break;
+        }
+
+        line_buffer.append(buffer, length);
+
+        // Execute every complete line
+        size_t end_of_line;
+        while ((end_of_line = line_buffer.find('\n')) != string::npos) {
+            string line = line_buffer.substr(0, end_of_line);
+            line_buffer.erase(0, end_of_line + 1);
+
+            if (!execute(line, video_size)) {
+                cerr << "Unknown command: " << line << endl;
+            }
+        }
+    }
+}
+
+/**
+ * Execute one operator command. It has the same effect as the corresponding
+ * mouse or keyboard action in the GUI.
+ *
+ * @param line command
+ * @param video_size size of the processed video
+ * @return false if the command was not recognized
+ */
+bool ConsoleInput::execute(string line, Size video_size) {
+
+    istringstream command_stream(line);
+
+    string command;
+    command_stream >> command;
+
+    // Empty line
+    if (command.empty()) {
+        return true;
+    }
+
+    if (command == "select") {
+
+        Rect new_selection;
+        if (!(command_stream >> new_selection.x >> new_selection.y >> new_selection.width >> new_selection.height)) {
+            return false;
+        }
+
+        lock_guard<mutex> lock(operator_input_mutex);
+
+        // Get intersection with the original image
+        selection = new_selection & Rect(0, 0, video_size.width, video_size.height);
+
+        // If the selection has been made, start tracking
+        if (selection.width > 0 && selection.height > 0) {
+            object_selected = -1;
+        }
+
+    } else if (command == "target") {
+
+        Point new_target_location;
+        if (!(command_stream >> new_target_location.x >> new_target_location.y)) {
+            return false;
+        }
+
+        lock_guard<mutex> lock(operator_input_mutex);
+
+        // Set location of the target
+        target_location = new_target_location;
+        target_reached = false;
+
+    } else if (command == "clear") {
+
+        // Stop tracking
+        object_selected = 0;
+
+    } else if (command == "pause") {
+
+        // Toggle pause
+        paused = !paused;
+
+    } else if (command == "backprojection") {
+
+        // Toggle back projection mode
+        back_projection_mode = !back_projection_mode;
+
+    } else if (command == "quit") {
+
+        // Stop processing
+        quit_requested = true;
+
+    } else {
+        return false;
+    }
+
+    return true;
+}
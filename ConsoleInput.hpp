@@ -0,0 +1,63 @@
+/*
+ * File:   ConsoleInput.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef CONSOLEINPUT_HPP
+#define CONSOLEINPUT_HPP
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include "opencv2/opencv.hpp"
+
+using namespace std;
+using namespace cv;
+
+extern atomic<int> object_selected;
+extern Rect selection;
+extern Point target_location;
+extern atomic<bool> target_reached;
+extern atomic<bool> paused;
+extern atomic<bool> back_projection_mode;
+extern atomic<bool> quit_requested;
+extern mutex operator_input_mutex;
+
+// Operator input read line by line from the standard input. It replaces the
+// mouse and keyboard of the GUI when running headless. Commands:
+//
+// select <x> <y> <width> <height>   select object of interest
+// target <x> <y>                    set target location
+// clear                             stop tracking
+// pause                             toggle pause
+// backprojection                    toggle back projection mode
+// quit                              stop processing
+class ConsoleInput {
+public:
+
+    ConsoleInput(Size);
+    ConsoleInput(const ConsoleInput& orig);
+    virtual ~ConsoleInput();
+
+    void start();
+
+    void stop();
+
+    static bool execute(string, Size);
+
+private:
+
+    void run();
+
+    // Size of the processed video used to clip the selection
+    Size video_size;
+
+    thread input_thread;
+
+    atomic<bool> running;
+
+};
+
+#endif /* CONSOLEINPUT_HPP */
+
@@ -1,4 +1,5 @@
 #include "Control.hpp"
+#include "Trace.hpp"
 #include <math.h> 
 #include <stdio.h>
 #include <iostream>
@@ -79,6 +80,8 @@ void Control::get_distance_to_target(double usv_x, double usv_y, double target_x
  */
 Command * Control::get_control_commands(double usv_x, double usv_y, double theta, double target_x, double target_y) {
 
+    TraceScope trace_scope("Control commands");
+
     // PID proportional gain
     double kp = settings->proportional / 1000.0;
 
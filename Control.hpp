@@ -6,11 +6,12 @@
 #ifndef CONTROL_HPP
 #define CONTROL_HPP
 
+#include <atomic>
 #include "Command.hpp"
 #include "Settings.hpp"
 
 // Target was reached
-extern bool target_reached;
+extern atomic<bool> target_reached;
 
 class Control {
 public:
@@ -0,0 +1,423 @@
+/*
+ * File:   FrameCache.cpp
+ * Author: Jan Dufek
+ */
+
+#include "FrameCache.hpp"
+#include "VideoSource.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Round offset up to a multiple of the frame alignment.
+ *
+ * @param offset
+ * @return
+ */
+static uint64_t align_frame(uint64_t offset) {
+    return (offset + FRAME_CACHE_ALIGNMENT - 1) / FRAME_CACHE_ALIGNMENT * FRAME_CACHE_ALIGNMENT;
+}
+
+/**
+ * FNV-1a hash of the text.
+ *
+ * @param text
+ * @return
+ */
+static uint64_t hash_text(const string& text) {
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < text.size(); i++) {
+        hash = (hash ^ (unsigned char) text[i]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * Remove caches of the same video with other keys. They are left behind when
+ * the video is modified or cached at another resolution and are never opened
+ * again. Caches being read by other runs stay mapped until they are closed.
+ *
+ * @param directory cache directory
+ * @param prefix file name prefix of the caches of the video
+ * @param current_name file name of the current cache, which is kept
+ */
+static void remove_stale_caches(const string& directory, const string& prefix, const string& current_name) {
+
+    DIR * cache_directory = opendir(directory.c_str());
+    if (cache_directory == NULL) {
+        return;
+    }
+
+    const string suffix = ".frames";
+
+    struct dirent * entry;
+    while ((entry = readdir(cache_directory)) != NULL) {
+
+        string name = entry->d_name;
+
+        // Temporary files of caches being created do not end with the suffix
+        if (name == current_name || name.size() < prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+
+        string file_name = directory + "/" + name;
+        if (remove(file_name.c_str()) == 0) {
+            cout << "Removed stale frame cache " << file_name << endl;
+        }
+    }
+
+    closedir(cache_directory);
+}
+
+FrameCache::FrameCache() {
+    data = NULL;
+    size = 0;
+    header = NULL;
+    index = NULL;
+    frame_number = 0;
+}
+
+FrameCache::FrameCache(const FrameCache& orig) {
+}
+
+FrameCache::~FrameCache() {
+    close();
+}
+
+/**
+ * Memory map the cache file and check that it is complete and was created
+ * for the given key.
+ *
+ * @param file_name
+ * @param key
+ * @return false if the file does not exist, is not valid or has another key
+ */
+bool FrameCache::open(string file_name, uint64_t key) {
+
+    close();
+
+    int file_descriptor = ::open(file_name.c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+        return false;
+    }
+
+    struct stat file_status;
+    if (fstat(file_descriptor, &file_status) != 0 || (size_t) file_status.st_size < sizeof(FrameCacheHeader)) {
+        ::close(file_descriptor);
+        return false;
+    }
+
+    size = file_status.st_size;
+    void * mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+    ::close(file_descriptor);
+
+    if (mapping == MAP_FAILED) {
+        size = 0;
+        return false;
+    }
+
+    data = (const char *) mapping;
+    header = (const FrameCacheHeader *) data;
+    index = (const uint64_t *) (data + header->index_offset);
+
+    bool valid = memcmp(header->magic, FRAME_CACHE_MAGIC, sizeof(header->magic)) == 0 && header->version == FRAME_CACHE_VERSION && header->key == key;
+
+    // Everything the header points to must be within the file
+    valid = valid && header->frame_size == (uint64_t) header->width * header->height * CV_ELEM_SIZE(header->type);
+    valid = valid && header->index_offset % sizeof(uint64_t) == 0 && header->index_offset + header->frame_count * sizeof(uint64_t) <= size;
+
+    for (uint64_t i = 0; valid && i < header->frame_count; i++) {
+        valid = index[i] % FRAME_CACHE_ALIGNMENT == 0 && index[i] + header->frame_size <= size;
+    }
+
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    // Frames are mostly read in order
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    frame_number = 0;
+
+    return true;
+}
+
+/**
+ * Unmap the file.
+ *
+ */
+void FrameCache::close() {
+
+    if (data != NULL) {
+        munmap((void *) data, size);
+    }
+
+    data = NULL;
+    size = 0;
+    header = NULL;
+    index = NULL;
+}
+
+/**
+ * Read the next frame. The frame points into the mapping, nothing is copied.
+ *
+ * @param frame
+ * @return false after the last frame
+ */
+bool FrameCache::read(Mat& frame) {
+
+    if (frame_number >= (long) header->frame_count) {
+        return false;
+    }
+
+    frame = Mat(header->height, header->width, header->type, (void *) (data + index[frame_number++]));
+
+    return true;
+}
+
+double FrameCache::get_fps() {
+    return header->fps;
+}
+
+Size FrameCache::get_size() {
+    return Size(header->width, header->height);
+}
+
+/**
+ * Get size of the frames of the video the cache was created from. Positions
+ * in pixels of the video are scaled by the ratio of the two sizes.
+ *
+ * @return
+ */
+Size FrameCache::get_source_size() {
+    return Size(header->source_width, header->source_height);
+}
+
+/**
+ * Cache is created only for video files, whose frames are never dropped.
+ *
+ * @return
+ */
+bool FrameCache::is_live() {
+    return false;
+}
+
+long FrameCache::get_frame_count() {
+    return header->frame_count;
+}
+
+/**
+ * Check if the frame points into the mapping and therefore cannot be written.
+ *
+ * @param frame
+ * @return
+ */
+bool FrameCache::is_mapped(const Mat& frame) {
+    return data != NULL && (const char *) frame.data >= data && (const char *) frame.data < data + size;
+}
+
+/**
+ * Open the cache of a video file. If there is no valid cache, the video is
+ * decoded into a new one first.
+ *
+ * @param source video file
+ * @param settings cache directory and resolution
+ * @return NULL if the video cannot be cached
+ */
+FrameCache * FrameCache::open_video(string source, Settings& settings) {
+
+    // Cached resolution is given by the processing limit
+    int height_limit = settings.frame_cache_downscale ? settings.PROCESSING_VIDEO_HEIGHT_LIMIT : 0;
+    uint64_t key = get_key(source, height_limit);
+
+    // Name is <video>.<hash of the path>.<key>.frames. Videos of the same name
+    // in different directories do not replace each other, and caches of the
+    // same video with other keys are stale.
+    string base_name = source.substr(source.find_last_of('/') + 1);
+    ostringstream prefix_text;
+    prefix_text << base_name << "." << hex << setw(8) << setfill('0') << (uint32_t) hash_text(source) << ".";
+    string prefix = prefix_text.str();
+    ostringstream name_text;
+    name_text << prefix << hex << setw(16) << setfill('0') << key << ".frames";
+    string name = name_text.str();
+    string file_name = settings.frame_cache_directory + "/" + name;
+
+    FrameCache * frame_cache = new FrameCache();
+
+    if (frame_cache->open(file_name, key)) {
+        return frame_cache;
+    }
+
+    VideoSource video_source;
+
+    if (!video_source.open(source)) {
+        delete frame_cache;
+        return NULL;
+    }
+
+    if (video_source.is_live()) {
+        cerr << "Live stream " << source << " cannot be cached." << endl;
+        delete frame_cache;
+        return NULL;
+    }
+
+    Size source_size = video_source.get_size();
+    Size cache_size = source_size;
+    if (height_limit > 0 && cache_size.height > height_limit) {
+        cache_size = Size(cache_size.width * height_limit / cache_size.height, height_limit);
+    }
+
+    mkdir(settings.frame_cache_directory.c_str(), 0755);
+
+    cout << "Decoding " << source << " into the frame cache " << file_name << endl;
+
+    if (!create(video_source, file_name, source_size, cache_size, key) || !frame_cache->open(file_name, key)) {
+        cerr << "Cannot create the frame cache " << file_name << "." << endl;
+        delete frame_cache;
+        return NULL;
+    }
+
+    // Decoded videos take gigabytes, so do not keep the outdated ones
+    remove_stale_caches(settings.frame_cache_directory, prefix, name);
+
+    return frame_cache;
+}
+
+/**
+ * Decode all frames of the source into a cache file. The file is written
+ * under a unique temporary name and renamed when complete, so an interrupted
+ * run never leaves a cache behind that looks valid and several runs creating
+ * the same cache at once do not write into the same file.
+ *
+ * @param frame_source
+ * @param file_name
+ * @param source_size size of the frames of the source
+ * @param cache_size frames are resized to this size
+ * @param key
+ * @return false if the file cannot be written
+ */
+bool FrameCache::create(FrameSource& frame_source, string file_name, Size source_size, Size cache_size, uint64_t key) {
+
+    vector<char> temporary_name(file_name.begin(), file_name.end());
+    const char * suffix = ".XXXXXX";
+    temporary_name.insert(temporary_name.end(), suffix, suffix + strlen(suffix) + 1);
+
+    int file_descriptor = mkstemp(temporary_name.data());
+    if (file_descriptor < 0) {
+        return false;
+    }
+    ::close(file_descriptor);
+
+    string temporary_file_name(temporary_name.data());
+    ofstream file(temporary_file_name, ios::binary | ios::trunc);
+
+    if (!file.is_open()) {
+        remove(temporary_file_name.c_str());
+        return false;
+    }
+
+    FrameCacheHeader file_header;
+    memset(&file_header, 0, sizeof(file_header));
+    memcpy(file_header.magic, FRAME_CACHE_MAGIC, sizeof(file_header.magic));
+    file_header.version = FRAME_CACHE_VERSION;
+    file_header.type = CV_8UC3;
+    file_header.width = cache_size.width;
+    file_header.height = cache_size.height;
+    file_header.source_width = source_size.width;
+    file_header.source_height = source_size.height;
+    file_header.key = key;
+    file_header.fps = frame_source.get_fps();
+    file_header.frame_size = (uint64_t) cache_size.area() * CV_ELEM_SIZE(file_header.type);
+
+    // Header is written again when the frames are known
+    file.write((const char *) &file_header, sizeof(file_header));
+
+    vector<uint64_t> frame_offsets;
+    vector<char> padding(FRAME_CACHE_ALIGNMENT, 0);
+    uint64_t offset = align_frame(sizeof(file_header));
+
+    Mat frame;
+    Mat resized_frame;
+
+    while (frame_source.read(frame)) {
+
+        if (frame.size() != cache_size) {
+            resize(frame, resized_frame, cache_size, 0, 0, INTER_AREA);
+        } else {
+            resized_frame = frame;
+        }
+
+        if (resized_frame.type() != (int) file_header.type) {
+            cerr << "Only 8 bit BGR frames can be cached." << endl;
+            file.close();
+            remove(temporary_file_name.c_str());
+            return false;
+        }
+
+        file.write(padding.data(), offset - file.tellp());
+
+        // Rows of the frame can be padded in memory
+        for (int row = 0; row < resized_frame.rows; row++) {
+            file.write((const char *) resized_frame.ptr(row), resized_frame.cols * resized_frame.elemSize());
+        }
+
+        frame_offsets.push_back(offset);
+        offset = align_frame(offset + file_header.frame_size);
+    }
+
+    // Index after the last frame
+    file.write(padding.data(), offset - file.tellp());
+    file.write((const char *) frame_offsets.data(), frame_offsets.size() * sizeof(uint64_t));
+
+    file_header.frame_count = frame_offsets.size();
+    file_header.index_offset = offset;
+
+    file.seekp(0);
+    file.write((const char *) &file_header, sizeof(file_header));
+    file.close();
+
+    if (!file.good() || rename(temporary_file_name.c_str(), file_name.c_str()) != 0) {
+        remove(temporary_file_name.c_str());
+        return false;
+    }
+
+    // Temporary files are created readable by the owner only
+    chmod(file_name.c_str(), 0644);
+
+    return true;
+}
+
+/**
+ * Get cache key of a video file. It changes when the file is replaced or
+ * modified or the cached resolution changes.
+ *
+ * @param source video file
+ * @param height_limit frames higher than this are downscaled, 0 for none
+ * @return
+ */
+uint64_t FrameCache::get_key(string source, int height_limit) {
+
+    ostringstream description;
+    description << FRAME_CACHE_VERSION << "|" << source << "|" << height_limit;
+
+    struct stat file_status;
+    if (stat(source.c_str(), &file_status) == 0) {
+        description << "|" << file_status.st_size << "|" << file_status.st_mtime;
+    }
+
+    return hash_text(description.str());
+}
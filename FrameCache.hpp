@@ -0,0 +1,109 @@
+/*
+ * File:   FrameCache.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef FRAMECACHE_HPP
+#define FRAMECACHE_HPP
+
+#include <string>
+#include <stdint.h>
+#include "FrameSource.hpp"
+#include "Settings.hpp"
+
+// Frame cache file starts with this header. Frames follow, each aligned to a
+// page, and the index of their offsets is at the end of the file.
+struct FrameCacheHeader {
+
+    // "EMILYFRC"
+    char magic[8];
+
+    // Format version, increased whenever the layout changes
+    uint32_t version;
+
+    // OpenCV type of the frames
+    uint32_t type;
+
+    uint32_t width;
+    uint32_t height;
+
+    // Size of the frames of the source before downscaling
+    uint32_t source_width;
+    uint32_t source_height;
+
+    // Key of the source and resolution the cache was created for
+    uint64_t key;
+
+    uint64_t frame_count;
+
+    // Size of one frame in bytes
+    uint64_t frame_size;
+
+    // Frame rate of the source
+    double fps;
+
+    // Offset of the index of frame offsets
+    uint64_t index_offset;
+};
+
+#define FRAME_CACHE_MAGIC "EMILYFRC"
+#define FRAME_CACHE_VERSION 1
+
+// Frames are aligned to pages of this size
+#define FRAME_CACHE_ALIGNMENT 4096
+
+/**
+ * Decoded frames of a video in a raw file. Frames are read from a read-only
+ * memory mapping of the file without copying, so repeated replays of a video
+ * cost no decoding. The cache is keyed by the source file, its size and
+ * modification time and the cached resolution, and is created again when any
+ * of them changes.
+ *
+ * Frames read from the cache point into the mapping and must not be written.
+ */
+class FrameCache : public FrameSource {
+public:
+    FrameCache();
+    FrameCache(const FrameCache& orig);
+    virtual ~FrameCache();
+
+    bool open(string, uint64_t);
+
+    void close();
+
+    bool read(Mat&);
+
+    double get_fps();
+
+    Size get_size();
+
+    Size get_source_size();
+
+    bool is_live();
+
+    long get_frame_count();
+
+    bool is_mapped(const Mat&);
+
+    static FrameCache * open_video(string, Settings&);
+
+    static bool create(FrameSource&, string, Size, Size, uint64_t);
+
+    static uint64_t get_key(string, int);
+
+private:
+
+    // Memory mapped file
+    const char * data;
+    size_t size;
+
+    const FrameCacheHeader * header;
+    const uint64_t * index;
+
+    // Number of the next frame read
+    long frame_number;
+
+};
+
+#endif /* FRAMECACHE_HPP */
+
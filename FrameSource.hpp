@@ -0,0 +1,59 @@
+/*
+ * File:   FrameSource.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef FRAMESOURCE_HPP
+#define FRAMESOURCE_HPP
+
+#include "opencv2/opencv.hpp"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Source of the frames processed by the tracker, e.g. a video file, a live
+ * stream or a rendered scene.
+ */
+class FrameSource {
+public:
+
+    virtual ~FrameSource() {
+    }
+
+    /**
+     * Read the next frame. Sources may write into the memory of the given
+     * frame, so it has to be a new matrix if the previous frame is still in
+     * use.
+     *
+     * @param frame
+     * @return false if the source ended
+     */
+    virtual bool read(Mat& frame) = 0;
+
+    /**
+     * Get frame rate of the source.
+     *
+     * @return frames per second, 0 if unknown
+     */
+    virtual double get_fps() = 0;
+
+    /**
+     * Get size of the frames.
+     *
+     * @return
+     */
+    virtual Size get_size() = 0;
+
+    /**
+     * Check if the source is live. Frames of live sources can be dropped when
+     * the processing cannot keep up.
+     *
+     * @return
+     */
+    virtual bool is_live() = 0;
+
+};
+
+#endif /* FRAMESOURCE_HPP */
+
@@ -0,0 +1,153 @@
+/*
+ * File:   LatencyHistogram.cpp
+ * Author: Jan Dufek
+ */
+
+#include "LatencyHistogram.hpp"
+#include <sstream>
+#include <iomanip>
+
+#define SUB_BUCKETS (1 << LATENCY_HISTOGRAM_PRECISION_BITS)
+#define HALF_SUB_BUCKETS (SUB_BUCKETS / 2)
+
+LatencyHistogram::LatencyHistogram() {
+
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        buckets[i] = 0;
+    }
+
+    count = 0;
+    sum = 0;
+    max = 0;
+}
+
+LatencyHistogram::LatencyHistogram(const LatencyHistogram& orig) {
+}
+
+LatencyHistogram::~LatencyHistogram() {
+}
+
+/**
+ * Get bucket of the value. Values are shifted right until they fit to the
+ * upper half of the sub buckets, and the shift selects the group of buckets.
+ *
+ * @param value in microseconds
+ * @return
+ */
+int LatencyHistogram::get_bucket(long value) {
+
+    if (value < 0) {
+        value = 0;
+    }
+
+    if (value >= (1L << LATENCY_HISTOGRAM_RANGE_BITS)) {
+        value = (1L << LATENCY_HISTOGRAM_RANGE_BITS) - 1;
+    }
+
+    int shift = 0;
+    while ((value >> shift) >= SUB_BUCKETS) {
+        shift++;
+    }
+
+    return HALF_SUB_BUCKETS * shift + (int) (value >> shift);
+}
+
+/**
+ * Get the largest value falling to the bucket.
+ *
+ * @param bucket
+ * @return value in microseconds
+ */
+long LatencyHistogram::get_bucket_upper_bound(int bucket) {
+
+    int shift = bucket < SUB_BUCKETS ? 0 : bucket / HALF_SUB_BUCKETS - 1;
+    long sub_bucket = bucket - HALF_SUB_BUCKETS * shift;
+
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+/**
+ * Record one latency.
+ *
+ * @param value in microseconds
+ */
+void LatencyHistogram::record(long value) {
+
+    buckets[get_bucket(value)].fetch_add(1, memory_order_relaxed);
+
+    count.fetch_add(1, memory_order_relaxed);
+    sum.fetch_add(value, memory_order_relaxed);
+
+    long current_max = max.load(memory_order_relaxed);
+    while (value > current_max && !max.compare_exchange_weak(current_max, value, memory_order_relaxed)) {
+    }
+}
+
+long LatencyHistogram::get_count() {
+    return count;
+}
+
+long LatencyHistogram::get_max() {
+    return max;
+}
+
+/**
+ * Get mean latency.
+ *
+ * @return mean in microseconds
+ */
+double LatencyHistogram::get_mean() {
+    long n = count;
+    return n > 0 ? (double) sum / n : 0;
+}
+
+/**
+ * Get latency below which the given percentage of the recorded latencies are.
+ *
+ * @param percentile from 0 to 100
+ * @return latency in microseconds
+ */
+long LatencyHistogram::get_percentile(double percentile) {
+
+    long n = count;
+    if (n == 0) {
+        return 0;
+    }
+
+    // Number of values at or below the percentile
+    long rank = (long) (percentile / 100.0 * n + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    long seen = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            long bound = get_bucket_upper_bound(i);
+            long current_max = max;
+            return bound < current_max ? bound : current_max;
+        }
+    }
+
+    return max;
+}
+
+/**
+ * Get summary of the histogram with latencies in milliseconds.
+ *
+ * @return count, mean, p50, p90, p99, p99.9 and max
+ */
+string LatencyHistogram::to_string() {
+
+    ostringstream text;
+    text << fixed << setprecision(2);
+    text << get_count() << " frames, mean " << get_mean() / 1000.0;
+    text << " ms, p50 " << get_percentile(50) / 1000.0;
+    text << " ms, p90 " << get_percentile(90) / 1000.0;
+    text << " ms, p99 " << get_percentile(99) / 1000.0;
+    text << " ms, p99.9 " << get_percentile(99.9) / 1000.0;
+    text << " ms, max " << get_max() / 1000.0 << " ms";
+
+    return text.str();
+}
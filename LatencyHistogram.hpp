@@ -0,0 +1,63 @@
+/*
+ * File:   LatencyHistogram.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#include <atomic>
+#include <string>
+
+using namespace std;
+
+// Values below 2^LATENCY_HISTOGRAM_PRECISION_BITS microseconds have their own
+// buckets. Larger values share buckets within 1/2^(bits - 1) of the value.
+#define LATENCY_HISTOGRAM_PRECISION_BITS 7
+
+// Largest value in microseconds is below 2^LATENCY_HISTOGRAM_RANGE_BITS
+#define LATENCY_HISTOGRAM_RANGE_BITS 40
+
+#define LATENCY_HISTOGRAM_BUCKETS ((LATENCY_HISTOGRAM_RANGE_BITS - LATENCY_HISTOGRAM_PRECISION_BITS + 2) << (LATENCY_HISTOGRAM_PRECISION_BITS - 1))
+
+/**
+ * Histogram of latencies in microseconds with buckets of logarithmically
+ * growing width, the same way as HDR histograms. Percentiles are within 2 %
+ * of the exact ones and recording costs one increment. Can be recorded by one
+ * thread while read by others.
+ */
+class LatencyHistogram {
+public:
+
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram& orig);
+    virtual ~LatencyHistogram();
+
+    void record(long);
+
+    long get_count();
+
+    long get_max();
+
+    double get_mean();
+
+    long get_percentile(double);
+
+    string to_string();
+
+    static int get_bucket(long);
+
+    static long get_bucket_upper_bound(int);
+
+private:
+
+    atomic<long> buckets[LATENCY_HISTOGRAM_BUCKETS];
+
+    atomic<long> count;
+    atomic<long> sum;
+    atomic<long> max;
+
+};
+
+#endif /* LATENCYHISTOGRAM_HPP */
+
@@ -0,0 +1,94 @@
+/*
+ * File:   LogRecord.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef LOGRECORD_HPP
+#define LOGRECORD_HPP
+
+#include <stdint.h>
+
+// Binary log file starts with this header followed by metadata_size bytes of
+// metadata text and then by LogRecord structures
+struct LogFileHeader {
+
+    // "EMILYLOG"
+    char magic[8];
+
+    // Format version, increased whenever LogRecord changes
+    uint32_t version;
+
+    // Size of one record in bytes
+    uint32_t record_size;
+
+    // Size of the metadata text describing the mission (video source,
+    // settings and calibration) in bytes
+    uint32_t metadata_size;
+
+    uint32_t reserved;
+};
+
+#define LOG_FILE_MAGIC "EMILYLOG"
+#define LOG_FILE_VERSION 3
+
+// Latency which was not measured for the record
+#define LATENCY_NOT_MEASURED -1
+
+// Status of the system in one processed frame. Fixed size and trivially
+// copyable, so it is written to the log file as it is.
+struct LogRecord {
+
+    // Wall clock time in microseconds since the epoch, in replay mode time of
+    // the frame in the video
+    int64_t time;
+
+    int64_t frame_number;
+
+    // EMILY location
+    int32_t emily_x;
+    int32_t emily_y;
+
+    // EMILY pose line segment
+    int32_t emily_pose_1_x;
+    int32_t emily_pose_1_y;
+    int32_t emily_pose_2_x;
+    int32_t emily_pose_2_y;
+
+    // Target location
+    int32_t target_x;
+    int32_t target_y;
+
+    double emily_angle;
+
+    double distance_to_target;
+
+    double angle_error_to_target;
+
+    double throttle;
+
+    double rudder;
+
+    int32_t status;
+
+    int32_t reserved;
+
+    double time_to_target;
+
+    // Latency in microseconds from capture to the end of preprocessing, from
+    // there to the end of tracking, to the end of control and to sending the
+    // commands, and the total from capture to sending the commands. Send and
+    // total latency are LATENCY_NOT_MEASURED when the commands are sent by the
+    // command thread, which is not once per frame, and all of them in replay
+    // mode, where they would differ between runs. Mission statistics skip
+    // them.
+    int32_t preprocess_latency;
+    int32_t track_latency;
+    int32_t control_latency;
+    int32_t send_latency;
+    int32_t total_latency;
+
+    int32_t reserved_2;
+};
+
+#endif /* LOGRECORD_HPP */
+
@@ -4,14 +4,47 @@
  */
 
 #include "Logger.hpp"
+#include "MissionLog.hpp"
+#include "Trace.hpp"
+#include <iostream>
+#include <string.h>
+#include <time.h>
 
-Logger::Logger(string name) {
+/**
+ * Open binary log name.log and start the writer thread.
+ *
+ * @param s settings
+ * @param n log name without extension
+ * @param metadata text describing the mission stored in the log header
+ */
+Logger::Logger(Settings& s, string n, string metadata) {
+
+    settings = &s;
+    name = n;
+
+    records = new RingBuffer<LogRecord>(settings->LOG_BUFFER_SIZE);
+    batch.resize(records->get_capacity());
 
-    general_log_file.open(name + ".txt");
+    written_records = 0;
+    written_batches = 0;
 
-    rudder_log_file.open(name + "_rudder.txt");
+    log_file.open(name + ".log", ios::binary);
 
-    throttle_log_file.open(name + "_throttle.txt");
+    if (!log_file.is_open()) {
+        cout << "Cannot open the log file " << name << ".log for write." << endl;
+    }
+
+    LogFileHeader header;
+    memcpy(header.magic, LOG_FILE_MAGIC, sizeof(header.magic));
+    header.version = LOG_FILE_VERSION;
+    header.record_size = sizeof(LogRecord);
+    header.metadata_size = metadata.size();
+    header.reserved = 0;
+    log_file.write((const char *) &header, sizeof(header));
+    log_file.write(metadata.data(), metadata.size());
+
+    running = true;
+    writer_thread = thread(&Logger::run, this);
 
 }
 
@@ -20,68 +53,188 @@ Logger::Logger(const Logger& orig) {
 
 Logger::~Logger() {
     close();
+    delete records;
 }
 
 /**
- * Log string message into general log.
- * 
- * @param message
+ * Log one record. Only copies the record into the ring buffer, so it can be
+ * called from time critical code. Must be called from a single thread.
+ *
+ * @param record
+ * @return false if the buffer was full and the record was dropped
  */
-void Logger::log_general(string message) {
-    general_log_file << message;
+bool Logger::log(const LogRecord& record) {
+    return records->push(record);
 }
 
 /**
- * Log double value into general log.
- * 
- * @param message
+ * Log one record without dropping it. Waits while the buffer is full, so it
+ * is only for replay, where the log must not depend on timing. Must be called
+ * from a single thread.
+ *
+ * @param record
  */
-void Logger::log_general(double message) {
-    general_log_file << message;
+void Logger::log_waiting(const LogRecord& record) {
+
+    while (records->size() == records->get_capacity()) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    records->push(record);
 }
 
 /**
- * Log rudder string value into rudder log.
- * 
- * @param message
+ * Writer loop. Writes buffered records in batches.
+ *
  */
-void Logger::log_rudder(string message) {
-    rudder_log_file << message;
+void Logger::run() {
+
+    Trace::set_thread_name("Log");
+
+    while (running) {
+        write_records();
+        this_thread::sleep_for(chrono::milliseconds(settings->LOG_WRITE_INTERVAL));
+    }
 }
 
 /**
- * Log rudder double value into rudder log.
- * 
- * @param message
+ * Write all the buffered records to the log file.
+ *
  */
-void Logger::log_rudder(double message) {
-    rudder_log_file << message;
+void Logger::write_records() {
+
+    TraceScope trace_scope("Write log");
+
+    int n;
+    while ((n = records->pop(batch.data(), (int) batch.size())) > 0) {
+        log_file.write((const char *) batch.data(), n * sizeof(LogRecord));
+        written_records += n;
+        written_batches++;
+    }
+
+    log_file.flush();
 }
 
 /**
- * Log throttle string value into throttle log.
+ * Write the remaining records and close the log. Exports the text logs if
+ * enabled.
  * 
- * @param message
  */
-void Logger::log_throttle(string message) {
-    throttle_log_file << message;
+void Logger::close() {
+
+    if (!writer_thread.joinable()) {
+        return;
+    }
+
+    running = false;
+    writer_thread.join();
+
+    write_records();
+    log_file.close();
+
+    if (settings->log_text_export) {
+        export_text(name);
+    }
+
+    if (settings->log_mission_export) {
+        MissionLog::convert(name + ".log", name + ".mission", end_metadata);
+    }
 }
 
 /**
- * Log throttle double value into throttle log.
- * 
- * @param message
+ * Add "key = value" lines to the metadata of the mission log. Used for results
+ * known only at the end of the mission. Must be called before close.
+ *
+ * @param metadata
  */
-void Logger::log_throttle(double message) {
-    throttle_log_file << message;
+void Logger::add_metadata(string metadata) {
+    end_metadata += metadata;
 }
 
 /**
- * Close log files.
- * 
+ * Get number of records written to the log file.
+ *
+ * @return
  */
-void Logger::close() {
-    general_log_file.close();
-    rudder_log_file.close();
-    throttle_log_file.close();
-}
\ No newline at end of file
+long Logger::get_written_records() {
+    return written_records;
+}
+
+/**
+ * Get number of records dropped because the buffer was full.
+ *
+ * @return
+ */
+long Logger::get_dropped_records() {
+    return records->get_dropped();
+}
+
+/**
+ * Print log statistics to the console.
+ *
+ */
+void Logger::print_statistics() {
+    long batches = written_batches;
+    double records_per_batch = batches > 0 ? (double) written_records / batches : 0;
+    cout << "Log: " << written_records << " records, " << records_per_batch << " records/write, buffer " << records->size() << "/" << records->get_capacity() << ", dropped " << get_dropped_records() << endl;
+}
+
+/**
+ * Export binary log name.log to the text logs name.txt, name_rudder.txt and
+ * name_throttle.txt.
+ *
+ * @param name log name without extension
+ * @return false if the binary log cannot be read
+ */
+bool Logger::export_text(string name) {
+
+    ifstream log_file(name + ".log", ios::binary);
+
+    LogFileHeader header;
+    if (!log_file.read((char *) &header, sizeof(header)) || memcmp(header.magic, LOG_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        cout << "Cannot read the log file " << name << ".log." << endl;
+        return false;
+    }
+
+    if (header.version != LOG_FILE_VERSION || header.record_size != sizeof(LogRecord)) {
+        cout << "Log file " << name << ".log has unsupported version " << header.version << "." << endl;
+        return false;
+    }
+
+    log_file.ignore(header.metadata_size);
+
+    ofstream general_log_file(name + ".txt");
+    ofstream rudder_log_file(name + "_rudder.txt");
+    ofstream throttle_log_file(name + "_throttle.txt");
+
+    LogRecord record;
+    while (log_file.read((char *) &record, sizeof(record))) {
+
+        // Log throttle
+        throttle_log_file << record.throttle << "\n";
+
+        // Log rudder
+        rudder_log_file << record.rudder << "\n";
+
+        // Time in the local time zone
+        time_t raw_time = (time_t) (record.time / 1000000);
+        struct tm local_time;
+        localtime_r(&raw_time, &local_time);
+        char current_time[40];
+        strftime(current_time, 40, "%Y%m%d%H%M%S", &local_time);
+
+        general_log_file << current_time << " " << record.frame_number << " ";
+        general_log_file << record.emily_x << " " << record.emily_y << " ";
+        general_log_file << record.emily_pose_1_x << " " << record.emily_pose_1_y << " " << record.emily_pose_2_x << " " << record.emily_pose_2_y << " ";
+        general_log_file << record.target_x << " " << record.target_y << " ";
+        general_log_file << record.emily_angle << " ";
+        general_log_file << record.distance_to_target << " ";
+        general_log_file << record.angle_error_to_target << " ";
+        general_log_file << record.throttle << " ";
+        general_log_file << record.rudder << " ";
+        general_log_file << record.status << " ";
+        general_log_file << record.time_to_target << "\n";
+    }
+
+    return true;
+}
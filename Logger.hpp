@@ -7,40 +7,73 @@
 #define LOGGER_HPP
 
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include "Settings.hpp"
+#include "LogRecord.hpp"
+#include "RingBuffer.hpp"
 
 using namespace std;
 
+/**
+ * Binary telemetry log. Records are pushed into a lock-free ring buffer and
+ * written to name.log in batches by a background thread, so logging costs the
+ * caller only a copy of the record. The text logs can be exported from the
+ * binary log.
+ */
 class Logger {
 public:
-    Logger();
-    Logger(string);
+    Logger(Settings&, string, string);
     Logger(const Logger& orig);
     virtual ~Logger();
     
-    void log_general(string);
+    bool log(const LogRecord&);
     
-    void log_general(double);
+    void log_waiting(const LogRecord&);
     
-    void log_rudder(string);
+    void close();
     
-    void log_rudder(double);
+    void add_metadata(string);
     
-    void log_throttle(string);
+    long get_written_records();
     
-    void log_throttle(double);
+    long get_dropped_records();
     
-    void close();
+    void print_statistics();
+    
+    static bool export_text(string);
     
 private:
     
-    // General log file
-    ofstream general_log_file;
+    void run();
+    
+    void write_records();
+    
+    // Program settings
+    Settings * settings;
+    
+    // Log name without extension
+    string name;
+    
+    // Records waiting for writing
+    RingBuffer<LogRecord> * records;
+    
+    // Metadata known only at the end of the mission, added to the mission log
+    string end_metadata;
+    
+    // Batch of records taken from the ring buffer
+    vector<LogRecord> batch;
+    
+    // Binary log file
+    ofstream log_file;
+    
+    thread writer_thread;
     
-    // Rudder log file
-    ofstream rudder_log_file;
+    atomic<bool> running;
     
-    // Control log file
-    ofstream throttle_log_file;
+    // Statistics
+    atomic<long> written_records;
+    atomic<long> written_batches;
 
 };
 
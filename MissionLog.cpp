@@ -0,0 +1,332 @@
+/*
+ * File:   MissionLog.cpp
+ * Author: Jan Dufek
+ */
+
+#include "MissionLog.hpp"
+#include <iostream>
+#include <fstream>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Column of the mission log filled from one LogRecord field
+struct ColumnDefinition {
+    const char * name;
+    const char * unit;
+    int type;
+    size_t offset;
+};
+
+static const ColumnDefinition COLUMN_DEFINITIONS[] = {
+    {"time", "us", COLUMN_INT64, offsetof(LogRecord, time)},
+    {"frame_number", "", COLUMN_INT64, offsetof(LogRecord, frame_number)},
+    {"emily_x", "px", COLUMN_INT32, offsetof(LogRecord, emily_x)},
+    {"emily_y", "px", COLUMN_INT32, offsetof(LogRecord, emily_y)},
+    {"emily_pose_1_x", "px", COLUMN_INT32, offsetof(LogRecord, emily_pose_1_x)},
+    {"emily_pose_1_y", "px", COLUMN_INT32, offsetof(LogRecord, emily_pose_1_y)},
+    {"emily_pose_2_x", "px", COLUMN_INT32, offsetof(LogRecord, emily_pose_2_x)},
+    {"emily_pose_2_y", "px", COLUMN_INT32, offsetof(LogRecord, emily_pose_2_y)},
+    {"target_x", "px", COLUMN_INT32, offsetof(LogRecord, target_x)},
+    {"target_y", "px", COLUMN_INT32, offsetof(LogRecord, target_y)},
+    {"emily_angle", "deg", COLUMN_FLOAT64, offsetof(LogRecord, emily_angle)},
+    {"distance_to_target", "px", COLUMN_FLOAT64, offsetof(LogRecord, distance_to_target)},
+    {"angle_error_to_target", "deg", COLUMN_FLOAT64, offsetof(LogRecord, angle_error_to_target)},
+    {"throttle", "", COLUMN_FLOAT64, offsetof(LogRecord, throttle)},
+    {"rudder", "", COLUMN_FLOAT64, offsetof(LogRecord, rudder)},
+    {"status", "", COLUMN_INT32, offsetof(LogRecord, status)},
+    {"time_to_target", "s", COLUMN_FLOAT64, offsetof(LogRecord, time_to_target)},
+    {"preprocess_latency", "us", COLUMN_INT32, offsetof(LogRecord, preprocess_latency)},
+    {"track_latency", "us", COLUMN_INT32, offsetof(LogRecord, track_latency)},
+    {"control_latency", "us", COLUMN_INT32, offsetof(LogRecord, control_latency)},
+    {"send_latency", "us", COLUMN_INT32, offsetof(LogRecord, send_latency)},
+    {"total_latency", "us", COLUMN_INT32, offsetof(LogRecord, total_latency)}
+};
+
+static const int COLUMN_DEFINITION_COUNT = sizeof(COLUMN_DEFINITIONS) / sizeof(COLUMN_DEFINITIONS[0]);
+
+/**
+ * Get size of a value of given type.
+ *
+ * @param type
+ * @return
+ */
+static int get_type_width(int type) {
+    return type == COLUMN_INT32 ? 4 : 8;
+}
+
+/**
+ * Round offset up to a multiple of 8 bytes.
+ *
+ * @param offset
+ * @return
+ */
+static uint64_t align_8(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t) 7;
+}
+
+MissionLog::MissionLog() {
+    data = NULL;
+    size = 0;
+    header = NULL;
+    columns = NULL;
+}
+
+MissionLog::MissionLog(const MissionLog& orig) {
+}
+
+MissionLog::~MissionLog() {
+    close();
+}
+
+/**
+ * Memory map the mission log file and check its layout.
+ *
+ * @param name file name
+ * @return false if the file cannot be read or is not a valid mission log
+ */
+bool MissionLog::open(string name) {
+
+    close();
+
+    file_name = name;
+
+    int file_descriptor = ::open(name.c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+        cerr << "Cannot open the mission log " << name << "." << endl;
+        return false;
+    }
+
+    struct stat file_status;
+    if (fstat(file_descriptor, &file_status) != 0 || (size_t) file_status.st_size < sizeof(MissionLogHeader)) {
+        cerr << "Mission log " << name << " is too short." << endl;
+        ::close(file_descriptor);
+        return false;
+    }
+
+    size = file_status.st_size;
+    void * mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+    ::close(file_descriptor);
+
+    if (mapping == MAP_FAILED) {
+        cerr << "Cannot map the mission log " << name << "." << endl;
+        size = 0;
+        return false;
+    }
+
+    data = (const char *) mapping;
+    header = (const MissionLogHeader *) data;
+    columns = (const MissionLogColumn *) (data + sizeof(MissionLogHeader));
+
+    bool valid = memcmp(header->magic, MISSION_LOG_MAGIC, sizeof(header->magic)) == 0 && header->version == MISSION_LOG_VERSION;
+
+    // Everything the header points to must be within the file
+    valid = valid && sizeof(MissionLogHeader) + header->column_count * sizeof(MissionLogColumn) <= size;
+    valid = valid && header->metadata_offset + header->metadata_size <= size;
+
+    for (uint32_t i = 0; valid && i < header->column_count; i++) {
+        valid = columns[i].offset % 8 == 0 && columns[i].offset + header->row_count * columns[i].width <= size;
+        valid = valid && columns[i].width == (uint32_t) get_type_width(columns[i].type);
+    }
+
+    if (!valid) {
+        cerr << "File " << name << " is not a valid mission log version " << MISSION_LOG_VERSION << "." << endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Unmap the file.
+ *
+ */
+void MissionLog::close() {
+
+    if (data != NULL) {
+        munmap((void *) data, size);
+    }
+
+    data = NULL;
+    size = 0;
+    header = NULL;
+    columns = NULL;
+}
+
+string MissionLog::get_file_name() {
+    return file_name;
+}
+
+long MissionLog::get_row_count() {
+    return header->row_count;
+}
+
+int MissionLog::get_column_count() {
+    return header->column_count;
+}
+
+const MissionLogColumn& MissionLog::get_column(int column) {
+    return columns[column];
+}
+
+/**
+ * Find column by name.
+ *
+ * @param name
+ * @return index of the column or -1 if there is no such column
+ */
+int MissionLog::find_column(string name) {
+
+    for (uint32_t i = 0; i < header->column_count; i++) {
+        if (strncmp(columns[i].name, name.c_str(), sizeof(columns[i].name)) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Get values of the column. They are of the column type and there is one for
+ * each row.
+ *
+ * @param column
+ * @return
+ */
+const void * MissionLog::get_column_data(int column) {
+    return data + columns[column].offset;
+}
+
+/**
+ * Get one value converted to double.
+ *
+ * @param column
+ * @param row
+ * @return
+ */
+double MissionLog::get_value(int column, long row) {
+
+    const void * values = get_column_data(column);
+
+    switch (columns[column].type) {
+        case COLUMN_INT32:
+            return ((const int32_t *) values)[row];
+        case COLUMN_INT64:
+            return (double) ((const int64_t *) values)[row];
+        default:
+            return ((const double *) values)[row];
+    }
+}
+
+/**
+ * Get metadata text describing the mission.
+ *
+ * @return
+ */
+string MissionLog::get_metadata() {
+    return string(data + header->metadata_offset, header->metadata_size);
+}
+
+/**
+ * Write records to a mission log file.
+ *
+ * @param name file name
+ * @param metadata text describing the mission
+ * @param records
+ * @return false if the file cannot be written
+ */
+bool MissionLog::write(string name, const string& metadata, const vector<LogRecord>& records) {
+
+    ofstream file(name, ios::binary);
+
+    if (!file.is_open()) {
+        cerr << "Cannot open the mission log " << name << " for write." << endl;
+        return false;
+    }
+
+    MissionLogHeader file_header;
+    memset(&file_header, 0, sizeof(file_header));
+    memcpy(file_header.magic, MISSION_LOG_MAGIC, sizeof(file_header.magic));
+    file_header.version = MISSION_LOG_VERSION;
+    file_header.column_count = COLUMN_DEFINITION_COUNT;
+    file_header.row_count = records.size();
+    file_header.metadata_offset = sizeof(MissionLogHeader) + COLUMN_DEFINITION_COUNT * sizeof(MissionLogColumn);
+    file_header.metadata_size = metadata.size();
+
+    // Column table
+    vector<MissionLogColumn> file_columns(COLUMN_DEFINITION_COUNT);
+    uint64_t offset = align_8(file_header.metadata_offset + file_header.metadata_size);
+
+    for (int i = 0; i < COLUMN_DEFINITION_COUNT; i++) {
+        memset(&file_columns[i], 0, sizeof(MissionLogColumn));
+        strncpy(file_columns[i].name, COLUMN_DEFINITIONS[i].name, sizeof(file_columns[i].name) - 1);
+        strncpy(file_columns[i].unit, COLUMN_DEFINITIONS[i].unit, sizeof(file_columns[i].unit) - 1);
+        file_columns[i].type = COLUMN_DEFINITIONS[i].type;
+        file_columns[i].width = get_type_width(COLUMN_DEFINITIONS[i].type);
+        file_columns[i].offset = offset;
+        offset = align_8(offset + records.size() * file_columns[i].width);
+    }
+
+    file.write((const char *) &file_header, sizeof(file_header));
+    file.write((const char *) file_columns.data(), file_columns.size() * sizeof(MissionLogColumn));
+    file.write(metadata.data(), metadata.size());
+
+    // Column data gathered from the records
+    vector<char> values;
+    const char padding[8] = {0};
+
+    for (int i = 0; i < COLUMN_DEFINITION_COUNT; i++) {
+
+        file.write(padding, file_columns[i].offset - file.tellp());
+
+        int width = file_columns[i].width;
+        values.resize(records.size() * width);
+
+        for (size_t row = 0; row < records.size(); row++) {
+            memcpy(&values[row * width], (const char *) &records[row] + COLUMN_DEFINITIONS[i].offset, width);
+        }
+
+        file.write(values.data(), values.size());
+    }
+
+    return file.good();
+}
+
+/**
+ * Convert binary log written by Logger to a mission log file.
+ *
+ * @param log_name binary log file name
+ * @param name mission log file name
+ * @param extra_metadata text appended to the metadata from the binary log
+ * @return false if the binary log cannot be read or the mission log written
+ */
+bool MissionLog::convert(string log_name, string name, string extra_metadata) {
+
+    ifstream log_file(log_name, ios::binary);
+
+    LogFileHeader log_header;
+    if (!log_file.read((char *) &log_header, sizeof(log_header)) || memcmp(log_header.magic, LOG_FILE_MAGIC, sizeof(log_header.magic)) != 0) {
+        cerr << "Cannot read the log file " << log_name << "." << endl;
+        return false;
+    }
+
+    if (log_header.version != LOG_FILE_VERSION || log_header.record_size != sizeof(LogRecord)) {
+        cerr << "Log file " << log_name << " has unsupported version " << log_header.version << "." << endl;
+        return false;
+    }
+
+    string metadata(log_header.metadata_size, '\0');
+    log_file.read(&metadata[0], metadata.size());
+
+    // Whole records written before the log ended
+    vector<LogRecord> records;
+    LogRecord record;
+    while (log_file.read((char *) &record, sizeof(record))) {
+        records.push_back(record);
+    }
+
+    return write(name, metadata + extra_metadata, records);
+}
@@ -0,0 +1,117 @@
+/*
+ * File:   MissionLog.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef MISSIONLOG_HPP
+#define MISSIONLOG_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include "LogRecord.hpp"
+
+using namespace std;
+
+// Types of values in mission log columns
+enum MissionColumnType {
+    COLUMN_INT32,
+    COLUMN_INT64,
+    COLUMN_FLOAT64
+};
+
+// Mission log file starts with this header followed by the column table, the
+// metadata text and the column data. All offsets are from the start of the
+// file and column data is aligned to 8 bytes, so the file can be memory
+// mapped and columns used as arrays.
+struct MissionLogHeader {
+
+    // "EMILYMSN"
+    char magic[8];
+
+    // Format version, increased whenever the layout changes
+    uint32_t version;
+
+    uint32_t column_count;
+
+    uint64_t row_count;
+
+    // Metadata text describing the mission (video source, settings and
+    // calibration) as "key = value" lines
+    uint64_t metadata_offset;
+    uint64_t metadata_size;
+};
+
+// Description of one column
+struct MissionLogColumn {
+
+    // Zero terminated name and unit
+    char name[32];
+    char unit[16];
+
+    // MissionColumnType
+    uint32_t type;
+
+    // Size of one value in bytes
+    uint32_t width;
+
+    // Offset of the first value
+    uint64_t offset;
+};
+
+#define MISSION_LOG_MAGIC "EMILYMSN"
+#define MISSION_LOG_VERSION 1
+
+/**
+ * Columnar mission log. One fixed width column per LogRecord field, so a
+ * single quantity can be scanned across many missions without reading the
+ * rest. Files are written once at the end of the mission and read through
+ * a read-only memory mapping.
+ */
+class MissionLog {
+public:
+
+    MissionLog();
+    MissionLog(const MissionLog& orig);
+    virtual ~MissionLog();
+
+    bool open(string);
+
+    void close();
+
+    string get_file_name();
+
+    long get_row_count();
+
+    int get_column_count();
+
+    const MissionLogColumn& get_column(int);
+
+    int find_column(string);
+
+    const void * get_column_data(int);
+
+    double get_value(int, long);
+
+    string get_metadata();
+
+    static bool write(string, const string&, const vector<LogRecord>&);
+
+    static bool convert(string, string, string = "");
+
+private:
+
+    string file_name;
+
+    // Memory mapped file
+    const char * data;
+    size_t size;
+
+    const MissionLogHeader * header;
+    const MissionLogColumn * columns;
+
+};
+
+#endif /* MISSIONLOG_HPP */
+
@@ -1,34 +1,172 @@
-/* 
+/*
  * File:   OutputVideo.cpp
  * Author: Jan Dufek
  */
 
 #include "OutputVideo.hpp"
+#include "Trace.hpp"
 #include <iostream>
+#include <iomanip>
+#include <sstream>
 
 using namespace std;
 
-OutputVideo::OutputVideo(double f, Size s, string n) {
-    
+/**
+ * Video recorder writing segments name_000.avi, name_001.avi, ...
+ *
+ * @param s settings
+ * @param f frame rate of the input video
+ * @param sz frame size
+ * @param n name of the output video without extension
+ */
+OutputVideo::OutputVideo(Settings& s, double f, Size sz, string n) {
+
+    settings = &s;
     fps = f;
-    size = s;
+    size = sz;
     name = n;
-    
+
+    // Frame rate reduction never blocks, it checks for free space before pushing
+    frame_queue = new BoundedQueue<Mat>(settings->RECORD_QUEUE_SIZE, settings->record_policy == RECORD_DROP ? QUEUE_DROP_OLDEST : QUEUE_BLOCK);
+
+    segment_index = -1;
+    segment_frames = 0;
+    segment_fps = fps;
+    segment_decimation = 1;
+
+    decimation = 1;
+    offered_frames = 0;
+
+    recorded_frames = 0;
+    skipped_frames = 0;
+    encoding_time = 0;
+
 }
 
 OutputVideo::OutputVideo(const OutputVideo& orig) {
 }
 
 OutputVideo::~OutputVideo() {
+    stop();
+    delete frame_queue;
+}
+
+/**
+ * Start the recorder thread.
+ *
+ */
+void OutputVideo::start() {
+    backlog_time = chrono::steady_clock::now();
+    recorder_thread = thread(&OutputVideo::run, this);
+}
+
+/**
+ * Stop accepting frames, encode the frames already queued and close the
+ * video.
+ *
+ */
+void OutputVideo::stop() {
+    frame_queue->close();
+
+    if (recorder_thread.joinable()) {
+        recorder_thread.join();
+    }
+}
+
+/**
+ * Queue frame for recording. Depending on the policy, waits for free space,
+ * drops the oldest queued frame or reduces the frame rate when the encoder
+ * cannot keep up. The frame must not be modified afterwards.
+ *
+ * @param frame
+ * @return false if the frame will not be recorded
+ */
+bool OutputVideo::record(const Mat& frame) {
+
+    if (settings->record_policy == RECORD_REDUCE_FPS) {
+
+        int current_decimation = decimation;
+
+        // Skip frames to the reduced frame rate
+        if (offered_frames++ % current_decimation != 0) {
+            skipped_frames++;
+            return false;
+        }
+
+        // Encoder is behind, so reduce the frame rate further
+        if (frame_queue->size() == frame_queue->get_capacity()) {
+            if (current_decimation < settings->RECORD_MAX_DECIMATION) {
+                decimation = current_decimation * 2;
+            }
+            skipped_frames++;
+            return false;
+        }
+    }
+
+    return frame_queue->push(frame);
+}
+
+/**
+ * Recorder loop.
+ *
+ */
+void OutputVideo::run() {
+
+    Trace::set_thread_name("Record");
+
+    Mat frame;
+
+    while (frame_queue->pop(frame)) {
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        TraceScope trace_scope("Encode");
+
+        int current_decimation = decimation;
+
+        // New segment when the current one is full or the frame rate changed,
+        // so that each segment plays at the real speed
+        bool segment_full = settings->record_segment_length > 0 && segment_frames >= settings->record_segment_length * segment_fps;
+        if (segment_index < 0 || segment_full || current_decimation != segment_decimation) {
+            open_segment(current_decimation);
+        }
+
+        video_writer << frame;
+        segment_frames++;
+        recorded_frames++;
+
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        encoding_time += chrono::duration_cast<chrono::microseconds>(end - start).count();
+
+        // Raise the frame rate again after the encoder kept up for a while
+        if (frame_queue->size() > 0) {
+            backlog_time = end;
+        } else if (current_decimation > 1 && end - backlog_time > chrono::seconds(settings->RECORD_RECOVERY_TIME)) {
+            decimation = current_decimation / 2;
+            backlog_time = end;
+        }
+    }
+
+    video_writer.release();
 }
 
 /**
- * Initialize video writer.
- * 
- * @return 
+ * Close the current segment and open the next one.
+ *
+ * @param frame_decimation only every n-th frame will be recorded
  */
-VideoWriter OutputVideo::get_video_writer() {
-    
+void OutputVideo::open_segment(int frame_decimation) {
+
+    video_writer.release();
+
+    segment_index++;
+    segment_frames = 0;
+    segment_decimation = frame_decimation;
+    segment_fps = fps / frame_decimation;
+
+    ostringstream file_name;
+    file_name << name << "_" << setw(3) << setfill('0') << segment_index << ".avi";
+
     // Codec used to output the video
     // This is higher size: int outputVideoCodec = CV_FOURCC('W','R','L','E');
     // This works navite on Mac: int outputVideoCodec = CV_FOURCC('m', 'p', '4', 'v');
@@ -36,12 +174,47 @@ VideoWriter OutputVideo::get_video_writer() {
     int output_video_codec = CV_FOURCC('D', 'I', 'V', 'X');
 
     // Open output video file
-    VideoWriter output_video(name + ".avi", output_video_codec, fps, size, true);
+    video_writer.open(file_name.str(), output_video_codec, segment_fps, size, true);
 
     // Check if output video file was successfully opened
-    if (!output_video.isOpened()) {
-        cout << "Cannot open the output video file " << name + ".avi" << " for write." << endl;
+    if (!video_writer.isOpened()) {
+        cout << "Cannot open the output video file " << file_name.str() << " for write." << endl;
     }
-    
-    return output_video;
+}
+
+/**
+ * Get number of frames written to the output video.
+ *
+ * @return
+ */
+long OutputVideo::get_recorded_frames() {
+    return recorded_frames;
+}
+
+/**
+ * Get number of queued frames that were overwritten before being encoded.
+ *
+ * @return
+ */
+long OutputVideo::get_dropped_frames() {
+    return frame_queue->get_dropped();
+}
+
+/**
+ * Get number of frames not recorded because of the reduced frame rate.
+ *
+ * @return
+ */
+long OutputVideo::get_skipped_frames() {
+    return skipped_frames;
+}
+
+/**
+ * Print recording statistics to the console.
+ *
+ */
+void OutputVideo::print_statistics() {
+    long frames = recorded_frames;
+    double time_per_frame = frames > 0 ? encoding_time / 1000.0 / frames : 0;
+    cout << "Record: " << frames << " frames, " << time_per_frame << " ms/frame, queue " << frame_queue->size() << "/" << frame_queue->get_capacity() << " (peak " << frame_queue->get_peak_size() << "), dropped " << get_dropped_frames() << ", skipped " << get_skipped_frames() << ", frame rate 1/" << decimation << ", segment " << segment_index << endl;
 }
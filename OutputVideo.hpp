@@ -1,4 +1,4 @@
-/* 
+/*
  * File:   OutputVideo.hpp
  * Author: Jan Dufek
  */
@@ -6,23 +6,81 @@
 #ifndef OUTPUTVIDEO_HPP
 #define OUTPUTVIDEO_HPP
 
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+#include "BoundedQueue.hpp"
 
 using namespace cv;
 using namespace std;
 
+/**
+ * Background video recorder. Frames are queued by the render stage and encoded
+ * by the recorder thread, so the encoder never delays tracking or control.
+ * The video is split into segments of limited length.
+ */
 class OutputVideo {
 public:
-    OutputVideo(double, Size, string);
+    OutputVideo(Settings&, double, Size, string);
     OutputVideo(const OutputVideo& orig);
     virtual ~OutputVideo();
-    
-    VideoWriter get_video_writer();
-    
+
+    void start();
+
+    void stop();
+
+    bool record(const Mat&);
+
+    long get_recorded_frames();
+
+    long get_dropped_frames();
+
+    long get_skipped_frames();
+
+    void print_statistics();
+
 private:
+
+    void run();
+
+    void open_segment(int);
+
+    // Program settings
+    Settings * settings;
+
     double fps;
     Size size;
     string name;
+
+    // Frames waiting for encoding
+    BoundedQueue<Mat> * frame_queue;
+
+    thread recorder_thread;
+
+    VideoWriter video_writer;
+
+    // Current segment
+    int segment_index;
+    long segment_frames;
+    double segment_fps;
+    int segment_decimation;
+
+    // Only every n-th frame is recorded when the frame rate is reduced
+    atomic<int> decimation;
+
+    // Frames offered for recording
+    long offered_frames;
+
+    // Last time the encoder had a backlog
+    chrono::steady_clock::time_point backlog_time;
+
+    // Statistics
+    atomic<long> recorded_frames;
+    atomic<long> skipped_frames;
+    atomic<long> encoding_time;
+
 };
 
 #endif /* OUTPUTVIDEO_HPP */
@@ -0,0 +1,183 @@
+/*
+ * File:   PacedSource.cpp
+ * Author: Jan Dufek
+ */
+
+#include "PacedSource.hpp"
+#include <iostream>
+#include <thread>
+
+/**
+ * Pace frames of the source. Takes ownership of the source.
+ *
+ * @param f video file
+ * @param s stream conditions
+ */
+PacedSource::PacedSource(FrameSource& f, Settings& s) : random_generator(s.paced_seed) {
+
+    frame_source = &f;
+    settings = &s;
+
+    fps = frame_source->get_fps();
+    if (fps <= 0) {
+        fps = settings->REPLAY_DEFAULT_FPS;
+    }
+
+    frame_number = -1;
+    release_time = 0;
+    hold_time = 0;
+
+    released_frames = 0;
+    dropped_frames = 0;
+
+    schedule_next();
+}
+
+PacedSource::PacedSource(const PacedSource& orig) {
+}
+
+PacedSource::~PacedSource() {
+    delete frame_source;
+}
+
+/**
+ * Compute release time of the next frame. It is the time of the frame in the
+ * video delayed by jitter, or the end of a burst or a stall if one is in
+ * progress. Frames never overtake each other.
+ *
+ */
+void PacedSource::schedule_next() {
+
+    frame_number++;
+
+    double frame_time = frame_number / fps;
+
+    // A burst holds the following frames and releases them at once
+    if (frame_time >= hold_time && random_generator.uniform(0.0, 1.0) < settings->paced_burst_probability) {
+        hold_time = frame_time + (settings->paced_burst_frames - 1) / fps;
+    }
+
+    // No frames arrive during a stall, the delayed ones come all at its end
+    if (frame_time >= hold_time && random_generator.uniform(0.0, 1.0) < settings->paced_stall_probability) {
+        hold_time = frame_time + settings->paced_stall_time;
+    }
+
+    double jitter = random_generator.uniform(0.0, settings->paced_jitter / 1000);
+
+    release_time = max(release_time, max(frame_time + jitter, hold_time));
+}
+
+/**
+ * Wait for the next frame. If more frames arrived since the last read, only
+ * the latest is returned and the others are dropped.
+ *
+ * @param frame
+ * @return false if the video ended
+ */
+bool PacedSource::read(Mat& frame) {
+
+    if (frame_number == 0) {
+        start_time = chrono::steady_clock::now();
+    }
+
+    this_thread::sleep_until(start_time + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(release_time)));
+
+    double now = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+    // Frames are decoded even when dropped, the video has no other way to skip
+    while (true) {
+
+        if (!frame_source->read(frame)) {
+            return false;
+        }
+
+        schedule_next();
+
+        if (release_time > now) {
+            break;
+        }
+
+        dropped_frames++;
+    }
+
+    released_frames++;
+
+    return true;
+}
+
+double PacedSource::get_fps() {
+    return fps;
+}
+
+Size PacedSource::get_size() {
+    return frame_source->get_size();
+}
+
+/**
+ * Frames are dropped when they are not read in time, like those of a live
+ * stream.
+ *
+ * @return
+ */
+bool PacedSource::is_live() {
+    return true;
+}
+
+/**
+ * Print number of released and dropped frames.
+ *
+ */
+void PacedSource::print_statistics() {
+
+    long released = released_frames;
+    long dropped = dropped_frames;
+
+    cout << "Paced source: " << released << " frames released, " << dropped << " dropped before read";
+    if (released + dropped > 0) {
+        cout << " (" << 100.0 * dropped / (released + dropped) << " %)";
+    }
+    cout << endl;
+}
+
+/**
+ * Set stream conditions of a named link profile.
+ *
+ * @param profile clean, rtmp or mirror
+ * @param settings
+ * @return false if there is no such profile
+ */
+bool PacedSource::set_profile(string profile, Settings& settings) {
+
+    if (profile == "clean") {
+
+        // Frames arrive exactly at the frame rate
+        settings.paced_jitter = 0;
+        settings.paced_burst_probability = 0;
+        settings.paced_stall_probability = 0;
+
+    } else if (profile == "rtmp") {
+
+        // Encoder on the ground station, e.g. Teradek, over a good link
+        settings.paced_jitter = 15;
+        settings.paced_burst_probability = 0.02;
+        settings.paced_burst_frames = 4;
+        settings.paced_stall_probability = 0.001;
+        settings.paced_stall_time = 1;
+
+    } else if (profile == "mirror") {
+
+        // Screen mirror of the drone controller over Wi-Fi
+        settings.paced_jitter = 40;
+        settings.paced_burst_probability = 0.05;
+        settings.paced_burst_frames = 3;
+        settings.paced_stall_probability = 0.005;
+        settings.paced_stall_time = 0.5;
+
+    } else {
+
+        return false;
+
+    }
+
+    return true;
+}
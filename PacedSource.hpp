@@ -0,0 +1,72 @@
+/*
+ * File:   PacedSource.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef PACEDSOURCE_HPP
+#define PACEDSOURCE_HPP
+
+#include <atomic>
+#include <chrono>
+#include "FrameSource.hpp"
+#include "Settings.hpp"
+
+/**
+ * Video file played like a live stream. Frames are released at the frame rate
+ * of the video with random jitter, bursts and stalls as on a real link, e.g.
+ * an RTMP stream or a screen mirror of the drone controller. Frames that were
+ * not read before the next one arrived are dropped, as by a live camera.
+ *
+ * The release times depend only on the seed, so the same stream conditions
+ * can be replayed against different versions of the tracker.
+ */
+class PacedSource : public FrameSource {
+public:
+    PacedSource(FrameSource&, Settings&);
+    PacedSource(const PacedSource& orig);
+    virtual ~PacedSource();
+
+    bool read(Mat&);
+
+    double get_fps();
+
+    Size get_size();
+
+    bool is_live();
+
+    void print_statistics();
+
+    static bool set_profile(string, Settings&);
+
+private:
+
+    // Paced source, owned by this object
+    FrameSource * frame_source;
+
+    Settings * settings;
+
+    RNG random_generator;
+
+    // Frame rate the frames are released at
+    double fps;
+
+    // Time the first frame was released
+    chrono::steady_clock::time_point start_time;
+
+    // Number of the next frame of the source and its release time in seconds
+    // after the start
+    long frame_number;
+    double release_time;
+
+    // Frames are held until this time during a burst or a stall
+    double hold_time;
+
+    atomic<long> released_frames;
+    atomic<long> dropped_frames;
+
+    void schedule_next();
+
+};
+
+#endif /* PACEDSOURCE_HPP */
+
@@ -0,0 +1,239 @@
+/*
+ * File:   PerfCounters.cpp
+ * Author: Jan Dufek
+ */
+
+#include "PerfCounters.hpp"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+// Size of a cache line transferred on each last level cache miss
+#define CACHE_LINE_SIZE 64
+
+/**
+ * Counters of one stage. They are opened by the thread running the stage.
+ *
+ * @param n name of the stage
+ */
+PerfCounters::PerfCounters(string n) {
+
+    name = n;
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        descriptors[i] = -1;
+        identifiers[i] = 0;
+        start_values[i] = 0;
+        totals[i] = 0;
+    }
+
+    leader = -1;
+    started = false;
+    frames = 0;
+    pixels = 0;
+}
+
+PerfCounters::PerfCounters(const PerfCounters& orig) {
+}
+
+PerfCounters::~PerfCounters() {
+    close();
+}
+
+/**
+ * Open the counters for the calling thread. Has to be called by the thread
+ * running the stage.
+ *
+ * @return false if no counter is available
+ */
+bool PerfCounters::open() {
+
+#ifdef __linux__
+
+    uint32_t types[PERF_COUNTER_COUNT] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+    uint64_t configs[PERF_COUNTER_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_TASK_CLOCK};
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+
+        struct perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = types[i];
+        attributes.config = configs[i];
+
+        // User space only, which does not need special privileges
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+
+        // Counters are read together through the first one that was opened
+        attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int descriptor = syscall(__NR_perf_event_open, &attributes, 0, -1, leader, 0);
+        if (descriptor < 0) {
+            continue;
+        }
+
+        if (ioctl(descriptor, PERF_EVENT_IOC_ID, &identifiers[i]) != 0) {
+            ::close(descriptor);
+            continue;
+        }
+
+        descriptors[i] = descriptor;
+        if (leader < 0) {
+            leader = descriptor;
+        }
+    }
+
+#endif
+
+    if (leader < 0) {
+        cout << name << ": performance counters are not available." << endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Close the counters.
+ *
+ */
+void PerfCounters::close() {
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (descriptors[i] >= 0) {
+            ::close(descriptors[i]);
+        }
+        descriptors[i] = -1;
+    }
+
+    leader = -1;
+}
+
+/**
+ * Read all the counters. Values are scaled up if the kernel had to share the
+ * hardware counters with other events and counted only part of the time.
+ *
+ * @param values
+ * @return false if the counters cannot be read
+ */
+bool PerfCounters::read_counters(int64_t * values) {
+
+    // Number of counters, time enabled, time running and value and identifier
+    // of each counter
+    uint64_t buffer[3 + 2 * PERF_COUNTER_COUNT];
+
+    if (leader < 0 || read(leader, buffer, sizeof(buffer)) <= 0) {
+        return false;
+    }
+
+    uint64_t count = buffer[0];
+    double scale = buffer[2] > 0 ? (double) buffer[1] / buffer[2] : 1;
+
+    for (uint64_t j = 0; j < count && j < PERF_COUNTER_COUNT; j++) {
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+            if (descriptors[i] >= 0 && identifiers[i] == buffer[3 + 2 * j + 1]) {
+                values[i] = (int64_t) (buffer[3 + 2 * j] * scale);
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Start counting one frame of the stage.
+ *
+ */
+void PerfCounters::start() {
+    started = read_counters(start_values);
+}
+
+/**
+ * Stop counting the frame and add the counts to the totals.
+ *
+ * @param frame_pixels number of pixels processed in the frame
+ */
+void PerfCounters::stop(long frame_pixels) {
+
+    if (!started) {
+        return;
+    }
+
+    int64_t end_values[PERF_COUNTER_COUNT];
+    memcpy(end_values, start_values, sizeof(end_values));
+
+    if (!read_counters(end_values)) {
+        return;
+    }
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        totals[i] += end_values[i] - start_values[i];
+    }
+
+    frames++;
+    pixels += frame_pixels;
+    started = false;
+}
+
+/**
+ * Print counts per frame, instructions per cycle and bytes transferred from
+ * memory per pixel.
+ *
+ */
+void PerfCounters::print_statistics() {
+
+    long n = frames;
+
+    cout << name << " counters: " << n << " frames";
+
+    if (n == 0) {
+        cout << endl;
+        return;
+    }
+
+    ostringstream text;
+    text << fixed << setprecision(2);
+
+    if (descriptors[PERF_TASK_CLOCK] >= 0) {
+        text << ", CPU " << totals[PERF_TASK_CLOCK] / 1e6 / n << " ms/frame";
+    }
+
+    if (descriptors[PERF_CYCLES] >= 0) {
+        text << ", " << totals[PERF_CYCLES] / 1e6 / n << " Mcycles/frame";
+    }
+
+    if (descriptors[PERF_CYCLES] >= 0 && descriptors[PERF_INSTRUCTIONS] >= 0 && totals[PERF_CYCLES] > 0) {
+        text << ", IPC " << (double) totals[PERF_INSTRUCTIONS] / totals[PERF_CYCLES];
+    } else {
+        text << ", IPC n/a";
+    }
+
+    if (descriptors[PERF_LLC_MISSES] >= 0) {
+        text << ", LLC misses " << totals[PERF_LLC_MISSES] / 1e3 / n << "k/frame";
+        if (pixels > 0) {
+            text << ", " << (double) totals[PERF_LLC_MISSES] * CACHE_LINE_SIZE / pixels << " bytes/pixel";
+        }
+    } else {
+        text << ", LLC misses n/a";
+    }
+
+    if (descriptors[PERF_BRANCH_MISSES] >= 0) {
+        text << ", branch misses " << totals[PERF_BRANCH_MISSES] / 1e3 / n << "k/frame";
+        if (descriptors[PERF_INSTRUCTIONS] >= 0 && totals[PERF_INSTRUCTIONS] > 0) {
+            text << " (" << 1000.0 * totals[PERF_BRANCH_MISSES] / totals[PERF_INSTRUCTIONS] << " per 1000 instructions)";
+        }
+    } else {
+        text << ", branch misses n/a";
+    }
+
+    cout << text.str() << endl;
+}
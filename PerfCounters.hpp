@@ -0,0 +1,80 @@
+/*
+ * File:   PerfCounters.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef PERFCOUNTERS_HPP
+#define PERFCOUNTERS_HPP
+
+#include <string>
+#include <atomic>
+#include <stdint.h>
+
+using namespace std;
+
+// Counted events
+enum PerfCounter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_TASK_CLOCK,
+    PERF_COUNTER_COUNT
+};
+
+/**
+ * Hardware performance counters of one pipeline stage read through Linux
+ * perf_event_open. Counts cycles, instructions, last level cache misses,
+ * branch misses and CPU time of the thread running the stage between start
+ * and stop. Reports instructions per cycle and memory traffic per pixel, which
+ * tell whether the stage is bound by computation or by memory.
+ *
+ * Counters the kernel or the CPU does not provide (e.g. in virtual machines)
+ * are reported as not available. Without perf_event_open nothing is counted.
+ */
+class PerfCounters {
+public:
+
+    PerfCounters(string);
+    PerfCounters(const PerfCounters& orig);
+    virtual ~PerfCounters();
+
+    bool open();
+
+    void close();
+
+    void start();
+
+    void stop(long);
+
+    void print_statistics();
+
+private:
+
+    bool read_counters(int64_t *);
+
+    // Name of the stage
+    string name;
+
+    // File descriptors of the counters, -1 if not available
+    int descriptors[PERF_COUNTER_COUNT];
+
+    // Kernel identifiers of the counters in the group
+    uint64_t identifiers[PERF_COUNTER_COUNT];
+
+    // Group leader read to get all the counters at once
+    int leader;
+
+    // Values when the stage started
+    int64_t start_values[PERF_COUNTER_COUNT];
+    bool started;
+
+    // Totals over all measured frames
+    atomic<long> totals[PERF_COUNTER_COUNT];
+    atomic<long> frames;
+    atomic<long> pixels;
+
+};
+
+#endif /* PERFCOUNTERS_HPP */
+
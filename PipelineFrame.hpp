@@ -0,0 +1,119 @@
+/*
+ * File:   PipelineFrame.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef PIPELINEFRAME_HPP
+#define PIPELINEFRAME_HPP
+
+#include <vector>
+#include <chrono>
+#include "opencv2/opencv.hpp"
+#include "Command.hpp"
+
+using namespace std;
+using namespace cv;
+
+// One frame passed between the pipeline stages together with everything the
+// stages found out about it. Each stage only fills its own part.
+struct PipelineFrame {
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Capture
+    ////////////////////////////////////////////////////////////////////////////
+
+    Mat original_frame;
+
+    long frame_number = -1;
+
+    chrono::steady_clock::time_point capture_time;
+
+    // Processing was paused when the frame was taken
+    bool paused = false;
+
+    // The frame should be logged
+    bool loggable = false;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Preprocessing
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Region of the original frame that was preprocessed. Blured frame, HSV
+    // frame and back projection cover only this region.
+    Rect search_region;
+
+    Mat blured_frame;
+
+    // HSV of the search region, or of the coarsest pyramid level when tracking
+    // coarse to fine
+    Mat HSV_frame;
+
+    // Image pyramid when tracking coarse to fine. Level 0 is the original frame.
+    vector<Mat> pyramid;
+
+    // Value equalization table the coarsest level was equalized with. The
+    // refinement region is equalized with it on the tracking thread.
+    Mat equalization_table;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Tracking
+    ////////////////////////////////////////////////////////////////////////////
+
+    // EMILY was found in this frame
+    bool object_found = false;
+
+    // EMILY location and pose
+    RotatedRect tracking_box;
+    double object_size = 0;
+    Point emily_location;
+    Point emily_pose_point_1;
+    Point emily_pose_point_2;
+
+    // Back projection of histogram
+    Mat back_projection;
+
+    // New visualization of histogram if the object was selected in this frame
+    Mat histogram_image;
+
+    // Thresholds used when CamShift is disabled
+    Mat threshold;
+    Mat eroded_dilated_threshold;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Control
+    ////////////////////////////////////////////////////////////////////////////
+
+    // EMILY heading
+    bool heading_estimated = false;
+    vector<Point> path_polynomial_approximation;
+    Point heading_point;
+    double emily_angle = 0;
+
+    Point target_location;
+
+    // EMILY location and target on the ground plane. The same as in the image
+    // unless the perspective is corrected. Heading and control use these.
+    Point ground_emily_location;
+    Point ground_target_location;
+
+    Command commands;
+
+    int status = 0;
+
+    double time_to_target = 0;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Latency
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Monotonic time when each stage finished the frame. Together with the
+    // capture time they give latency of the stages.
+    chrono::steady_clock::time_point preprocess_time;
+    chrono::steady_clock::time_point track_time;
+    chrono::steady_clock::time_point control_time;
+    chrono::steady_clock::time_point send_time;
+
+};
+
+#endif /* PIPELINEFRAME_HPP */
+
@@ -0,0 +1,135 @@
+/*
+ * File:   RingBuffer.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef RINGBUFFER_HPP
+#define RINGBUFFER_HPP
+
+#include <vector>
+#include <atomic>
+#include <stddef.h>
+
+using namespace std;
+
+/**
+ * Lock-free ring buffer connecting one producer thread with one consumer
+ * thread. Push never waits: when the buffer is full the item is rejected and
+ * counted as dropped. Items are copied, so T should be small and trivially
+ * copyable.
+ */
+template <class T>
+class RingBuffer {
+public:
+
+    RingBuffer(int c) {
+
+        // Capacity is rounded up to a power of two so that indices are masked
+        capacity = 1;
+        while (capacity < (size_t) c) {
+            capacity *= 2;
+        }
+        mask = capacity - 1;
+        buffer.resize(capacity);
+
+        head = 0;
+        tail = 0;
+        dropped = 0;
+    }
+
+    virtual ~RingBuffer() {
+    }
+
+    /**
+     * Push item into the buffer. Called only by the producer.
+     *
+     * @param item
+     * @return false if the buffer was full and the item was dropped
+     */
+    bool push(const T& item) {
+
+        size_t write = head.load(memory_order_relaxed);
+
+        if (write - tail.load(memory_order_acquire) == capacity) {
+            dropped.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+
+        buffer[write & mask] = item;
+        head.store(write + 1, memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * Take up to given number of the oldest items from the buffer. Called only
+     * by the consumer.
+     *
+     * @param items array for the items
+     * @param max_items
+     * @return number of items taken
+     */
+    int pop(T * items, int max_items) {
+
+        size_t read = tail.load(memory_order_relaxed);
+        size_t available = head.load(memory_order_acquire) - read;
+
+        int n = available < (size_t) max_items ? (int) available : max_items;
+
+        for (int i = 0; i < n; i++) {
+            items[i] = buffer[(read + i) & mask];
+        }
+        tail.store(read + n, memory_order_release);
+
+        return n;
+    }
+
+    /**
+     * Get number of items in the buffer.
+     *
+     * @return
+     */
+    size_t size() const {
+        return head.load(memory_order_acquire) - tail.load(memory_order_acquire);
+    }
+
+    size_t get_capacity() const {
+        return capacity;
+    }
+
+    /**
+     * Get number of items rejected because the buffer was full.
+     *
+     * @return
+     */
+    long get_dropped() const {
+        return dropped.load(memory_order_relaxed);
+    }
+
+private:
+
+    vector<T> buffer;
+
+    size_t capacity;
+    size_t mask;
+
+    // Indices are separated by padding so that the producer and consumer do
+    // not write to the same cache line
+    char padding_1[64];
+
+    // Index of the next item to write. Written only by the producer.
+    atomic<size_t> head;
+
+    char padding_2[64];
+
+    // Index of the next item to read. Written only by the consumer.
+    atomic<size_t> tail;
+
+    char padding_3[64];
+
+    atomic<long> dropped;
+
+};
+
+#endif /* RINGBUFFER_HPP */
+
@@ -2,10 +2,27 @@
 #define SETTINGS_HPP
 
 #include "opencv2/opencv.hpp"
+#include "BoundedQueue.hpp"
 
 using namespace std;
 using namespace cv;
 
+// Blur engines
+enum BlurEngine {
+    BLUR_GAUSSIAN,
+    BLUR_BOX
+};
+
+// What the video recorder does when the encoder cannot keep up
+enum RecordPolicy {
+    // Wait for the encoder, which delays rendering
+    RECORD_BLOCK,
+    // Drop the oldest frame waiting for encoding
+    RECORD_DROP,
+    // Record only every n-th frame until the encoder keeps up
+    RECORD_REDUCE_FPS
+};
+
 class Settings {
 public:
     
@@ -117,6 +134,334 @@ public:
 //    int saturation_min = 130;
 //    int value_min = 10;
     
+    ////////////////////////////////////////////////////////////////////////////////
+    // Capture
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Number of frames buffered between the capture thread and the processing.
+    // Small buffer keeps the latency low on live streams.
+    const int FRAME_BUFFER_SIZE = 2;
+
+    // What to do with live stream frames when the processing cannot keep up
+    // (QUEUE_DROP_OLDEST or QUEUE_KEEP_LATEST). Frames from video files are
+    // never dropped.
+    int frame_buffer_policy = QUEUE_KEEP_LATEST;
+
+    // Frames older than this number of milliseconds when taken for processing
+    // are counted as stale
+    int stale_frame_age = 200;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Frame cache
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Decode video files once into a raw frame cache and read the frames from
+    // its memory mapping in the following runs. Can be also enabled by the
+    // --cache argument. Live streams are never cached.
+    bool frame_cache = false;
+
+    // Directory of the frame cache files. Outdated caches of a video are
+    // removed when a new one is created.
+    string frame_cache_directory = "cache";
+
+    // Downscale cached frames to the processing resolution
+    bool frame_cache_downscale = true;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Paced source
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Play the video file like a live stream at its frame rate, dropping the
+    // frames the tracker is not ready for. Can be also enabled by the --paced
+    // argument with a profile of the link (clean, rtmp or mirror).
+    bool paced_source = false;
+
+    // Largest random delay of a frame in milliseconds
+    double paced_jitter = 0;
+
+    // Probability that a frame starts a burst, whose frames arrive at once
+    double paced_burst_probability = 0;
+
+    // Number of frames in a burst
+    int paced_burst_frames = 4;
+
+    // Probability that a frame starts a stall, during which no frames arrive
+    double paced_stall_probability = 0;
+
+    // Length of a stall in seconds
+    double paced_stall_time = 1;
+
+    // Seed of the random generator. The same seed gives the same release times.
+    int paced_seed = 1;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Synthetic scene
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Rendered instead of the video by --input synthetic[:trajectory], where
+    // trajectory is circle, figure8, line or waypoints:x,y,x,y,... in meters
+    // on the water around the point the camera looks at.
+
+    // Size of the rendered frames
+    Size synthetic_frame_size = Size(1280, 720);
+
+    // Frame rate of the scene
+    double synthetic_fps = 30;
+
+    // Number of frames after which the source ends
+    int synthetic_frames = 3000;
+
+    // Camera altitude above the water in meters
+    double synthetic_altitude = 40;
+
+    // Horizontal field of view of the camera in degrees
+    double synthetic_field_of_view = 70;
+
+    // Tilt of the camera from looking straight down in degrees
+    double synthetic_camera_angle = 30;
+
+    // Hull size in meters
+    double synthetic_hull_length = 1.2;
+    double synthetic_hull_beam = 0.4;
+
+    // Speed of the hull in meters per second
+    double synthetic_speed = 2;
+
+    // Radius of the circle, figure eight and line trajectories in meters
+    double synthetic_trajectory_radius = 12;
+
+    // Standard deviation of the sensor noise added to each channel
+    double synthetic_noise = 6;
+
+    // Number of sun glints on the water in each frame
+    int synthetic_glints = 60;
+
+    // Number of backgrounds with different noise rendered in advance. Frames
+    // cycle through them, so rendering a frame is a copy and a few small
+    // shapes.
+    const int SYNTHETIC_BACKGROUNDS = 4;
+
+    // Seed of the random generator. The same seed renders the same scene.
+    int synthetic_seed = 1;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Pipeline
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Number of frames buffered between the processing stages
+    const int PIPELINE_QUEUE_SIZE = 2;
+
+    // How often to print pipeline statistics in seconds
+    const int PIPELINE_STATISTICS_INTERVAL = 10;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Recording
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Number of frames buffered for the video encoder
+    const int RECORD_QUEUE_SIZE = 8;
+
+    // RECORD_BLOCK, RECORD_DROP or RECORD_REDUCE_FPS
+    int record_policy = RECORD_REDUCE_FPS;
+
+    // Length of one output video segment in seconds. 0 records a single file.
+    int record_segment_length = 300;
+
+    // Maximal reduction of the recorded frame rate
+    const int RECORD_MAX_DECIMATION = 8;
+
+    // Number of seconds the encoder must keep up before the recorded frame
+    // rate is doubled again
+    const int RECORD_RECOVERY_TIME = 10;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Log
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Number of log records buffered for the writer thread. Records logged
+    // while the buffer is full are dropped.
+    const int LOG_BUFFER_SIZE = 4096;
+
+    // How often the writer thread writes buffered records in milliseconds
+    const int LOG_WRITE_INTERVAL = 100;
+
+    // Export the binary log to the text logs (.txt, _rudder.txt and
+    // _throttle.txt) when the program finishes
+    bool log_text_export = true;
+
+    // Convert the binary log to the columnar mission log (.mission) read by
+    // emily_mission when the program finishes
+    bool log_mission_export = true;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Trace
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Record timeline of the stages to name_trace.json, which can be opened in
+    // chrome://tracing or Perfetto. Can be also enabled by the --trace argument.
+    bool trace = false;
+
+    // Number of trace events buffered for each thread. Events recorded while
+    // the buffer is full are dropped.
+    const int TRACE_BUFFER_SIZE = 16384;
+
+    // How often the buffered trace events are written in milliseconds
+    const int TRACE_WRITE_INTERVAL = 200;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Performance counters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Count cycles, instructions, cache and branch misses of each stage with
+    // perf_event_open and print them with the pipeline statistics. Can be also
+    // enabled by the --perf argument.
+    bool perf_counters = false;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Headless
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Run without any windows. Object of interest and target are given on the
+    // command line or through the console input. Can be also enabled by the
+    // --headless argument. Builds without GUI (HEADLESS) are always headless.
+#ifdef HEADLESS
+    bool headless = true;
+#else
+    bool headless = false;
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Replay
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Process a video file as fast as possible without any windows. Time of a
+    // frame is given by its number and the frame rate of the video instead of
+    // the clock, so time to target and the log are the same in every run on
+    // any machine. Preprocessing waits for the tracking of each frame, so that
+    // the search region and equalization of the next frame do not depend on
+    // timing. Latencies are not logged. Operator commands are taken only from
+    // the command line, the console and the viewer are not read. Determinism
+    // is checked by evaluate/check_replay.sh. Can be also enabled by the
+    // --replay argument.
+    bool replay = false;
+
+    // Frame rate used in replay mode when the video file does not give one
+    const double REPLAY_DEFAULT_FPS = 30;
+
+    // Base name of the output video and logs, e.g. output/replay. Empty names
+    // them by the current date and time. Can be also set by the --output
+    // argument.
+    string output_name = "";
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Viewer
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Publish annotated frames to shared memory for the viewer (emily_viewer)
+    // running as a separate process. Can be also enabled by the --viewer
+    // argument. The tracker itself then runs headless.
+    bool publish_frames = false;
+
+    // Name of the shared memory with frames
+    const string SHARED_FRAMES_NAME = "/emily_tracker_frames";
+
+    // Number of frames in the shared memory ring
+    const int SHARED_FRAMES_SLOTS = 3;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Search region
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Preprocess and track only in a region around the last tracking box. Full
+    // frames are processed only when the object has to be acquired again, and
+    // the equalization samples the whole frame only once per interval. Can be
+    // also enabled by the --search-region argument.
+    bool search_region_enabled = false;
+
+    // Padding of the search region around the tracking box as a multiple of
+    // the tracking box size
+    const double SEARCH_REGION_PADDING = 1.0;
+
+    // Minimal padding of the search region in pixels
+    const int SEARCH_REGION_MIN_PADDING = 40;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Pyramid
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Number of pyramid levels below the processing resolution. Each level
+    // halves the resolution. CamShift runs on the whole coarsest level and the
+    // result is refined at the processing resolution in a small region around
+    // it. 0 disables the pyramid. Can be also set by the --pyramid argument.
+    int pyramid_levels = 0;
+
+    // Padding of the refinement region around the coarse tracking box in
+    // pixels at the processing resolution
+    const int PYRAMID_REFINE_PADDING = 16;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Back projection
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Compute back projection of the tracked object in a single pass over the
+    // blured frame instead of converting it to HSV, equalizing, thresholding and
+    // back projecting. The result is the same. Not used with the pyramid.
+    bool fused_back_projection = true;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Blur
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Blur engine. BLUR_GAUSSIAN uses GaussianBlur, whose cost grows with the
+    // kernel size. BLUR_BOX approximates it by stacked box filters with the
+    // same cost for any kernel size. Can be switched by the "Box blur"
+    // trackbar or set by the --blur argument.
+    int blur_engine = BLUR_GAUSSIAN;
+
+    // Smaller kernels are always blured by GaussianBlur, which is fast and
+    // exact for them, while box filters approximate them poorly
+    const int BOX_BLUR_MIN_KERNEL_SIZE = 9;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Equalization
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Histogram of value is computed from every n-th pixel of every n-th row
+    int equalization_sample_step = 4;
+
+    // Equalization look up table is rebuilt at least every n frames. While
+    // only a search region is preprocessed, the whole frame is sampled at
+    // this interval.
+    int equalization_interval = 30;
+
+    // Equalization look up table is rebuilt sooner if this fraction of pixels
+    // moved to other bins of the histogram of value since it was built
+    const double EQUALIZATION_DRIFT_THRESHOLD = 0.05;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Perspective
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // With INVERSE_PERSPECTIVE_WARP, EMILY and the target are tracked in the
+    // image and only their positions are mapped to the ground plane for
+    // heading estimation and control.
+
+    // Map positions through the lens model before the homography. Off until
+    // the camera calibration is verified.
+    bool lens_undistortion = false;
+
+    // Show the frame warped to the ground plane in its own window. Only a
+    // visualization, toggled by the 'o' key.
+    bool perspective_overlay = false;
+
+    // Use homography computed from the camera angle trackbar instead of the
+    // one from manually measured camera parameters
+    bool angle_homography = false;
+
+    // Directory where the lens and overhead view maps are cached between
+    // runs. Cache files are named by hash of the calibration and resolution.
+    const string REMAP_CACHE_DIRECTORY = "cache";
+
     ////////////////////////////////////////////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////////////////
     // Algorithm Variable parameters
@@ -169,6 +514,18 @@ public:
     const char * IP_ADDRESS = "192.168.1.4";
     const short PORT = 5007;
 
+    // Commands per second sent by the command thread, independent of the frame
+    // rate. The latest pose is extrapolated to the time of sending. 0 sends one
+    // command per processed frame. Can be also set by the --command-rate
+    // argument, the control computer reads commands at about 30 Hz.
+    double command_rate = 0;
+
+    // EMILY is stopped when the latest pose is older than this many seconds
+    double command_timeout = 0.5;
+
+    // Weight of the newest measurement in the estimated velocity of EMILY
+    const double COMMAND_VELOCITY_SMOOTHING = 0.3;
+
     ////////////////////////////////////////////////////////////////////////////////
     // GUI Parameters
     ////////////////////////////////////////////////////////////////////////////////
@@ -192,6 +549,9 @@ public:
     // Histogram window name
     const string HISTOGRAM_WINDOW = "Histogram";
 
+    // Overhead view window name
+    const string OVERHEAD_WINDOW = "Overhead view";
+
     // Object position crosshairs color
     const Scalar LOCATION_COLOR = Scalar(0, 255, 0);
 
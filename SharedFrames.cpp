@@ -0,0 +1,410 @@
+/*
+ * File:   SharedFrames.cpp
+ * Author: Jan Dufek
+ */
+
+#include "SharedFrames.hpp"
+#include <new>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Identifies the layout of the shared memory
+#define SHARED_FRAMES_MAGIC 0x454D4C31
+
+// Largest histogram visualization that can be published
+#define HISTOGRAM_DATA_SIZE (200 * 320 * 3)
+
+// Number of operator commands that can wait in the mailbox
+#define COMMAND_COUNT 32
+
+// Maximum length of one operator command
+#define COMMAND_LENGTH 64
+
+// Alignment of slots in the shared memory
+#define SLOT_ALIGNMENT 64
+
+struct SharedFramesHeader {
+    uint32_t magic;
+    uint32_t slot_count;
+    uint64_t slot_data_size;
+
+    // Writer is still running
+    atomic<int> writer_active;
+
+    // Number of published frames. The latest frame is in slot (published - 1).
+    atomic<uint64_t> published;
+
+    // Histogram visualization guarded by its own sequence number
+    atomic<uint64_t> histogram_sequence;
+    int histogram_rows;
+    int histogram_cols;
+    int histogram_type;
+    unsigned char histogram_data[HISTOGRAM_DATA_SIZE];
+
+    // Operator commands from the viewer to the tracker
+    atomic<uint32_t> command_write;
+    atomic<uint32_t> command_read;
+    char commands[COMMAND_COUNT][COMMAND_LENGTH];
+};
+
+struct SharedFramesSlot {
+
+    // Odd while the slot is being written
+    atomic<uint64_t> sequence;
+
+    SharedFrameState state;
+
+    int rows;
+    int cols;
+    int type;
+    uint64_t step;
+};
+
+// Size of the slot header. Pixel data follow it.
+static const size_t SLOT_HEADER_SIZE = (sizeof (SharedFramesSlot) + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+
+// Size of the shared memory header. Slots follow it.
+static const size_t HEADER_SIZE = (sizeof (SharedFramesHeader) + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+
+/**
+ * Create the shared memory. Used by the tracker, which is the only writer.
+ *
+ * @param n shared memory name, e.g. /emily_tracker_frames
+ * @param max_frame_size largest frame that will be published
+ * @param slot_count number of frames in the ring
+ */
+SharedFrames::SharedFrames(string n, Size max_frame_size, int slot_count) {
+
+    name = n;
+    owner = true;
+    memory = NULL;
+    header = NULL;
+
+    // Remove memory left behind by a tracker that did not exit cleanly
+    shm_unlink(name.c_str());
+
+    int file_descriptor = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+    if (file_descriptor < 0) {
+        return;
+    }
+
+    size_t slot_data_size = (size_t) max_frame_size.width * max_frame_size.height * 3;
+    slot_data_size = (slot_data_size + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+    slot_stride = SLOT_HEADER_SIZE + slot_data_size;
+    memory_size = HEADER_SIZE + slot_stride * slot_count;
+
+    if (ftruncate(file_descriptor, memory_size) == 0) {
+        memory = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+    }
+
+    close(file_descriptor);
+
+    if (memory == MAP_FAILED || memory == NULL) {
+        memory = NULL;
+        shm_unlink(name.c_str());
+        return;
+    }
+
+    header = new (memory) SharedFramesHeader();
+    header->slot_count = slot_count;
+    header->slot_data_size = slot_data_size;
+
+    for (int i = 0; i < slot_count; i++) {
+        new (get_slot(i)) SharedFramesSlot();
+    }
+
+    header->writer_active = 1;
+
+    // Readers check the magic last
+    atomic_thread_fence(memory_order_release);
+    header->magic = SHARED_FRAMES_MAGIC;
+}
+
+/**
+ * Open shared memory created by the tracker. Used by the viewer.
+ *
+ * @param n shared memory name
+ */
+SharedFrames::SharedFrames(string n) {
+
+    name = n;
+    owner = false;
+    memory = NULL;
+    header = NULL;
+
+    int file_descriptor = shm_open(name.c_str(), O_RDWR, 0600);
+    if (file_descriptor < 0) {
+        return;
+    }
+
+    struct stat file_status;
+    if (fstat(file_descriptor, &file_status) == 0 && (size_t) file_status.st_size >= HEADER_SIZE) {
+        memory_size = file_status.st_size;
+        memory = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+    }
+
+    close(file_descriptor);
+
+    if (memory == MAP_FAILED || memory == NULL) {
+        memory = NULL;
+        return;
+    }
+
+    header = (SharedFramesHeader *) memory;
+
+    // Not initialized yet or incompatible layout
+    if (header->magic != SHARED_FRAMES_MAGIC) {
+        munmap(memory, memory_size);
+        memory = NULL;
+        header = NULL;
+        return;
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+
+    slot_stride = SLOT_HEADER_SIZE + header->slot_data_size;
+}
+
+SharedFrames::SharedFrames(const SharedFrames& orig) {
+}
+
+SharedFrames::~SharedFrames() {
+
+    if (memory == NULL) {
+        return;
+    }
+
+    if (owner) {
+
+        // Let the viewer know that no more frames will come
+        header->writer_active = 0;
+
+        shm_unlink(name.c_str());
+    }
+
+    munmap(memory, memory_size);
+}
+
+bool SharedFrames::is_open() {
+    return header != NULL;
+}
+
+bool SharedFrames::is_writer_active() {
+    return header != NULL && header->writer_active;
+}
+
+/**
+ * Get slot in which the frame with given index is stored.
+ *
+ * @param index
+ * @return
+ */
+SharedFramesSlot * SharedFrames::get_slot(uint64_t index) {
+    return (SharedFramesSlot *) ((unsigned char *) memory + HEADER_SIZE + slot_stride * (index % header->slot_count));
+}
+
+/**
+ * Publish a frame. The frame is copied into the next slot of the ring. Never
+ * waits for the reader.
+ *
+ * @param frame
+ * @param state tracking state belonging to the frame
+ */
+void SharedFrames::publish(Mat& frame, SharedFrameState& state) {
+
+    if (header == NULL || frame.empty() || (uint64_t) frame.total() * frame.elemSize() > header->slot_data_size) {
+        return;
+    }
+
+    uint64_t index = header->published.load(memory_order_relaxed);
+    SharedFramesSlot * slot = get_slot(index);
+
+    // Mark the slot as being written
+    uint64_t sequence = slot->sequence.load(memory_order_relaxed);
+    slot->sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    // Copy the frame directly into the slot
+    Mat slot_frame(frame.rows, frame.cols, frame.type(), (unsigned char *) slot + SLOT_HEADER_SIZE);
+    frame.copyTo(slot_frame);
+
+    slot->rows = slot_frame.rows;
+    slot->cols = slot_frame.cols;
+    slot->type = slot_frame.type();
+    slot->step = slot_frame.step;
+    slot->state = state;
+
+    // Slot is consistent again
+    slot->sequence.store(sequence + 2, memory_order_release);
+
+    header->published.store(index + 1, memory_order_release);
+}
+
+/**
+ * Publish visualization of histogram.
+ *
+ * @param histogram_image
+ */
+void SharedFrames::publish_histogram(Mat& histogram_image) {
+
+    if (header == NULL || histogram_image.empty() || histogram_image.total() * histogram_image.elemSize() > HISTOGRAM_DATA_SIZE) {
+        return;
+    }
+
+    uint64_t sequence = header->histogram_sequence.load(memory_order_relaxed);
+    header->histogram_sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    Mat shared_histogram(histogram_image.rows, histogram_image.cols, histogram_image.type(), header->histogram_data);
+    histogram_image.copyTo(shared_histogram);
+
+    header->histogram_rows = histogram_image.rows;
+    header->histogram_cols = histogram_image.cols;
+    header->histogram_type = histogram_image.type();
+
+    header->histogram_sequence.store(sequence + 2, memory_order_release);
+}
+
+/**
+ * Read the latest published frame.
+ *
+ * @param frame copy of the frame
+ * @param state tracking state belonging to the frame
+ * @param last_read number of the last frame read. Updated if a new frame was read.
+ * @return false if there is no new frame or it was overwritten while reading
+ */
+bool SharedFrames::read_latest(Mat& frame, SharedFrameState& state, uint64_t& last_read) {
+
+    if (header == NULL) {
+        return false;
+    }
+
+    uint64_t published = header->published.load(memory_order_acquire);
+    if (published == 0 || published == last_read) {
+        return false;
+    }
+
+    SharedFramesSlot * slot = get_slot(published - 1);
+
+    uint64_t sequence = slot->sequence.load(memory_order_acquire);
+    if (sequence & 1) {
+        return false;
+    }
+
+    int rows = slot->rows;
+    int cols = slot->cols;
+    int type = slot->type;
+    uint64_t step = slot->step;
+
+    // Dimensions can be inconsistent if the slot is being overwritten
+    if (rows <= 0 || cols <= 0 || step * rows > header->slot_data_size || (uint64_t) cols * CV_ELEM_SIZE(type) > step) {
+        return false;
+    }
+
+    Mat(rows, cols, type, (unsigned char *) slot + SLOT_HEADER_SIZE, step).copyTo(frame);
+    state = slot->state;
+
+    atomic_thread_fence(memory_order_acquire);
+    if (slot->sequence.load(memory_order_relaxed) != sequence) {
+        return false;
+    }
+
+    last_read = published;
+
+    return true;
+}
+
+/**
+ * Read the visualization of histogram.
+ *
+ * @param histogram_image copy of the histogram visualization
+ * @param last_sequence sequence of the last histogram read. Updated if a new histogram was read.
+ * @return false if there is no new histogram
+ */
+bool SharedFrames::read_histogram(Mat& histogram_image, uint64_t& last_sequence) {
+
+    if (header == NULL) {
+        return false;
+    }
+
+    uint64_t sequence = header->histogram_sequence.load(memory_order_acquire);
+    if (sequence == 0 || sequence == last_sequence || (sequence & 1)) {
+        return false;
+    }
+
+    int rows = header->histogram_rows;
+    int cols = header->histogram_cols;
+    int type = header->histogram_type;
+
+    if (rows <= 0 || cols <= 0 || (uint64_t) rows * cols * CV_ELEM_SIZE(type) > HISTOGRAM_DATA_SIZE) {
+        return false;
+    }
+
+    Mat(rows, cols, type, header->histogram_data).copyTo(histogram_image);
+
+    atomic_thread_fence(memory_order_acquire);
+    if (header->histogram_sequence.load(memory_order_relaxed) != sequence) {
+        return false;
+    }
+
+    last_sequence = sequence;
+
+    return true;
+}
+
+/**
+ * Send operator command to the tracker.
+ *
+ * @param command
+ * @return false if the mailbox is full
+ */
+bool SharedFrames::send_command(string command) {
+
+    if (header == NULL) {
+        return false;
+    }
+
+    uint32_t write_index = header->command_write.load(memory_order_relaxed);
+    uint32_t read_index = header->command_read.load(memory_order_acquire);
+
+    if (write_index - read_index >= COMMAND_COUNT) {
+        return false;
+    }
+
+    char * entry = header->commands[write_index % COMMAND_COUNT];
+    strncpy(entry, command.c_str(), COMMAND_LENGTH - 1);
+    entry[COMMAND_LENGTH - 1] = '\0';
+
+    header->command_write.store(write_index + 1, memory_order_release);
+
+    return true;
+}
+
+/**
+ * Receive operator command from the viewer.
+ *
+ * @param command
+ * @return false if there is no command waiting
+ */
+bool SharedFrames::receive_command(string& command) {
+
+    if (header == NULL) {
+        return false;
+    }
+
+    uint32_t read_index = header->command_read.load(memory_order_relaxed);
+    uint32_t write_index = header->command_write.load(memory_order_acquire);
+
+    if (read_index == write_index) {
+        return false;
+    }
+
+    command = header->commands[read_index % COMMAND_COUNT];
+
+    header->command_read.store(read_index + 1, memory_order_release);
+
+    return true;
+}
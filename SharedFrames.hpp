@@ -0,0 +1,90 @@
+/*
+ * File:   SharedFrames.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef SHAREDFRAMES_HPP
+#define SHAREDFRAMES_HPP
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+#include "opencv2/opencv.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Tracking state published together with each frame
+struct SharedFrameState {
+    long frame_number;
+    int object_found;
+    Point emily_location;
+    Point target_location;
+    double emily_angle;
+    double throttle;
+    double rudder;
+    int status;
+    double time_to_target;
+};
+
+// Layout of the shared memory
+struct SharedFramesHeader;
+struct SharedFramesSlot;
+
+/**
+ * Ring of annotated frames in POSIX shared memory. The tracker writes frames
+ * into it and the viewer running in another process reads them. The writer
+ * never waits for the reader. Each slot is guarded by a sequence number that
+ * is odd while the slot is being written, so the reader detects a frame that
+ * was overwritten while it was being read and skips it.
+ *
+ * In the opposite direction, the viewer sends operator commands (the same as
+ * the console commands) through a small mailbox.
+ */
+class SharedFrames {
+public:
+
+    SharedFrames(string, Size, int);
+    SharedFrames(string);
+    SharedFrames(const SharedFrames& orig);
+    virtual ~SharedFrames();
+
+    bool is_open();
+
+    bool is_writer_active();
+
+    void publish(Mat&, SharedFrameState&);
+
+    void publish_histogram(Mat&);
+
+    bool read_latest(Mat&, SharedFrameState&, uint64_t&);
+
+    bool read_histogram(Mat&, uint64_t&);
+
+    bool send_command(string);
+
+    bool receive_command(string&);
+
+private:
+
+    SharedFramesSlot * get_slot(uint64_t);
+
+    // Shared memory name
+    string name;
+
+    // This process created the shared memory
+    bool owner;
+
+    // Mapped shared memory
+    void * memory;
+    size_t memory_size;
+
+    SharedFramesHeader * header;
+
+    // Size of one slot including its pixel data
+    size_t slot_stride;
+
+};
+
+#endif /* SHAREDFRAMES_HPP */
+
@@ -0,0 +1,462 @@
+/*
+ * File:   SyntheticSource.cpp
+ * Author: Jan Dufek
+ */
+
+#include "SyntheticSource.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+// Colors in BGR
+#define WATER_COLOR Scalar(110, 85, 40)
+#define SKY_COLOR Scalar(205, 195, 185)
+#define HULL_COLOR Scalar(40, 40, 200)
+#define GLINT_COLOR Scalar(240, 245, 250)
+
+// Fractional bits of the hull polygon vertices
+#define HULL_SHIFT 4
+
+SyntheticSource::SyntheticSource(Settings& s) {
+    settings = &s;
+    trajectory = TRAJECTORY_CIRCLE;
+    frame_number = 0;
+}
+
+SyntheticSource::SyntheticSource(const SyntheticSource& orig) {
+}
+
+SyntheticSource::~SyntheticSource() {
+}
+
+/**
+ * Set up the trajectory and the camera and render the water.
+ *
+ * @param trajectory_name circle, figure8, line or waypoints:x,y,x,y,... with
+ * the waypoints in meters. Empty name is a circle.
+ * @return false if the trajectory is not valid
+ */
+bool SyntheticSource::open(string trajectory_name) {
+
+    if (trajectory_name.empty() || trajectory_name == "circle") {
+
+        trajectory = TRAJECTORY_CIRCLE;
+
+    } else if (trajectory_name == "figure8") {
+
+        trajectory = TRAJECTORY_FIGURE_EIGHT;
+
+    } else if (trajectory_name == "line") {
+
+        trajectory = TRAJECTORY_LINE;
+
+    } else if (trajectory_name.compare(0, 10, "waypoints:") == 0) {
+
+        trajectory = TRAJECTORY_WAYPOINTS;
+
+        // Coordinates separated by commas
+        string coordinates = trajectory_name.substr(10);
+        replace(coordinates.begin(), coordinates.end(), ',', ' ');
+        istringstream stream(coordinates);
+
+        waypoints.clear();
+        Point2d waypoint;
+        while (stream >> waypoint.x >> waypoint.y) {
+            waypoints.push_back(waypoint);
+        }
+
+        // The path is closed, so it goes back from the last waypoint to the
+        // first one
+        waypoint_distances.assign(1, 0);
+        for (int i = 0; i < waypoints.size(); i++) {
+            Point2d segment = waypoints[(i + 1) % waypoints.size()] - waypoints[i];
+            waypoint_distances.push_back(waypoint_distances.back() + sqrt(segment.dot(segment)));
+        }
+
+        if (waypoints.size() < 2 || !stream.eof() || waypoint_distances.back() <= 0) {
+            cerr << "Waypoints have to be at least two different x,y pairs in meters." << endl;
+            return false;
+        }
+
+    } else {
+
+        cerr << "Unknown trajectory " << trajectory_name << "." << endl;
+        return false;
+
+    }
+
+    // Camera looking at the origin of the water plane. X axis of the water
+    // goes to the right and Y axis away from the camera.
+    Size frame_size = settings->synthetic_frame_size;
+    double focal_length = frame_size.width / 2.0 / tan(settings->synthetic_field_of_view * CV_PI / 360);
+    double tilt = settings->synthetic_camera_angle * CV_PI / 180;
+
+    double camera[3][3] = {
+        {focal_length, 0, frame_size.width / 2.0},
+        {0, focal_length, frame_size.height / 2.0},
+        {0, 0, 1}
+    };
+
+    // Rotation columns of the X and Y axes and the translation of the water
+    // plane in the camera coordinates
+    double plane[3][3] = {
+        {1, 0, 0},
+        {0, -cos(tilt), 0},
+        {0, sin(tilt), settings->synthetic_altitude / cos(tilt)}
+    };
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            homography[i][j] = 0;
+            for (int k = 0; k < 3; k++) {
+                homography[i][j] += camera[i][k] * plane[k][j];
+            }
+        }
+    }
+
+    render_water();
+
+    frame_number = 0;
+
+    return true;
+}
+
+/**
+ * Render the next frame.
+ *
+ * @param frame
+ * @return false after the last frame of the scene
+ */
+bool SyntheticSource::read(Mat& frame) {
+
+    if (frame_number >= settings->synthetic_frames) {
+        return false;
+    }
+
+    render(frame_number++, frame);
+
+    return true;
+}
+
+double SyntheticSource::get_fps() {
+    return settings->synthetic_fps;
+}
+
+Size SyntheticSource::get_size() {
+    return settings->synthetic_frame_size;
+}
+
+/**
+ * Rendered frames are never dropped.
+ *
+ * @return
+ */
+bool SyntheticSource::is_live() {
+    return false;
+}
+
+/**
+ * Render frame with the given number.
+ *
+ * @param number
+ * @param frame
+ */
+void SyntheticSource::render(long number, Mat& frame) {
+
+    backgrounds[number % backgrounds.size()].copyTo(frame);
+
+    // Sun glints at random places
+    RNG random_generator(settings->synthetic_seed * 7919 + number);
+    for (int i = 0; i < settings->synthetic_glints; i++) {
+        Point glint(random_generator.uniform(0, frame.cols), random_generator.uniform(0, frame.rows));
+        circle(frame, glint, random_generator.uniform(1, 4), GLINT_COLOR, FILLED, LINE_AA);
+    }
+
+    // Hull on top of them
+    vector<Point2d> hull;
+    get_hull(number, hull);
+
+    vector<Point> hull_vertices(hull.size());
+    for (int i = 0; i < hull.size(); i++) {
+        hull_vertices[i] = Point(cvRound(hull[i].x * (1 << HULL_SHIFT)), cvRound(hull[i].y * (1 << HULL_SHIFT)));
+    }
+
+    fillConvexPoly(frame, hull_vertices.data(), (int) hull_vertices.size(), HULL_COLOR, LINE_AA, HULL_SHIFT);
+}
+
+/**
+ * Get exact pose of the hull in the frame with the given number.
+ *
+ * @param number
+ * @return
+ */
+GroundTruth SyntheticSource::get_ground_truth(long number) {
+
+    GroundTruth ground_truth;
+    ground_truth.frame_number = number;
+
+    // Centroid of the hull polygon
+    vector<Point2d> hull;
+    get_hull(number, hull);
+
+    double area = 0;
+    Point2d center(0, 0);
+    for (int i = 0; i < hull.size(); i++) {
+        Point2d& a = hull[i];
+        Point2d& b = hull[(i + 1) % hull.size()];
+        double cross = a.x * b.y - b.x * a.y;
+        area += cross;
+        center += (a + b) * cross;
+    }
+    ground_truth.center = center * (1 / (3 * area));
+
+    // Heading as the direction of a short step forward in the image
+    Point2d position;
+    double heading;
+    get_pose(number / settings->synthetic_fps, position, heading);
+
+    Point2d image_position = ground_to_image(position);
+    Point2d image_step = ground_to_image(position + Point2d(cos(heading), sin(heading)) * 0.1) - image_position;
+    ground_truth.heading = atan2(image_step.y, image_step.x) * 180 / CV_PI;
+
+    return ground_truth;
+}
+
+/**
+ * Get bounding box of the hull in the frame with the given number, e.g. to
+ * select it as the object of interest.
+ *
+ * @param number
+ * @return
+ */
+Rect SyntheticSource::get_hull_box(long number) {
+
+    vector<Point2d> hull;
+    get_hull(number, hull);
+
+    double left = hull[0].x, right = hull[0].x, top = hull[0].y, bottom = hull[0].y;
+    for (int i = 1; i < hull.size(); i++) {
+        left = min(left, hull[i].x);
+        right = max(right, hull[i].x);
+        top = min(top, hull[i].y);
+        bottom = max(bottom, hull[i].y);
+    }
+
+    return Rect(Point((int) floor(left), (int) floor(top)), Point((int) ceil(right), (int) ceil(bottom)));
+}
+
+/**
+ * Write pose of the hull in all frames of the scene as "frame_number x y
+ * heading" lines.
+ *
+ * @param file_name
+ * @return false if the file cannot be written
+ */
+bool SyntheticSource::write_ground_truth(string file_name) {
+
+    ofstream file(file_name);
+
+    if (!file.is_open()) {
+        cerr << "Cannot open the ground truth file " << file_name << " for write." << endl;
+        return false;
+    }
+
+    file << "frame_number x y heading" << endl;
+    file << fixed << setprecision(3);
+
+    for (long i = 0; i < settings->synthetic_frames; i++) {
+        GroundTruth ground_truth = get_ground_truth(i);
+        file << i << " " << ground_truth.center.x << " " << ground_truth.center.y << " " << ground_truth.heading << "\n";
+    }
+
+    return file.good();
+}
+
+/**
+ * Project point on the water to the image.
+ *
+ * @param point in meters
+ * @return point in pixels
+ */
+Point2d SyntheticSource::ground_to_image(Point2d point) {
+
+    double x = homography[0][0] * point.x + homography[0][1] * point.y + homography[0][2];
+    double y = homography[1][0] * point.x + homography[1][1] * point.y + homography[1][2];
+    double w = homography[2][0] * point.x + homography[2][1] * point.y + homography[2][2];
+
+    return Point2d(x / w, y / w);
+}
+
+/**
+ * Get position and heading of the hull on the water.
+ *
+ * @param time in seconds
+ * @param position in meters
+ * @param heading in radians from the X axis
+ */
+void SyntheticSource::get_pose(double time, Point2d& position, double& heading) {
+
+    double radius = settings->synthetic_trajectory_radius;
+    double distance = settings->synthetic_speed * time;
+
+    switch (trajectory) {
+
+        case TRAJECTORY_CIRCLE:
+        {
+            double angle = distance / radius;
+            position = Point2d(cos(angle), sin(angle)) * radius;
+            heading = angle + CV_PI / 2;
+            break;
+        }
+
+        case TRAJECTORY_FIGURE_EIGHT:
+        {
+            // Lemniscate of Gerono
+            double angle = distance / radius;
+            position = Point2d(sin(angle), sin(angle) * cos(angle)) * radius;
+            heading = atan2(cos(2 * angle), cos(angle));
+            break;
+        }
+
+        case TRAJECTORY_LINE:
+        {
+            // There and back along the X axis
+            double offset = fmod(distance, 4 * radius);
+            if (offset < 2 * radius) {
+                position = Point2d(offset - radius, 0);
+                heading = 0;
+            } else {
+                position = Point2d(3 * radius - offset, 0);
+                heading = CV_PI;
+            }
+            break;
+        }
+
+        case TRAJECTORY_WAYPOINTS:
+        {
+            double offset = fmod(distance, waypoint_distances.back());
+
+            int i = 0;
+            while (i + 1 < waypoints.size() && waypoint_distances[i + 1] <= offset) {
+                i++;
+            }
+
+            Point2d segment = waypoints[(i + 1) % waypoints.size()] - waypoints[i];
+            double segment_length = waypoint_distances[i + 1] - waypoint_distances[i];
+
+            position = waypoints[i] + segment * ((offset - waypoint_distances[i]) / segment_length);
+            heading = atan2(segment.y, segment.x);
+            break;
+        }
+    }
+}
+
+/**
+ * Get outline of the hull in the image.
+ *
+ * @param number frame number
+ * @param hull vertices in pixels
+ */
+void SyntheticSource::get_hull(long number, vector<Point2d>& hull) {
+
+    Point2d position;
+    double heading;
+    get_pose(number / settings->synthetic_fps, position, heading);
+
+    // Pointed bow and square stern, forward along the x axis
+    double length = settings->synthetic_hull_length;
+    double beam = settings->synthetic_hull_beam;
+    Point2d outline[] = {
+        Point2d(length / 2, 0),
+        Point2d(length / 6, beam / 2),
+        Point2d(-length / 2, beam * 0.4),
+        Point2d(-length / 2, -beam * 0.4),
+        Point2d(length / 6, -beam / 2)
+    };
+
+    hull.clear();
+    for (Point2d& vertex : outline) {
+        Point2d rotated(vertex.x * cos(heading) - vertex.y * sin(heading), vertex.x * sin(heading) + vertex.y * cos(heading));
+        hull.push_back(ground_to_image(position + rotated));
+    }
+}
+
+/**
+ * Render the water with waves and patches of different color as seen by the
+ * camera and add sensor noise to its copies.
+ *
+ */
+void SyntheticSource::render_water() {
+
+    Size frame_size = settings->synthetic_frame_size;
+    RNG random_generator(settings->synthetic_seed);
+
+    // Waves of random direction, length and phase
+    const int WAVES = 3;
+    double wave_direction[WAVES];
+    double wave_number[WAVES];
+    double wave_phase[WAVES];
+    for (int i = 0; i < WAVES; i++) {
+        wave_direction[i] = random_generator.uniform(0.0, CV_PI);
+        wave_number[i] = 2 * CV_PI / random_generator.uniform(1.5, 6.0);
+        wave_phase[i] = random_generator.uniform(0.0, 2 * CV_PI);
+    }
+
+    // Patches on a 16 x 16 grid of 4 meter cells repeated over the water
+    Mat patches(16, 16, CV_64F);
+    random_generator.fill(patches, RNG::UNIFORM, -1, 1);
+
+    // Image to water
+    Mat inverse_homography = Mat(3, 3, CV_64F, homography).inv();
+    const double * h = inverse_homography.ptr<double>();
+
+    Mat water(frame_size, CV_8UC3);
+
+    for (int row = 0; row < frame_size.height; row++) {
+
+        Vec3b * pixel = water.ptr<Vec3b>(row);
+
+        for (int column = 0; column < frame_size.width; column++) {
+
+            double w = h[6] * column + h[7] * row + h[8];
+
+            // Above the horizon
+            if (w <= 0) {
+                pixel[column] = Vec3b(SKY_COLOR[0], SKY_COLOR[1], SKY_COLOR[2]);
+                continue;
+            }
+
+            double x = (h[0] * column + h[1] * row + h[2]) / w;
+            double y = (h[3] * column + h[4] * row + h[5]) / w;
+
+            double waves = 0;
+            for (int i = 0; i < WAVES; i++) {
+                waves += sin((x * cos(wave_direction[i]) + y * sin(wave_direction[i])) * wave_number[i] + wave_phase[i]);
+            }
+
+            // Bilinear interpolation of the patches
+            double patch_x = x / 4;
+            double patch_y = y / 4;
+            int cell_x = (int) floor(patch_x);
+            int cell_y = (int) floor(patch_y);
+            double fraction_x = patch_x - cell_x;
+            double fraction_y = patch_y - cell_y;
+            double top = (1 - fraction_x) * patches.at<double>(cell_y & 15, cell_x & 15) + fraction_x * patches.at<double>(cell_y & 15, (cell_x + 1) & 15);
+            double bottom = (1 - fraction_x) * patches.at<double>((cell_y + 1) & 15, cell_x & 15) + fraction_x * patches.at<double>((cell_y + 1) & 15, (cell_x + 1) & 15);
+            double patch = (1 - fraction_y) * top + fraction_y * bottom;
+
+            double shade = 1 + 0.06 * waves + 0.12 * patch;
+            pixel[column] = Vec3b(saturate_cast<uchar> (WATER_COLOR[0] * shade), saturate_cast<uchar> (WATER_COLOR[1] * shade), saturate_cast<uchar> (WATER_COLOR[2] * shade));
+        }
+    }
+
+    // Copies with different sensor noise
+    backgrounds.resize(settings->SYNTHETIC_BACKGROUNDS);
+    for (int i = 0; i < backgrounds.size(); i++) {
+        Mat noise(frame_size, CV_16SC3);
+        random_generator.fill(noise, RNG::NORMAL, 0, settings->synthetic_noise);
+        add(water, noise, backgrounds[i], noArray(), CV_8UC3);
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * File:   SyntheticSource.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef SYNTHETICSOURCE_HPP
+#define SYNTHETICSOURCE_HPP
+
+#include <string>
+#include <vector>
+#include "FrameSource.hpp"
+#include "Settings.hpp"
+
+// Path of the hull on the water
+enum SyntheticTrajectory {
+    TRAJECTORY_CIRCLE,
+    TRAJECTORY_FIGURE_EIGHT,
+    TRAJECTORY_LINE,
+    TRAJECTORY_WAYPOINTS
+};
+
+// Exact pose of the hull in one frame
+struct GroundTruth {
+
+    long frame_number;
+
+    // Centroid of the rendered hull in pixels
+    Point2d center;
+
+    // Heading in the image in degrees, measured the same way as the heading
+    // of EMILY estimated by the tracker
+    double heading;
+};
+
+/**
+ * Rendered scene of a red hull moving on textured water with sun glints, seen
+ * by a tilted camera from the given altitude. The hull follows a programmable
+ * trajectory and its exact centroid and heading are known for each frame, so
+ * tracking can be tested for accuracy and throughput without a video.
+ *
+ * Water with sensor noise is rendered in advance, so a frame costs a copy
+ * and a few small shapes. The scene depends only on the settings and the
+ * frame number.
+ */
+class SyntheticSource : public FrameSource {
+public:
+    SyntheticSource(Settings&);
+    SyntheticSource(const SyntheticSource& orig);
+    virtual ~SyntheticSource();
+
+    bool open(string);
+
+    bool read(Mat&);
+
+    double get_fps();
+
+    Size get_size();
+
+    bool is_live();
+
+    void render(long, Mat&);
+
+    GroundTruth get_ground_truth(long);
+
+    Rect get_hull_box(long);
+
+    bool write_ground_truth(string);
+
+    Point2d ground_to_image(Point2d);
+
+private:
+
+    void get_pose(double, Point2d&, double&);
+
+    void get_hull(long, vector<Point2d>&);
+
+    void render_water();
+
+    // Program settings
+    Settings * settings;
+
+    SyntheticTrajectory trajectory;
+
+    // Closed path of the waypoints trajectory in meters and the distance
+    // along the path to each waypoint
+    vector<Point2d> waypoints;
+    vector<double> waypoint_distances;
+
+    // Homography from the water plane in meters to the image
+    double homography[3][3];
+
+    // Water with different sensor noise
+    vector<Mat> backgrounds;
+
+    // Number of the next frame read
+    long frame_number;
+
+};
+
+#endif /* SYNTHETICSOURCE_HPP */
+
@@ -0,0 +1,202 @@
+/*
+ * File:   Trace.cpp
+ * Author: Jan Dufek
+ */
+
+#include "Trace.hpp"
+#include <iostream>
+#include <stdio.h>
+
+atomic<bool> Trace::enabled(false);
+ofstream Trace::trace_file;
+bool Trace::first_event;
+chrono::steady_clock::time_point Trace::start_time;
+vector<TraceThread *> Trace::threads;
+mutex Trace::threads_mutex;
+int Trace::buffer_size;
+int Trace::write_interval;
+thread Trace::writer_thread;
+vector<TraceEvent> Trace::batch;
+
+// Buffer of the current thread
+static thread_local TraceThread * current_thread = NULL;
+
+// Name of the current thread. Can be set before the trace is started.
+static thread_local string current_thread_name;
+
+/**
+ * Start recording the trace. Can be started only once.
+ *
+ * @param file_name
+ * @param size number of events buffered for each thread
+ * @param interval how often the buffers are flushed in milliseconds
+ */
+void Trace::start(string file_name, int size, int interval) {
+
+    trace_file.open(file_name);
+
+    if (!trace_file.is_open()) {
+        cout << "Cannot open the trace file " << file_name << " for write." << endl;
+        return;
+    }
+
+    trace_file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    first_event = true;
+
+    buffer_size = size;
+    write_interval = interval;
+    batch.resize(buffer_size);
+
+    start_time = chrono::steady_clock::now();
+    enabled = true;
+
+    writer_thread = thread(run);
+}
+
+/**
+ * Stop recording, write the remaining events and close the trace file.
+ *
+ */
+void Trace::stop() {
+
+    if (!writer_thread.joinable()) {
+        return;
+    }
+
+    enabled = false;
+    writer_thread.join();
+
+    write_events();
+
+    // Names of the thread lanes
+    lock_guard<mutex> lock(threads_mutex);
+
+    for (int i = 0; i < threads.size(); i++) {
+        trace_file << (first_event ? "\n" : ",\n");
+        trace_file << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << threads[i]->id << ",\"name\":\"thread_name\",\"args\":{\"name\":\"" << threads[i]->name << "\"}}";
+        first_event = false;
+    }
+
+    trace_file << "\n]}\n";
+    trace_file.close();
+}
+
+/**
+ * Get buffer of the current thread. Registers the thread on its first event.
+ *
+ * @return
+ */
+TraceThread * Trace::get_thread() {
+
+    if (current_thread == NULL) {
+
+        lock_guard<mutex> lock(threads_mutex);
+
+        current_thread = new TraceThread(buffer_size);
+        current_thread->id = threads.size() + 1;
+        current_thread->name = current_thread_name.empty() ? "Thread " + to_string(current_thread->id) : current_thread_name;
+
+        threads.push_back(current_thread);
+    }
+
+    return current_thread;
+}
+
+/**
+ * Name the lane of the current thread. Can be called before the trace is
+ * started.
+ *
+ * @param name
+ */
+void Trace::set_thread_name(string name) {
+
+    current_thread_name = name;
+
+    if (current_thread != NULL) {
+        lock_guard<mutex> lock(threads_mutex);
+        current_thread->name = name;
+    }
+}
+
+/**
+ * Record one event of the current thread. Events are dropped when the buffer
+ * of the thread is full.
+ *
+ * @param name string literal
+ * @param start
+ * @param end
+ */
+void Trace::record(const char * name, chrono::steady_clock::time_point start, chrono::steady_clock::time_point end) {
+
+    if (!is_enabled()) {
+        return;
+    }
+
+    TraceEvent event;
+    event.name = name;
+    event.start = chrono::duration_cast<chrono::nanoseconds>(start - start_time).count();
+    event.duration = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+
+    get_thread()->events.push(event);
+}
+
+/**
+ * Get number of events dropped because a buffer was full.
+ *
+ * @return
+ */
+long Trace::get_dropped_events() {
+
+    lock_guard<mutex> lock(threads_mutex);
+
+    long dropped = 0;
+    for (int i = 0; i < threads.size(); i++) {
+        dropped += threads[i]->events.get_dropped();
+    }
+
+    return dropped;
+}
+
+/**
+ * Writer loop.
+ *
+ */
+void Trace::run() {
+
+    while (enabled) {
+        write_events();
+        this_thread::sleep_for(chrono::milliseconds(write_interval));
+    }
+}
+
+/**
+ * Write buffered events of all threads to the trace file.
+ *
+ */
+void Trace::write_events() {
+
+    vector<TraceThread *> current_threads;
+    {
+        lock_guard<mutex> lock(threads_mutex);
+        current_threads = threads;
+    }
+
+    char line[256];
+
+    for (int i = 0; i < current_threads.size(); i++) {
+
+        int n;
+        while ((n = current_threads[i]->events.pop(batch.data(), (int) batch.size())) > 0) {
+
+            for (int j = 0; j < n; j++) {
+
+                // Complete event with time stamps in microseconds
+                snprintf(line, sizeof(line), "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f}", first_event ? "\n" : ",\n", current_threads[i]->id, batch[j].name, batch[j].start / 1000.0, batch[j].duration / 1000.0);
+                trace_file << line;
+                first_event = false;
+            }
+        }
+    }
+
+    trace_file.flush();
+}
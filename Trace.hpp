@@ -0,0 +1,138 @@
+/*
+ * File:   Trace.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include "RingBuffer.hpp"
+
+using namespace std;
+
+// One timed scope
+struct TraceEvent {
+
+    // Name of the scope. Has to be a string literal.
+    const char * name;
+
+    // Start and duration in nanoseconds since the trace was started
+    int64_t start;
+    int64_t duration;
+};
+
+// Events of one thread
+struct TraceThread {
+
+    RingBuffer<TraceEvent> events;
+
+    // Lane of the thread in the trace
+    int id;
+
+    string name;
+
+    TraceThread(int capacity) : events(capacity) {
+    }
+};
+
+/**
+ * Timeline of scopes in the Chrome trace format, loadable in chrome://tracing
+ * and Perfetto. Each thread has its own lane and its own lock-free buffer,
+ * which the writer thread flushes to the file in the background. When the
+ * trace is not started, timing a scope costs one atomic load.
+ */
+class Trace {
+public:
+
+    static void start(string, int, int);
+
+    static void stop();
+
+    /**
+     * Check if the trace is being recorded.
+     *
+     * @return
+     */
+    static bool is_enabled() {
+        return enabled.load(memory_order_relaxed);
+    }
+
+    static void set_thread_name(string);
+
+    static void record(const char *, chrono::steady_clock::time_point, chrono::steady_clock::time_point);
+
+    static long get_dropped_events();
+
+private:
+
+    static TraceThread * get_thread();
+
+    static void run();
+
+    static void write_events();
+
+    static atomic<bool> enabled;
+
+    // Trace file
+    static ofstream trace_file;
+    static bool first_event;
+
+    // Time when the trace was started
+    static chrono::steady_clock::time_point start_time;
+
+    // Buffers of all threads that recorded events. They live until the
+    // program ends, as the threads keep pointers to them.
+    static vector<TraceThread *> threads;
+    static mutex threads_mutex;
+
+    // Size of buffer of each thread
+    static int buffer_size;
+
+    // How often the buffers are flushed in milliseconds
+    static int write_interval;
+
+    static thread writer_thread;
+
+    // Batch of events taken from a buffer
+    static vector<TraceEvent> batch;
+
+};
+
+/**
+ * Records time from its construction to its destruction as one trace event.
+ * The name has to be a string literal.
+ */
+class TraceScope {
+public:
+
+    TraceScope(const char * n) {
+        name = Trace::is_enabled() ? n : NULL;
+        if (name != NULL) {
+            start = chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceScope() {
+        if (name != NULL) {
+            Trace::record(name, start, chrono::steady_clock::now());
+        }
+    }
+
+private:
+
+    const char * name;
+
+    chrono::steady_clock::time_point start;
+
+};
+
+#endif /* TRACE_HPP */
+
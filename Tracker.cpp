@@ -0,0 +1,706 @@
+/*
+ * File:   Tracker.cpp
+ * Author: Jan Dufek
+ */
+
+#include "Tracker.hpp"
+#include <iostream>
+#include <string.h>
+
+Tracker::Tracker(Settings& s) {
+
+    settings = &s;
+
+    histogram_size = 16;
+
+    histogram_ranges[0] = 0;
+    histogram_ranges[1] = 180;
+
+    preprocessed_frames = 0;
+    full_frames = 0;
+    preprocessed_pixels = 0;
+    total_pixels = 0;
+
+    equalization_histogram_total = 0;
+    frames_since_equalization = 0;
+    equalization_frames = 0;
+    equalization_updates = 0;
+    region_equalization_frames = 0;
+    region_equalization_updates = 0;
+
+}
+
+Tracker::Tracker(const Tracker& orig) {
+}
+
+Tracker::~Tracker() {
+}
+
+/**
+ * Blur the frame, convert it to HSV color space and equalize it. Only the
+ * given region of the frame is processed.
+ *
+ * @param original_frame
+ * @param region region of the original frame to process
+ * @param blured_frame blured region
+ * @param HSV_frame HSV region
+ */
+void Tracker::preprocess(Mat& original_frame, Rect region, Mat& blured_frame, Mat& HSV_frame) {
+
+    bool full_frame = region.size() == original_frame.size();
+
+    filter(original_frame, region, 0, blured_frame, HSV_frame);
+
+    // Statistics
+    preprocessed_frames++;
+    preprocessed_pixels += region.area();
+    total_pixels += original_frame.total();
+    if (full_frame) {
+        full_frames++;
+    }
+
+}
+
+/**
+ * Build image pyramid of the frame and preprocess its coarsest level. The
+ * object is then tracked at the coarse level and refined in the original
+ * frame by track_pyramid.
+ *
+ * @param original_frame
+ * @param pyramid original frame followed by the downsampled levels
+ * @param coarse_HSV_frame HSV of the coarsest level
+ * @param frame_equalization_table equalization table the coarsest level was
+ * equalized with, for the refinement
+ */
+void Tracker::preprocess_pyramid(Mat& original_frame, vector<Mat>& pyramid, Mat& coarse_HSV_frame, Mat& frame_equalization_table) {
+
+    int levels = settings->pyramid_levels;
+
+    buildPyramid(original_frame, pyramid, levels);
+
+    Mat& coarse_frame = pyramid[levels];
+
+    Mat coarse_blured_frame;
+    filter(coarse_frame, Rect(0, 0, coarse_frame.cols, coarse_frame.rows), levels, coarse_blured_frame, coarse_HSV_frame);
+
+    frame_equalization_table = equalization_table;
+
+    // Statistics. Refinement region is counted when tracking.
+    preprocessed_frames++;
+    preprocessed_pixels += coarse_frame.total();
+    total_pixels += original_frame.total();
+
+}
+
+/**
+ * Blur the region of the frame and compute its back projection directly from
+ * the blured BGR pixels. Gives the same back projection as preprocess followed
+ * by track, but without the HSV frame, which is left empty.
+ *
+ * @param original_frame
+ * @param region region of the original frame to process
+ * @param blured_frame blured region
+ * @param back_projection back projection of the region
+ */
+void Tracker::preprocess_back_projection(Mat& original_frame, Rect region, Mat& blured_frame, Mat& back_projection) {
+
+    bool full_frame = region.size() == original_frame.size();
+
+    blur(original_frame, region, 0, blured_frame, box_blur);
+
+    if (!full_frame) {
+        update_region_equalization_table(original_frame);
+    }
+
+    // Value (V) is the maximum of BGR, so the equalization table can be built
+    // without the HSV frame
+    if (full_frame || equalization_table.empty()) {
+        int value_histogram[256];
+        int samples = BackProjection::value_histogram(blured_frame, max(1, settings->equalization_sample_step), value_histogram);
+        update_equalization_table(value_histogram, samples);
+    }
+
+    Mat hue_table;
+    {
+        lock_guard<mutex> lock(histogram_mutex);
+        hue_table = hue_back_projection_table;
+    }
+
+    if (hue_table.empty()) {
+        back_projection = Mat::zeros(blured_frame.size(), CV_8U);
+    } else {
+        back_projector.compute(blured_frame, hue_table, equalization_table, settings->saturation_min, settings->saturation_max, settings->value_min, settings->value_max, back_projection);
+    }
+
+    // Statistics
+    preprocessed_frames++;
+    preprocessed_pixels += region.area();
+    total_pixels += original_frame.total();
+    if (full_frame) {
+        full_frames++;
+    }
+
+}
+
+/**
+ * Blur the region of the frame, convert it to HSV color space and equalize it.
+ *
+ * @param frame
+ * @param region region of the frame to process
+ * @param level pyramid level of the frame. Blur is scaled down accordingly.
+ * @param blured_frame blured region
+ * @param HSV_frame HSV region
+ */
+void Tracker::filter(Mat& frame, Rect region, int level, Mat& blured_frame, Mat& HSV_frame) {
+
+    bool full_frame = region.size() == frame.size();
+
+    blur(frame, region, level, blured_frame, box_blur);
+
+    // Convert to HSV color space
+    cvtColor(blured_frame, HSV_frame, COLOR_BGR2HSV);
+
+    if (!full_frame) {
+        update_region_equalization_table(frame);
+    }
+
+    // Equalize on value (V)
+    equalize(HSV_frame, full_frame);
+
+}
+
+/**
+ * Blur the region of the frame with Gaussian filter or its approximation by
+ * stacked box filters.
+ *
+ * @param frame
+ * @param region region of the frame to process
+ * @param level pyramid level of the frame. Blur is scaled down accordingly.
+ * @param blured_frame blured region
+ * @param frame_box_blur box blur of the calling thread
+ */
+void Tracker::blur(Mat& frame, Rect region, int level, Mat& blured_frame, BoxBlur& frame_box_blur) {
+
+    // Gaussian kernel size must be odd. The trackbar can change it at any time,
+    // so do not rely on the trackbar handler.
+    int blur_kernel_size = settings->blur_kernel_size >> level;
+    if (blur_kernel_size % 2 == 0) {
+        blur_kernel_size++;
+    }
+
+    // Apply Gaussian blur filter. The filter reads pixels around the region
+    // from the rest of the frame, so the result is the same as in the full frame.
+    if (settings->blur_engine == BLUR_BOX && blur_kernel_size >= settings->BOX_BLUR_MIN_KERNEL_SIZE) {
+        frame_box_blur.apply(frame, region, blured_frame, blur_kernel_size);
+    } else {
+        GaussianBlur(frame(region), blured_frame, Size(blur_kernel_size, blur_kernel_size), 0, 0);
+    }
+
+}
+
+/**
+ * Equalize histogram of value (V) of the given frame in place. The
+ * equalization look up table is computed from full frames only, the same way
+ * as equalizeHist does it. Regions are equalized with the table from the last
+ * full frame, so that the values do not depend on the size of the region. See
+ * update_region_equalization_table for regions.
+ *
+ * @param HSV_frame
+ * @param full_frame the frame is not just a region
+ */
+void Tracker::equalize(Mat& HSV_frame, bool full_frame) {
+
+    if (full_frame || equalization_table.empty()) {
+
+        // Histogram of value on a subsampled grid
+        int step = max(1, settings->equalization_sample_step);
+        int value_histogram[256] = {0};
+        int samples = 0;
+        for (int row = 0; row < HSV_frame.rows; row += step) {
+            const uchar * pixel = HSV_frame.ptr(row);
+            for (int column = 0; column < HSV_frame.cols; column += step) {
+                value_histogram[pixel[3 * column + 2]]++;
+                samples++;
+            }
+        }
+
+        update_equalization_table(value_histogram, samples);
+    }
+
+    apply_equalization_table(HSV_frame, equalization_table);
+}
+
+/**
+ * Apply the equalization look up table to value of the interleaved HSV frame.
+ *
+ * @param HSV_frame
+ * @param table_matrix 1x256 look up table
+ */
+void Tracker::apply_equalization_table(Mat& HSV_frame, const Mat& table_matrix) {
+
+    const uchar * table = table_matrix.ptr();
+    for (int row = 0; row < HSV_frame.rows; row++) {
+        uchar * value = HSV_frame.ptr(row) + 2;
+        for (int column = 0; column < HSV_frame.cols; column++) {
+            value[3 * column] = table[value[3 * column]];
+        }
+    }
+}
+
+/**
+ * Keep the equalization look up table up to date while only a region of the
+ * frame is preprocessed. Histogram of value of the region does not show the
+ * light of the whole scene, so value of the whole original frame is sampled
+ * once per equalization interval instead. The table then follows changing
+ * light and auto exposure even if the object is tracked for the whole mission.
+ *
+ * @param frame original BGR frame
+ */
+void Tracker::update_region_equalization_table(Mat& frame) {
+
+    // Table of the first frame is built from the region by equalize
+    if (equalization_table.empty() || ++frames_since_equalization < settings->equalization_interval) {
+        return;
+    }
+
+    // Value (V) is the maximum of BGR
+    int value_histogram[256];
+    int samples = BackProjection::value_histogram(frame, max(1, settings->equalization_sample_step), value_histogram);
+
+    region_equalization_frames++;
+    if (update_equalization_table(value_histogram, samples)) {
+        region_equalization_updates++;
+    }
+}
+
+/**
+ * Rebuild the equalization look up table if it is old or the histogram of
+ * value drifted too far from the one it was built from.
+ *
+ * @param value_histogram 256 bins
+ * @param total number of pixels in the histogram
+ * @return true if the table was rebuilt
+ */
+bool Tracker::update_equalization_table(const int * value_histogram, int total) {
+
+    equalization_frames++;
+
+    if (!equalization_table.empty() && ++frames_since_equalization < settings->equalization_interval) {
+
+        // Drift is the fraction of pixels which moved to other bins
+        double drift = 0;
+        for (int i = 0; i < 256; i++) {
+            drift += fabs((double) value_histogram[i] / total - (double) equalization_histogram[i] / equalization_histogram_total);
+        }
+        drift /= 2;
+
+        if (drift < settings->EQUALIZATION_DRIFT_THRESHOLD) {
+            return false;
+        }
+    }
+
+    build_equalization_table(value_histogram, total);
+
+    memcpy(equalization_histogram, value_histogram, sizeof (equalization_histogram));
+    equalization_histogram_total = total;
+    frames_since_equalization = 0;
+    equalization_updates++;
+
+    return true;
+}
+
+/**
+ * Build the value equalization look up table from histogram of value.
+ *
+ * @param value_histogram 256 bins
+ * @param total number of pixels
+ */
+void Tracker::build_equalization_table(const int * value_histogram, int total) {
+
+    // New memory, the tracking may still use the previous table
+    equalization_table = Mat::zeros(1, 256, CV_8U);
+    uchar * table = equalization_table.ptr();
+
+    // First used value
+    int i = 0;
+    while (i < 255 && !value_histogram[i]) {
+        i++;
+    }
+
+    if (value_histogram[i] == total) {
+
+        // Single value frame
+        equalization_table = Scalar::all(i);
+
+    } else {
+
+        // Cumulative histogram scaled to full range
+        float scale = 255.f / (total - value_histogram[i]);
+        int sum = 0;
+        for (table[i++] = 0; i < 256; i++) {
+            sum += value_histogram[i];
+            table[i] = saturate_cast<uchar> (sum * scale);
+        }
+    }
+}
+
+/**
+ * Get region of the frame to preprocess. It is the last tracking box with
+ * padding, or the full frame if the object is not tracked.
+ *
+ * @param frame_size
+ * @return
+ */
+Rect Tracker::get_search_region(Size frame_size) {
+
+    Rect full_frame(0, 0, frame_size.width, frame_size.height);
+
+    if (!settings->search_region_enabled) {
+        return full_frame;
+    }
+
+    lock_guard<mutex> lock(search_region_mutex);
+
+    Rect region = search_region & full_frame;
+
+    // Object is not tracked, so search the full frame to acquire it again
+    if (region.area() == 0) {
+        return full_frame;
+    }
+
+    return region;
+}
+
+/**
+ * Print how many pixels were preprocessed compared to preprocessing full
+ * frames and how often the equalization table was rebuilt.
+ *
+ */
+void Tracker::print_preprocessing_statistics() {
+
+    long frames = preprocessed_frames;
+    long total = total_pixels;
+
+    if (frames == 0 || total == 0) {
+        return;
+    }
+
+    double processed_ratio = (double) preprocessed_pixels / total;
+
+    cout << "Search region: " << (long) ((total - preprocessed_pixels) / frames) << " pixels/frame saved (" << (1 - processed_ratio) * 100 << " %), " << full_frames << " of " << frames << " frames searched in full" << endl;
+
+    cout << "Equalization: table rebuilt " << equalization_updates << " times in " << equalization_frames << " sampled frames, " << region_equalization_updates << " of them in " << region_equalization_frames << " full frames sampled while searching a region" << endl;
+}
+
+/**
+ * Threshold on saturation and value and extract hue.
+ *
+ * @param HSV_frame
+ * @param hue
+ * @param saturation_value_threshold
+ */
+void Tracker::threshold(Mat& HSV_frame, Mat& hue, Mat& saturation_value_threshold) {
+
+    // Threshold on saturation and value, but not on hue
+    inRange(HSV_frame, Scalar(0, settings->saturation_min, settings->value_min), Scalar(180, settings->saturation_max, settings->value_max), saturation_value_threshold);
+
+    // Mix channels
+    int chanels[] = {0, 0};
+    hue.create(HSV_frame.size(), HSV_frame.depth());
+    mixChannels(&HSV_frame, 1, &hue, 1, chanels, 1);
+
+}
+
+/**
+ * Select object of interest and create its histogram.
+ *
+ * @param HSV_frame
+ * @param selection
+ * @param histogram_image visualization of histogram
+ */
+void Tracker::select(Mat& HSV_frame, Rect selection, Mat& histogram_image) {
+
+    // HSV hue
+    Mat hue;
+
+    // Threshold on saturation and value only. Hue is not thresholded.
+    Mat saturation_value_threshold;
+
+    threshold(HSV_frame, hue, saturation_value_threshold);
+
+    // Region of interest
+    Mat region_of_interest(hue, selection);
+
+    // Region of interest mask
+    Mat region_of_interest_mask(saturation_value_threshold, selection);
+
+    // Calculate histogram of region of interest
+    const float * pointer_histogram_ranges = histogram_ranges;
+    calcHist(&region_of_interest, 1, 0, region_of_interest_mask, histogram, 1, &histogram_size, &pointer_histogram_ranges);
+
+    // Normalize histogram
+    normalize(histogram, histogram, 0, 255, NORM_MINMAX);
+
+    // Back projection of each hue for the fused kernel
+    Mat hue_table = BackProjection::create_hue_table(histogram, histogram_ranges);
+    {
+        lock_guard<mutex> lock(histogram_mutex);
+        hue_back_projection_table = hue_table;
+    }
+
+    // Set object of interest to selection
+    object_of_interest = selection;
+
+    // Search region will be set when the object is tracked
+    {
+        lock_guard<mutex> lock(search_region_mutex);
+        search_region = Rect();
+    }
+
+    // Create histogram visualization
+    histogram_image = Mat::zeros(200, 320, CV_8UC3);
+    int bins_width = histogram_image.cols / histogram_size;
+    Mat buffer(1, histogram_size, CV_8UC3);
+    for (int i = 0; i < histogram_size; i++)
+        buffer.at<Vec3b>(i) = Vec3b(saturate_cast<uchar> (i * 180. / histogram_size), 255, 255);
+    cvtColor(buffer, buffer, COLOR_HSV2BGR);
+    for (int i = 0; i < histogram_size; i++) {
+        int val = saturate_cast<int> (histogram.at<float> (i) * histogram_image.rows / 255);
+        rectangle(histogram_image, Point(i*bins_width, histogram_image.rows), Point((i + 1) * bins_width, histogram_image.rows - val), Scalar(buffer.at<Vec3b>(i)), -1, 8);
+    }
+}
+
+/**
+ * Track the object of interest using CamShift on histogram back projection.
+ *
+ * @param HSV_frame HSV region of the frame
+ * @param region region of the frame covered by the HSV frame
+ * @param tracking_box found location and pose of the object in the frame
+ * @param back_projection back projection of the region
+ * @return true if the object was found
+ */
+bool Tracker::track(Mat& HSV_frame, Rect region, RotatedRect& tracking_box, Mat& back_projection) {
+
+    // HSV hue
+    Mat hue;
+
+    // Threshold on saturation and value only. Hue is not thresholded.
+    Mat saturation_value_threshold;
+
+    threshold(HSV_frame, hue, saturation_value_threshold);
+
+    // Calculate back projection
+    const float * pointer_histogram_ranges = histogram_ranges;
+    calcBackProject(&hue, 1, 0, histogram, back_projection, &pointer_histogram_ranges);
+
+    // Apply back projection on saturation value threshold
+    back_projection &= saturation_value_threshold;
+
+    return track_back_projection(back_projection, region, tracking_box);
+}
+
+/**
+ * Track the object of interest using CamShift on the given histogram back
+ * projection.
+ *
+ * @param back_projection back projection of the region
+ * @param region region of the frame covered by the back projection
+ * @param tracking_box found location and pose of the object in the frame
+ * @return true if the object was found
+ */
+bool Tracker::track_back_projection(Mat& back_projection, Rect region, RotatedRect& tracking_box) {
+
+    // Search window relative to the region
+    Rect search_window = (object_of_interest & region) - region.tl();
+
+    // Object of interest left the region
+    if (search_window.area() == 0) {
+        tracking_box = RotatedRect();
+        lock_guard<mutex> lock(search_region_mutex);
+        search_region = Rect();
+        return false;
+    }
+
+    // CamShift algorithm
+    tracking_box = CamShift(back_projection, search_window, TermCriteria(TermCriteria::EPS | TermCriteria::COUNT, 10, 1));
+
+    // Object of interest are is too small, so inflate the tracking box
+    if (search_window.area() <= 1) {
+        int cols = back_projection.cols;
+        int rows = back_projection.rows;
+        int new_rectangle_size = (MIN(cols, rows) + 5) / 6;
+        search_window = Rect(search_window.x - new_rectangle_size, search_window.y - new_rectangle_size, search_window.x + new_rectangle_size, search_window.y + new_rectangle_size) & Rect(0, 0, cols, rows);
+    }
+
+    // Back to frame coordinates
+    object_of_interest = search_window + region.tl();
+    tracking_box.center.x += region.x;
+    tracking_box.center.y += region.y;
+
+    bool object_found = tracking_box.size.height > 0 && tracking_box.size.width > 0;
+
+    // Search next frames around the tracking box. The padding covers the
+    // motion during the frames already in the pipeline.
+    lock_guard<mutex> lock(search_region_mutex);
+    if (object_found) {
+        Rect bounding_box = tracking_box.boundingRect();
+        int padding = max(settings->SEARCH_REGION_MIN_PADDING, (int) (settings->SEARCH_REGION_PADDING * max(bounding_box.width, bounding_box.height)));
+        search_region = Rect(bounding_box.x - padding, bounding_box.y - padding, bounding_box.width + 2 * padding, bounding_box.height + 2 * padding);
+    } else {
+        search_region = Rect();
+    }
+
+    return object_found;
+}
+
+/**
+ * Track the object of interest at the coarsest pyramid level and refine the
+ * result in the original frame within a small region around the coarse
+ * tracking box.
+ *
+ * @param pyramid original frame followed by the downsampled levels
+ * @param coarse_HSV_frame HSV of the coarsest level
+ * @param frame_equalization_table equalization table of the frame given by
+ * preprocess_pyramid
+ * @param refine_region region of the original frame in which the result was refined
+ * @param tracking_box found location and pose of the object in the original frame
+ * @param back_projection back projection of the refine region
+ * @return true if the object was found
+ */
+bool Tracker::track_pyramid(vector<Mat>& pyramid, Mat& coarse_HSV_frame, const Mat& frame_equalization_table, Rect& refine_region, RotatedRect& tracking_box, Mat& back_projection) {
+
+    int levels = (int) pyramid.size() - 1;
+    int scale = 1 << levels;
+
+    Mat& original_frame = pyramid[0];
+    Rect full_frame(0, 0, original_frame.cols, original_frame.rows);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Coarse
+    ////////////////////////////////////////////////////////////////////////////
+
+    Mat hue;
+    Mat saturation_value_threshold;
+    threshold(coarse_HSV_frame, hue, saturation_value_threshold);
+
+    Mat coarse_back_projection;
+    const float * pointer_histogram_ranges = histogram_ranges;
+    calcBackProject(&hue, 1, 0, histogram, coarse_back_projection, &pointer_histogram_ranges);
+    coarse_back_projection &= saturation_value_threshold;
+
+    // Object of interest at the coarse level. Keep at least one pixel.
+    Rect coarse_window(object_of_interest.x / scale, object_of_interest.y / scale, max(1, object_of_interest.width / scale), max(1, object_of_interest.height / scale));
+    coarse_window &= Rect(0, 0, coarse_back_projection.cols, coarse_back_projection.rows);
+
+    RotatedRect coarse_box;
+    if (coarse_window.area() > 0) {
+        coarse_box = CamShift(coarse_back_projection, coarse_window, TermCriteria(TermCriteria::EPS | TermCriteria::COUNT, 10, 1));
+    }
+
+    if (coarse_box.size.width <= 0 || coarse_box.size.height <= 0) {
+        refine_region = full_frame;
+        back_projection = Mat::zeros(original_frame.size(), CV_8U);
+        tracking_box = RotatedRect();
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Refine
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Coarse tracking box in the original frame with padding
+    Rect coarse_bounding_box = coarse_box.boundingRect();
+    int padding = settings->PYRAMID_REFINE_PADDING;
+    refine_region = Rect(coarse_bounding_box.x * scale - padding, coarse_bounding_box.y * scale - padding, coarse_bounding_box.width * scale + 2 * padding, coarse_bounding_box.height * scale + 2 * padding) & full_frame;
+
+    // Start refinement from the coarse result
+    object_of_interest = Rect(coarse_window.x * scale, coarse_window.y * scale, coarse_window.width * scale, coarse_window.height * scale) & refine_region;
+
+    // Equalized with the table of the frame. Equalization and blur state of
+    // the preprocessing is not touched, it runs on another thread.
+    Mat blured_region;
+    Mat HSV_region;
+    blur(original_frame, refine_region, 0, blured_region, refine_box_blur);
+    cvtColor(blured_region, HSV_region, COLOR_BGR2HSV);
+    apply_equalization_table(HSV_region, frame_equalization_table);
+    preprocessed_pixels += refine_region.area();
+
+    return track(HSV_region, refine_region, tracking_box, back_projection);
+}
+
+/**
+ * Get principal axis of symmetry of given rectangle. It is the line connecting
+ * midpoints of the shortest sides.
+ *
+ * @param rectangle
+ * @param shortest_axis_midpoint_1
+ * @param shortest_axis_midpoint_2
+ */
+void Tracker::get_principal_axis(RotatedRect rectangle, Point& shortest_axis_midpoint_1, Point& shortest_axis_midpoint_2) {
+
+    // Get points of bounding rectangle
+    Point2f rectangle_points[4];
+    rectangle.points(rectangle_points);
+
+    // Initialize variables to look for the rectangle shortest side
+    double shortest_axis = DBL_MAX;
+    int shortest_axis_index = 0;
+
+    // For each side
+    for (int j = 0; j < 4; j++) {
+
+        // Line length
+        double line_length = norm(rectangle_points[j] - rectangle_points[(j + 1) % 4]);
+
+        if (line_length < shortest_axis) {
+            shortest_axis = line_length;
+            shortest_axis_index = j;
+        }
+    }
+
+    // Get midpoints of the shortest sides
+    shortest_axis_midpoint_1 = (rectangle_points[shortest_axis_index] + rectangle_points[(shortest_axis_index + 1) % 4]) * 0.5;
+    shortest_axis_midpoint_2 = (rectangle_points[(shortest_axis_index + 2) % 4] + rectangle_points[(shortest_axis_index + 3) % 4]) * 0.5;
+
+}
+
+/**
+ * Get orientation of the USV based on its location history. The history is
+ * approximated with a polynomial curve, whose last segment gives the heading.
+ *
+ * @param location_history ring of past locations
+ * @param history_size number of locations in the ring
+ * @param oldest index of the oldest location in the ring
+ * @param heading_line_length length of the heading line
+ * @param path_polynomial_approximation approximated path
+ * @param heading_point end of the heading line from the last location
+ * @return heading angle in degrees
+ */
+double Tracker::get_orientation(const Point * location_history, int history_size, int oldest, double heading_line_length, vector<Point>& path_polynomial_approximation, Point& heading_point) {
+
+    // Initialize input vector (approxPolyDP takes only vectors and not arrays)
+    vector<Point> input_points;
+
+    // Sort EMILY location history chronologically
+    for (int i = 0; i < history_size; i++) {
+        input_points.push_back(location_history[(oldest + i) % history_size]);
+    }
+
+    // Approximate location history with a polynomial curve
+    approxPolyDP(input_points, path_polynomial_approximation, 4, false);
+
+    // Difference in x axis
+    int delta_x_curve = path_polynomial_approximation[path_polynomial_approximation.size() - 1].x - path_polynomial_approximation[path_polynomial_approximation.size() - 2].x;
+
+    // Difference in y axis
+    int delta_Y_curve = path_polynomial_approximation[path_polynomial_approximation.size() - 1].y - path_polynomial_approximation[path_polynomial_approximation.size() - 2].y;
+
+    // Angle in degrees
+    double emily_angle_polynomial_approximation = atan2(delta_Y_curve, delta_x_curve) * (180 / M_PI);
+
+    // Compute heading point
+    heading_point.x = (int) round(path_polynomial_approximation[path_polynomial_approximation.size() - 1].x + heading_line_length * cos(emily_angle_polynomial_approximation * CV_PI / 180.0));
+    heading_point.y = (int) round(path_polynomial_approximation[path_polynomial_approximation.size() - 1].y + heading_line_length * sin(emily_angle_polynomial_approximation * CV_PI / 180.0));
+
+    return emily_angle_polynomial_approximation;
+}
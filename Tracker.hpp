@@ -0,0 +1,132 @@
+/*
+ * File:   Tracker.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef TRACKER_HPP
+#define TRACKER_HPP
+
+#include <atomic>
+#include <mutex>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+#include "BackProjection.hpp"
+#include "BoxBlur.hpp"
+
+using namespace std;
+using namespace cv;
+
+class Tracker {
+public:
+
+    Tracker(Settings&);
+    Tracker(const Tracker& orig);
+    virtual ~Tracker();
+
+    void preprocess(Mat&, Rect, Mat&, Mat&);
+
+    void preprocess_pyramid(Mat&, vector<Mat>&, Mat&, Mat&);
+
+    void preprocess_back_projection(Mat&, Rect, Mat&, Mat&);
+
+    Rect get_search_region(Size);
+
+    void select(Mat&, Rect, Mat&);
+
+    bool track(Mat&, Rect, RotatedRect&, Mat&);
+
+    bool track_back_projection(Mat&, Rect, RotatedRect&);
+
+    bool track_pyramid(vector<Mat>&, Mat&, const Mat&, Rect&, RotatedRect&, Mat&);
+
+    void print_preprocessing_statistics();
+
+    static void get_principal_axis(RotatedRect, Point&, Point&);
+
+    static double get_orientation(const Point *, int, int, double, vector<Point>&, Point&);
+
+    void equalize(Mat&, bool);
+
+private:
+
+    void filter(Mat&, Rect, int, Mat&, Mat&);
+
+    void blur(Mat&, Rect, int, Mat&, BoxBlur&);
+
+    void update_region_equalization_table(Mat&);
+
+    bool update_equalization_table(const int *, int);
+
+    void build_equalization_table(const int *, int);
+
+    static void apply_equalization_table(Mat&, const Mat&);
+
+    void threshold(Mat&, Mat&, Mat&);
+
+    // Program settings
+    Settings * settings;
+
+    // Rectangle representing object of interest
+    Rect object_of_interest;
+
+    // Size of histogram of object of interest
+    int histogram_size;
+
+    // Histogram ranges
+    float histogram_ranges[2];
+
+    // Histogram of object of interest
+    Mat histogram;
+
+    // Region around the last tracking box which will be searched in the next
+    // frames. Empty if the object is not tracked and the full frame has to be
+    // searched.
+    Rect search_region;
+
+    // Search region is read by the preprocessing and written by the tracking
+    mutex search_region_mutex;
+
+    // Value equalization look up table from the last full frame. Used only by
+    // the preprocessing. A new table is allocated on each rebuild, so copies
+    // handed to the tracking never change.
+    Mat equalization_table;
+
+    // Histogram of value the equalization table was built from
+    int equalization_histogram[256];
+    int equalization_histogram_total;
+
+    // Frames since the equalization table was built
+    int frames_since_equalization;
+
+    // Constant time blur for large kernels
+    BoxBlur box_blur;
+
+    // Blur of the pyramid refinement, which runs on the tracking thread
+    BoxBlur refine_box_blur;
+
+    // Fused back projection kernel
+    BackProjection back_projector;
+
+    // Back projection of each hue for the fused kernel. Created by the
+    // selection and read by the preprocessing.
+    Mat hue_back_projection_table;
+
+    // Guards the hue back projection table
+    mutex histogram_mutex;
+
+    // Search region statistics
+    atomic<long> preprocessed_frames;
+    atomic<long> full_frames;
+    atomic<long> preprocessed_pixels;
+    atomic<long> total_pixels;
+
+    // Equalization statistics
+    atomic<long> equalization_frames;
+    atomic<long> equalization_updates;
+    atomic<long> region_equalization_frames;
+    atomic<long> region_equalization_updates;
+
+};
+
+#endif /* TRACKER_HPP */
+
@@ -4,13 +4,31 @@
  */
 
 #include "Undistort.hpp"
+#include "Trace.hpp"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 Undistort::Undistort(Settings& s, Size sz) {
 
     settings = &s;
     video_size = sz;
 
-    initUndistortRectifyMap(settings->camera_intrinsic_matrix, settings->camera_distortion_vector, Mat(), getOptimalNewCameraMatrix(settings->camera_intrinsic_matrix, settings->camera_distortion_vector, video_size, 1, video_size, 0), video_size, CV_16SC2, undistortRectifyMap1, undistortRectifyMap2);
+    new_camera_matrix = getOptimalNewCameraMatrix(settings->camera_intrinsic_matrix, settings->camera_distortion_vector, video_size, 1, video_size, 0);
+
+    // The manual homography depends only on the camera, so it is computed once
+    manual_homography = get_manual_homography();
+
+    angle_homography_degrees = -1;
+    homography_from_angle = false;
+    ground_map_lens = false;
+
+    update_geometry();
 
 }
 
@@ -21,26 +39,21 @@ Undistort::~Undistort() {
 }
 
 /**
- * Undistort for camera distortion.
+ * Recompute homography from the ground plane (overhead view) to the image from
+ * the camera angle set in the GUI, if the angle changed since it was computed.
  * 
- * @param HSV_frame
- * @param original_frame
  */
-void Undistort::undistort_camera(Mat& HSV_frame, Mat& original_frame) {
-    remap(original_frame, original_frame, undistortRectifyMap1, undistortRectifyMap2, INTER_LINEAR);
-    remap(HSV_frame, HSV_frame, undistortRectifyMap1, undistortRectifyMap2, INTER_LINEAR);
+void Undistort::update_angle_homography() {
+
+    if (!angle_homography.empty() && angle_homography_degrees == settings->camera_angle_degrees) {
+        return;
+    }
+
+    angle_homography_degrees = settings->camera_angle_degrees;
 
     // Compute camera angle in radians
-    settings->camera_angle_radians = ((double) settings->camera_angle_degrees - 90.) * PI / 180;
-}
+    settings->camera_angle_radians = ((double) angle_homography_degrees - 90.) * PI / 180;
 
-/**
- * Undistort for perspective distortion.
- * 
- * @param HSV_frame
- * @param original_frame
- */
-void Undistort::undistort_perspective(Mat& HSV_frame, Mat& original_frame) {
     Mat camera_projection_matrix = (Mat_<double>(4, 3) <<
             1, 0, 0,
             0, 1, 0,
@@ -122,25 +135,16 @@ void Undistort::undistort_perspective(Mat& HSV_frame, Mat& original_frame) {
     invert(translate, translate);
 
     // Redefine overall camera transformation matrix with scale and translation
-    camera_transformation = (camera_intrinsic_matrix_3D * (camera_translation_matrix * (camera_rotation_matrix * (camera_projection_matrix * (scale * (translate))))));
-
-    // Apply inverse perspective warp using the camera transformation matrix
-    warpPerspective(original_frame, original_frame, camera_transformation, video_size, CV_INTER_LINEAR | CV_WARP_INVERSE_MAP | CV_WARP_FILL_OUTLIERS);
-    warpPerspective(HSV_frame, HSV_frame, camera_transformation, video_size, CV_INTER_LINEAR | CV_WARP_INVERSE_MAP | CV_WARP_FILL_OUTLIERS);
+    angle_homography = (camera_intrinsic_matrix_3D * (camera_translation_matrix * (camera_rotation_matrix * (camera_projection_matrix * (scale * (translate))))));
 }
 
 /**
- * Undistort for perspective distortion. Use manually set camera parameters and manual computation.
- * 
- * @param HSV_frame
- * @param original_frame
+ * Compute homography from the ground plane (overhead view) to the image from
+ * manually set camera parameters.
+ *
+ * @return homography
  */
-void Undistort::undistort_perspective_manual(Mat& HSV_frame, Mat& original_frame) {
-
-    // TODO turn off resize
-
-    //    // Manually load image for testing
-    //    original_frame = imread("frame.png", CV_LOAD_IMAGE_COLOR);
+Mat Undistort::get_manual_homography() {
 
     // Camera instrinsic matrix (sources:
     // https://www.dji.com/phantom-3-pro/info#specs and
@@ -148,8 +152,8 @@ void Undistort::undistort_perspective_manual(Mat& HSV_frame, Mat& original_frame
     double f = 3.61; // Focal length in milimeters
     double sensorWidth = 6.16;
     double sensorHeight = 4.62;
-    double w = original_frame.cols; // Image width in pixels
-    double h = original_frame.rows; // Image height in pixels
+    double w = video_size.width; // Image width in pixels
+    double h = video_size.height; // Image height in pixels
     double m_x = w / sensorWidth; // Number of pixels per unit distance in the X_i direction (px/mm)
     double m_y = h / sensorHeight; // Number of pixels per unit distance in the Y_i direction (px/mm)
     double alpha_x = f * m_x;
@@ -227,57 +231,384 @@ void Undistort::undistort_perspective_manual(Mat& HSV_frame, Mat& original_frame
     // then convert back by H_I.
     Mat H_B_I = H_I * P * H_B_W * H_I;
 
-    // Warp image
-    warpPerspective(original_frame, original_frame, H_B_I, video_size, CV_INTER_LINEAR | CV_WARP_INVERSE_MAP | CV_WARP_FILL_OUTLIERS);
-    warpPerspective(HSV_frame, HSV_frame, H_B_I, video_size, CV_INTER_LINEAR | CV_WARP_INVERSE_MAP | CV_WARP_FILL_OUTLIERS);
-
-    //    // This is manual application of transformation. It is much slower than OpenCV warpPerspective. The program becomes unresponsive. 
-    //    
-    //    // Initialize new image
-    //    Mat B(original_frame.rows, original_frame.cols, original_frame.type());
-    //    
-    //    Mat b;
-    //    Mat x;
-    //
-    //    // For each pixel of bird image {B}
-    //    for (int b_y = 0; b_y < h; b_y++) {
-    //        for (int b_x = 0; b_x < w; b_x++) {
-    //
-    //            // Point in {B}
-    //            b = (Mat_<double>(3, 1) <<
-    //                    b_x,
-    //                    b_y,
-    //                    1);
-    //
-    //            // Transform from {B} to {I}
-    //            x = H_B_I * b;
-    //            x = x / x.at<double>(2, 0);
-    //
-    //            // If the {I} is within the original image {I} boundaries
-    //            if (0 <= x.at<double>(0, 0) && x.at<double>(0, 0) <= w && 0 <= x.at<double>(1, 0) && x.at<double>(1, 0) <= h) {
-    //
-    //                // Assign the bird point in {B} the same RGB value as corresponding
-    //                // image point in {I}. 
-    //                B.at<Vec3b>(b_y, b_x) = original_frame.at<Vec3b>(x.at<double>(1, 0), x.at<double>(0, 0));
-    //
-    //            }
-    //
-    //        }
-    //    }
-    //
-    //    // Save new warped image into the original one
-    //    original_frame = B;
-
-    //        // Set value of particular pixel
-    //    original_frame.at<Vec3b>(2027, 1876)[1] = 255;
-    //    original_frame.at<Vec3b>(2027, 1876)[2] = 255;
-    //    original_frame.at<Vec3b>(2027, 1876)[3] = 255;
-
-    //        // Print type of original frame
-    //    cout << original_frame.type() << endl;
-
-    //    // Draw circle at the expected coordinates of EMILY in the first frame for 2016_05_10_lake_bryan.mov video and then directly above it at y = 0
-    //    circle(original_frame, Point(2027, 1876), 5, Scalar(255, 255, 255));
-    //    circle(original_frame, Point(2027, 0), 5, Scalar(255, 255, 255));
-
-}
\ No newline at end of file
+    return H_B_I;
+}
+
+/**
+ * Map point in the image to the ground plane (overhead view). The point goes
+ * through the lens model, if enabled, and the homography. No frame is warped.
+ *
+ * @param image_point
+ * @return ground point
+ */
+Point2f Undistort::image_to_ground(Point2f image_point) {
+    vector<Point2f> points(1, image_point);
+    image_to_ground(points, points);
+    return points[0];
+}
+
+/**
+ * Map point on the ground plane (overhead view) back to the image.
+ *
+ * @param ground_point
+ * @return image point
+ */
+Point2f Undistort::ground_to_image(Point2f ground_point) {
+    vector<Point2f> points(1, ground_point);
+    ground_to_image(points, points);
+    return points[0];
+}
+
+/**
+ * Map points in the image to the ground plane (overhead view).
+ *
+ * @param image_points
+ * @param ground_points
+ */
+void Undistort::image_to_ground(const vector<Point2f>& image_points, vector<Point2f>& ground_points) {
+
+    TraceScope trace_scope("Image to ground");
+
+    Mat current_inverse_homography;
+    {
+        lock_guard<mutex> lock(geometry_mutex);
+        update_geometry();
+        current_inverse_homography = inverse_homography;
+    }
+
+    vector<Point2f> undistorted_points = image_points;
+
+    // Lens distortion
+    if (settings->lens_undistortion) {
+        undistortPoints(image_points, undistorted_points, settings->camera_intrinsic_matrix, settings->camera_distortion_vector, noArray(), new_camera_matrix);
+    }
+
+    // Perspective
+    perspectiveTransform(undistorted_points, ground_points, current_inverse_homography);
+}
+
+/**
+ * Map points on the ground plane (overhead view) back to the image.
+ *
+ * @param ground_points
+ * @param image_points
+ */
+void Undistort::ground_to_image(const vector<Point2f>& ground_points, vector<Point2f>& image_points) {
+
+    TraceScope trace_scope("Ground to image");
+
+    Mat current_homography;
+    {
+        lock_guard<mutex> lock(geometry_mutex);
+        update_geometry();
+        current_homography = homography;
+    }
+
+    // Perspective
+    vector<Point2f> undistorted_points;
+    perspectiveTransform(ground_points, undistorted_points, current_homography);
+
+    if (!settings->lens_undistortion) {
+        image_points = undistorted_points;
+        return;
+    }
+
+    // Lens distortion. Undistorted pixels are turned to rays and projected
+    // through the lens model.
+    Mat new_camera_matrix_inverse = new_camera_matrix.inv();
+    vector<Point3f> rays;
+    for (int i = 0; i < undistorted_points.size(); i++) {
+        Mat ray = new_camera_matrix_inverse * (Mat_<double>(3, 1) << undistorted_points[i].x, undistorted_points[i].y, 1);
+        rays.push_back(Point3f(ray.at<double>(0, 0), ray.at<double>(1, 0), ray.at<double>(2, 0)));
+    }
+    projectPoints(rays, Mat::zeros(3, 1, CV_64F), Mat::zeros(3, 1, CV_64F), settings->camera_intrinsic_matrix, settings->camera_distortion_vector, image_points);
+}
+
+/**
+ * Warp the frame to the ground plane (overhead view). Only used for
+ * visualization, tracking and control map just the points. Lens undistortion
+ * and the homography are applied at once by a single remap.
+ *
+ * @param original_frame
+ * @param ground_frame
+ */
+void Undistort::warp_to_ground(const Mat& original_frame, Mat& ground_frame) {
+
+    TraceScope trace_scope("Warp to ground");
+
+    Mat map_1;
+    Mat map_2;
+    {
+        lock_guard<mutex> lock(geometry_mutex);
+        update_geometry();
+        build_ground_map();
+        map_1 = ground_map_1;
+        map_2 = ground_map_2;
+    }
+
+    striped_remap(original_frame, ground_frame, map_1, map_2);
+}
+
+/**
+ * Select the homography used for mapping to the ground plane. Invalidates the
+ * ground map if the homography changed. Called with the geometry mutex locked.
+ *
+ */
+void Undistort::update_geometry() {
+
+    bool from_angle = settings->angle_homography;
+
+    if (from_angle) {
+        update_angle_homography();
+    }
+
+    Mat& current_homography = from_angle ? angle_homography : manual_homography;
+
+    if (!homography.empty() && from_angle == homography_from_angle && homography.data == current_homography.data) {
+        return;
+    }
+
+    homography = current_homography;
+    invert(homography, inverse_homography);
+    homography_from_angle = from_angle;
+
+    // Ground map has to be rebuilt for the new homography
+    ground_map_1.release();
+    ground_map_2.release();
+}
+
+/**
+ * Build map from the ground plane (overhead view) to the original image, or
+ * load it from the cache. Each pixel goes through the homography and, if
+ * enabled, through the lens model, so the frame is warped by a single remap.
+ * The map is in fixed point format. Called with the geometry mutex locked.
+ *
+ */
+void Undistort::build_ground_map() {
+
+    bool lens = settings->lens_undistortion;
+
+    if (!ground_map_1.empty() && ground_map_lens == lens) {
+        return;
+    }
+
+    TraceScope trace_scope("Build ground map");
+
+    ground_map_lens = lens;
+
+    string cache_file = get_map_cache_file(lens ? "ground_lens" : "ground", homography);
+
+    if (load_map(cache_file, ground_map_1, ground_map_2)) {
+        return;
+    }
+
+    Mat_<double> H = homography;
+
+    // Undistorted image to normalized coordinates
+    double new_f_x = new_camera_matrix.at<double>(0, 0);
+    double new_f_y = new_camera_matrix.at<double>(1, 1);
+    double new_c_x = new_camera_matrix.at<double>(0, 2);
+    double new_c_y = new_camera_matrix.at<double>(1, 2);
+
+    // Normalized coordinates to the original image
+    double f_x = settings->camera_intrinsic_matrix.at<double>(0, 0);
+    double f_y = settings->camera_intrinsic_matrix.at<double>(1, 1);
+    double c_x = settings->camera_intrinsic_matrix.at<double>(0, 2);
+    double c_y = settings->camera_intrinsic_matrix.at<double>(1, 2);
+
+    // Distortion coefficients k1, k2, p1, p2, k3
+    double k[5] = {0, 0, 0, 0, 0};
+    Mat_<double> distortion = settings->camera_distortion_vector;
+    for (int i = 0; i < 5 && i < (int) distortion.total(); i++) {
+        k[i] = distortion(i);
+    }
+
+    Mat map(video_size, CV_32FC2);
+
+    for (int y = 0; y < video_size.height; y++) {
+
+        Vec2f * row = map.ptr<Vec2f>(y);
+
+        for (int x = 0; x < video_size.width; x++) {
+
+            // Perspective
+            double w = H(2, 0) * x + H(2, 1) * y + H(2, 2);
+            double u = (H(0, 0) * x + H(0, 1) * y + H(0, 2)) / w;
+            double v = (H(1, 0) * x + H(1, 1) * y + H(1, 2)) / w;
+
+            // Lens distortion, the same model as initUndistortRectifyMap uses
+            if (lens) {
+                double x_n = (u - new_c_x) / new_f_x;
+                double y_n = (v - new_c_y) / new_f_y;
+                double r2 = x_n * x_n + y_n * y_n;
+                double radial = 1 + k[0] * r2 + k[1] * r2 * r2 + k[4] * r2 * r2 * r2;
+                double x_d = x_n * radial + 2 * k[2] * x_n * y_n + k[3] * (r2 + 2 * x_n * x_n);
+                double y_d = y_n * radial + k[2] * (r2 + 2 * y_n * y_n) + 2 * k[3] * x_n * y_n;
+                u = f_x * x_d + c_x;
+                v = f_y * y_d + c_y;
+            }
+
+            row[x] = Vec2f((float) u, (float) v);
+        }
+    }
+
+    // Fixed point map is faster to apply
+    convertMaps(map, Mat(), ground_map_1, ground_map_2, CV_16SC2);
+
+    save_map(cache_file, ground_map_1, ground_map_2);
+}
+
+/**
+ * Get name of the cache file of a map. The name contains hash of the camera
+ * calibration, resolution and homography, so a changed calibration never
+ * loads an old map.
+ *
+ * @param name map name
+ * @param map_homography homography of the map, or empty
+ * @return file name
+ */
+string Undistort::get_map_cache_file(const string& name, const Mat& map_homography) {
+
+    // FNV-1a hash
+    uint64_t hash = 14695981039346656037ULL;
+
+    const Mat * matrices[] = {&settings->camera_intrinsic_matrix, &settings->camera_distortion_vector, &new_camera_matrix, &map_homography};
+    for (const Mat * matrix : matrices) {
+        Mat continuous = matrix->isContinuous() ? * matrix : matrix->clone();
+        const uchar * bytes = continuous.ptr();
+        size_t size = continuous.empty() ? 0 : continuous.total() * continuous.elemSize();
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+
+    ostringstream file;
+    file << settings->REMAP_CACHE_DIRECTORY << "/" << name << "_" << video_size.width << "x" << video_size.height << "_" << hex << hash << ".map";
+
+    return file.str();
+}
+
+/**
+ * Load fixed point map from the cache.
+ *
+ * @param file
+ * @param map_1 coordinates
+ * @param map_2 interpolation weights
+ * @return true if the map was loaded
+ */
+bool Undistort::load_map(const string& file, Mat& map_1, Mat& map_2) {
+
+    ifstream input(file.c_str(), ios::binary);
+    if (!input) {
+        return false;
+    }
+
+    int header[4];
+    input.read((char *) header, sizeof (header));
+    if (!input || header[0] != video_size.width || header[1] != video_size.height || header[2] != CV_16SC2 || header[3] != CV_16UC1) {
+        return false;
+    }
+
+    Mat loaded_map_1(video_size, CV_16SC2);
+    Mat loaded_map_2(video_size, CV_16UC1);
+    input.read((char *) loaded_map_1.ptr(), loaded_map_1.total() * loaded_map_1.elemSize());
+    input.read((char *) loaded_map_2.ptr(), loaded_map_2.total() * loaded_map_2.elemSize());
+    if (!input) {
+        return false;
+    }
+
+    map_1 = loaded_map_1;
+    map_2 = loaded_map_2;
+
+    return true;
+}
+
+/**
+ * Save fixed point map to the cache. The map is written to a unique temporary
+ * file which is renamed to the cache file only when complete, so another
+ * instance starting at the same time or a crash never leaves a partial map.
+ * Failure only means the map will be computed again at the next start.
+ *
+ * @param file
+ * @param map_1 coordinates
+ * @param map_2 interpolation weights
+ */
+void Undistort::save_map(const string& file, const Mat& map_1, const Mat& map_2) {
+
+    mkdir(settings->REMAP_CACHE_DIRECTORY.c_str(), 0755);
+
+    vector<char> temporary_name(file.begin(), file.end());
+    const char * suffix = ".XXXXXX";
+    temporary_name.insert(temporary_name.end(), suffix, suffix + strlen(suffix) + 1);
+
+    int file_descriptor = mkstemp(temporary_name.data());
+    if (file_descriptor < 0) {
+        cerr << "Cannot write map cache " << file << endl;
+        return;
+    }
+    ::close(file_descriptor);
+
+    string temporary_file_name(temporary_name.data());
+    ofstream output(temporary_file_name.c_str(), ios::binary | ios::trunc);
+
+    int header[4] = {video_size.width, video_size.height, map_1.type(), map_2.type()};
+    output.write((const char *) header, sizeof (header));
+    output.write((const char *) map_1.ptr(), map_1.total() * map_1.elemSize());
+    output.write((const char *) map_2.ptr(), map_2.total() * map_2.elemSize());
+    output.close();
+
+    if (!output.good() || rename(temporary_file_name.c_str(), file.c_str()) != 0) {
+        cerr << "Cannot write map cache " << file << endl;
+        remove(temporary_file_name.c_str());
+        return;
+    }
+
+    // Temporary files are created readable by the owner only
+    chmod(file.c_str(), 0644);
+}
+
+/**
+ * Remap stripes of rows.
+ */
+class StripedRemap : public ParallelLoopBody {
+public:
+
+    StripedRemap(const Mat& s, Mat& d, const Mat& m1, const Mat& m2, int n) : source(s), destination(d), map_1(m1), map_2(m2), stripes(n) {
+    }
+
+    virtual void operator()(const Range& range) const {
+        int first_row = destination.rows * range.start / stripes;
+        int last_row = destination.rows * range.end / stripes;
+        Mat destination_stripe = destination.rowRange(first_row, last_row);
+        remap(source, destination_stripe, map_1.rowRange(first_row, last_row), map_2.rowRange(first_row, last_row), INTER_LINEAR, BORDER_CONSTANT);
+    }
+
+private:
+
+    const Mat& source;
+    Mat& destination;
+    const Mat& map_1;
+    const Mat& map_2;
+    int stripes;
+
+};
+
+/**
+ * Remap the frame by fixed point maps with stripes of rows processed in
+ * parallel.
+ *
+ * @param source
+ * @param destination may be the same as source
+ * @param map_1 coordinates
+ * @param map_2 interpolation weights
+ */
+void Undistort::striped_remap(const Mat& source, Mat& destination, const Mat& map_1, const Mat& map_2) {
+
+    // Stripes read from anywhere in the source, so it cannot be overwritten
+    Mat input = source.data == destination.data ? source.clone() : source;
+
+    destination.create(map_1.size(), source.type());
+
+    int stripes = max(1, getNumThreads());
+    parallel_for_(Range(0, stripes), StripedRemap(input, destination, map_1, map_2, stripes));
+}
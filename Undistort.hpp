@@ -6,11 +6,13 @@
 #ifndef UNDISTORT_HPP
 #define UNDISTORT_HPP
 
+#include <mutex>
 #include "opencv2/opencv.hpp"
 #include "Settings.hpp"
 
 #define PI 3.14159265
 
+using namespace std;
 using namespace cv;
 
 class Undistort {
@@ -19,17 +21,56 @@ public:
     Undistort(const Undistort& orig);
     virtual ~Undistort();
     
-    void undistort_camera(Mat&, Mat&);
-    void undistort_perspective(Mat&, Mat&);
-    void undistort_perspective_manual(Mat&, Mat&);
+    Point2f image_to_ground(Point2f);
+    Point2f ground_to_image(Point2f);
+    void image_to_ground(const vector<Point2f>&, vector<Point2f>&);
+    void ground_to_image(const vector<Point2f>&, vector<Point2f>&);
+    
+    void warp_to_ground(const Mat&, Mat&);
     
 private:
     
+    Mat get_manual_homography();
+    void update_angle_homography();
+    void update_geometry();
+    
+    void build_ground_map();
+    
+    string get_map_cache_file(const string&, const Mat&);
+    bool load_map(const string&, Mat&, Mat&);
+    void save_map(const string&, const Mat&, const Mat&);
+    
+    static void striped_remap(const Mat&, Mat&, const Mat&, const Mat&);
+    
     Settings * settings;
     Size video_size;
     
-    Mat undistortRectifyMap1;
-    Mat undistortRectifyMap2;
+    // Camera matrix of the undistorted image
+    Mat new_camera_matrix;
+    
+    // Homography from the ground plane (overhead view) to the undistorted
+    // image from manually set camera parameters
+    Mat manual_homography;
+    
+    // Homography from the camera angle set in the GUI and the angle it was
+    // computed for
+    Mat angle_homography;
+    int angle_homography_degrees;
+    
+    // Homography used for mapping to the ground plane and its inverse
+    Mat homography;
+    Mat inverse_homography;
+    bool homography_from_angle;
+    
+    // Fixed point map from the ground plane to the original image combining
+    // the homography and the lens model. Built when first needed.
+    Mat ground_map_1;
+    Mat ground_map_2;
+    bool ground_map_lens;
+    
+    // Guards the homographies and maps, which are used by the control and
+    // render stages
+    mutex geometry_mutex;
 
 };
 
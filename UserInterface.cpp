@@ -4,6 +4,7 @@
  */
 
 #include "UserInterface.hpp"
+#include "Trace.hpp"
 
 #define CAMSHIFT
 
@@ -21,6 +22,13 @@ UserInterface::UserInterface(Settings& s, Size sz) {
 
     UserInterface::video_size = sz;
 
+#ifndef HEADLESS
+
+    // Headless mode has no windows, frames are only drawn into
+    if (settings->headless) {
+        return;
+    }
+
     // Show main window including slide bars
     create_main_window();
 
@@ -36,6 +44,8 @@ UserInterface::UserInterface(Settings& s, Size sz) {
 
     // Set main window to full screen
     setWindowProperty(settings->MAIN_WINDOW, CV_WND_PROP_FULLSCREEN, CV_WINDOW_FULLSCREEN);
+
+#endif
 }
 
 UserInterface::UserInterface(const UserInterface& orig) {
@@ -73,6 +83,8 @@ void UserInterface::on_trackbar(int, void*) {
  */
 void UserInterface::create_main_window() {
 
+#ifndef HEADLESS
+
     // Show new window
     namedWindow(UserInterface::settings->MAIN_WINDOW, CV_GUI_NORMAL);
 
@@ -99,6 +111,9 @@ void UserInterface::create_main_window() {
     // Gaussian blur trackbar
     createTrackbar("Blur", UserInterface::settings->MAIN_WINDOW, &UserInterface::settings->blur_kernel_size, min(UserInterface::video_size.height, UserInterface::video_size.width), on_trackbar);
 
+    // Blur engine trackbar
+    createTrackbar("Box blur", UserInterface::settings->MAIN_WINDOW, &UserInterface::settings->blur_engine, BLUR_BOX, on_trackbar);
+
     // Target reached radius trackbar
     createTrackbar("Radius", UserInterface::settings->MAIN_WINDOW, &UserInterface::settings->target_radius, min(UserInterface::video_size.height, UserInterface::video_size.width), on_trackbar);
 
@@ -118,6 +133,8 @@ void UserInterface::create_main_window() {
 
 #endif    
 
+#endif
+
 }
 
 /**
@@ -126,6 +143,9 @@ void UserInterface::create_main_window() {
  */
 void UserInterface::onMouse(int event, int x, int y, int flags, void*) {
 
+    // Selection and target are read by the processing threads
+    lock_guard<mutex> lock(operator_input_mutex);
+
     // Select object mode
     if (select_object) {
 
@@ -210,6 +230,8 @@ void UserInterface::onMouse(int event, int x, int y, int flags, void*) {
  */
 void UserInterface::draw_position(int x, int y, double radius, Mat &frame) {
 
+    TraceScope trace_scope("Draw position");
+
 #ifndef CAMSHIFT
 
     // Circle
@@ -247,45 +269,16 @@ void UserInterface::draw_position(int x, int y, double radius, Mat &frame) {
 }
 
 /**
- * Draws axis of given rotated rectangle. Axis is an principal axis of symmetry.
+ * Draws principal axis of symmetry of EMILY given by its end points.
  * 
- * @param rectangle rotated rectangle for which to draw principal axis
+ * @param shortest_axis_midpoint_1 first end point of the axis
+ * @param shortest_axis_midpoint_2 second end point of the axis
+ * @param frame frame to which draw into
  */
-void UserInterface::draw_principal_axis(RotatedRect rectangle, Mat& frame) {
-
-    // Get EMILY pose as the principal symmetry axis of bounding rectangle
-
-    // Get points of bounding rectangle
-    Point2f rectangle_points[4];
-    rectangle.points(rectangle_points);
-
-    // Initialize variables to look for the rectangle shortest side
-    double shortest_axis = DBL_MAX;
-    int shortest_axis_index;
-
-    // For each side
-    for (int j = 0; j < 4; j++) {
-
-        // Line length
-        double line_length = norm(rectangle_points[j] - rectangle_points[(j + 1) % 4]);
-
-        if (line_length < shortest_axis) {
-            shortest_axis = line_length;
-            shortest_axis_index = j;
-        }
-
-        // Draw line of the bounding rectangle
-        //line( frame, rectangle_points[j], rectangle_points[(j + 1) % 4], color, 1, 8 );
-    }
+void UserInterface::draw_principal_axis(Point shortest_axis_midpoint_1, Point shortest_axis_midpoint_2, Mat& frame) {
 
-    // Get midpoints of the shortest sides
-    Point shortest_axis_midpoint_1 = (rectangle_points[shortest_axis_index] + rectangle_points[(shortest_axis_index + 1) % 4]) * 0.5;
-    Point shortest_axis_midpoint_2 = (rectangle_points[(shortest_axis_index + 2) % 4] + rectangle_points[(shortest_axis_index + 3) % 4]) * 0.5;
+    TraceScope trace_scope("Draw principal axis");
 
-    // Save EMILY pose
-    emily_pose_point_1 = shortest_axis_midpoint_1;
-    emily_pose_point_2 = shortest_axis_midpoint_2;
-    
     // Draw line representing principal axis of symmetry
     line(frame, shortest_axis_midpoint_1, shortest_axis_midpoint_2, UserInterface::settings->POSE_LINE_COLOR, UserInterface::settings->POSE_LINE_THICKNESS, 8);
 
@@ -298,6 +291,9 @@ void UserInterface::draw_principal_axis(RotatedRect rectangle, Mat& frame) {
  * @param target_location
  */
 void UserInterface::draw_target(Mat& frame, Point target_location) {
+
+    TraceScope trace_scope("Draw target");
+
     if (target_location.x != 0 && target_location.y != 0) {
         circle(frame, target_location, settings->TARGET_RADIUS - 1, settings->TARGET_COLOR, 1, 8, 0);
         line(frame, Point(target_location.x - (settings->TARGET_RADIUS / 2), target_location.y + (settings->TARGET_RADIUS / 2)), Point(target_location.x + (settings->TARGET_RADIUS / 2), target_location.y - (settings->TARGET_RADIUS / 2)), settings->TARGET_COLOR, 1, 8, 0);
@@ -317,6 +313,8 @@ void UserInterface::draw_target(Mat& frame, Point target_location) {
  */
 void UserInterface::print_status(Mat& frame, int status, double time_to_target) {
 
+    TraceScope trace_scope("Print status");
+
     String stringStatus;
 
     switch (status) {
@@ -365,7 +363,14 @@ string UserInterface::int_to_string(int number) {
  * @param mat
  */
 void UserInterface::show_main(Mat& mat) {
-    imshow(UserInterface::settings->MAIN_WINDOW, mat);
+
+    TraceScope trace_scope("Show main");
+
+#ifndef HEADLESS
+    if (!UserInterface::settings->headless) {
+        imshow(UserInterface::settings->MAIN_WINDOW, mat);
+    }
+#endif
 }
 
 /**
@@ -374,5 +379,28 @@ void UserInterface::show_main(Mat& mat) {
  * @param mat
  */
 void UserInterface::show_histogram(Mat& mat) {
-    imshow(UserInterface::settings->HISTOGRAM_WINDOW, mat);
+
+    TraceScope trace_scope("Show histogram");
+
+#ifndef HEADLESS
+    if (!UserInterface::settings->headless) {
+        imshow(UserInterface::settings->HISTOGRAM_WINDOW, mat);
+    }
+#endif
+}
+
+/**
+ * Show overhead view window.
+ *
+ * @param mat
+ */
+void UserInterface::show_overhead(Mat& mat) {
+
+    TraceScope trace_scope("Show overhead");
+
+#ifndef HEADLESS
+    if (!UserInterface::settings->headless) {
+        imshow(UserInterface::settings->OVERHEAD_WINDOW, mat);
+    }
+#endif
 }
\ No newline at end of file
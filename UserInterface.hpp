@@ -6,6 +6,8 @@
 #ifndef USERINTERFACE_HPP
 #define USERINTERFACE_HPP
 
+#include <atomic>
+#include <mutex>
 #include "opencv2/opencv.hpp"
 #include "Settings.hpp"
 
@@ -13,12 +15,11 @@ using namespace std;
 using namespace cv;
 
 extern bool select_object;
-extern int object_selected;
+extern atomic<int> object_selected;
 extern Rect selection;
 extern Point target_location;
-extern bool target_reached;
-extern Point emily_pose_point_1;
-extern Point emily_pose_point_2;
+extern atomic<bool> target_reached;
+extern mutex operator_input_mutex;
 
 class UserInterface {
 public:
@@ -29,7 +30,7 @@ public:
     
     void draw_position(int, int, double, Mat&);
     
-    void draw_principal_axis(RotatedRect, Mat&);
+    void draw_principal_axis(Point, Point, Mat&);
     
     void draw_target(Mat&, Point);
     
@@ -41,6 +42,8 @@ public:
     
     void show_histogram(Mat&);
     
+    void show_overhead(Mat&);
+    
 private:
     
     void create_main_window();
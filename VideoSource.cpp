@@ -0,0 +1,54 @@
+/*
+ * File:   VideoSource.cpp
+ * Author: Jan Dufek
+ */
+
+#include "VideoSource.hpp"
+
+VideoSource::VideoSource() {
+}
+
+VideoSource::VideoSource(const VideoSource& orig) {
+}
+
+VideoSource::~VideoSource() {
+}
+
+/**
+ * Open the video input. Source consisting of digits only is a camera index.
+ *
+ * @param source video file, stream URL or camera index
+ * @return true if the video input was opened
+ */
+bool VideoSource::open(string source) {
+
+    if (!source.empty() && source.find_first_not_of("0123456789") == string::npos) {
+        return video_capture.open(atoi(source.c_str()));
+    }
+
+    return video_capture.open(source);
+}
+
+bool VideoSource::read(Mat& frame) {
+
+    video_capture >> frame;
+
+    return !frame.empty();
+}
+
+double VideoSource::get_fps() {
+    return video_capture.get(CV_CAP_PROP_FPS);
+}
+
+Size VideoSource::get_size() {
+    return Size(video_capture.get(CV_CAP_PROP_FRAME_WIDTH), video_capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+}
+
+/**
+ * Video files have known number of frames, live streams do not.
+ *
+ * @return
+ */
+bool VideoSource::is_live() {
+    return video_capture.get(CV_CAP_PROP_FRAME_COUNT) <= 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * File:   VideoSource.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef VIDEOSOURCE_HPP
+#define VIDEOSOURCE_HPP
+
+#include "FrameSource.hpp"
+
+/**
+ * Frames from a video file, a stream URL or a camera.
+ */
+class VideoSource : public FrameSource {
+public:
+    VideoSource();
+    VideoSource(const VideoSource& orig);
+    virtual ~VideoSource();
+
+    bool open(string);
+
+    bool read(Mat&);
+
+    double get_fps();
+
+    Size get_size();
+
+    bool is_live();
+
+private:
+
+    VideoCapture video_capture;
+
+};
+
+#endif /* VIDEOSOURCE_HPP */
+
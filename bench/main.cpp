@@ -0,0 +1,737 @@
+/**
+ * @file    main.cpp
+ * @author  Jan Dufek
+ *
+ * Benchmark of the tracking algorithm on synthetic frames. A red object moves
+ * on a noisy background and is tracked with CamShift in the full frame, in the
+ * search region and coarse to fine over an image pyramid. Prints time per frame
+ * of preprocessing and tracking for each mode and resolution.
+ *
+ * Then compares the fused back projection kernel with the chain of OpenCV
+ * calls it replaces for each instruction set. Prints time per frame and the
+ * number of pixels in which the results differ, which has to be 0.
+ *
+ * Then compares the stacked box blur with GaussianBlur for growing kernel
+ * sizes. Prints time per frame of both and the mean and maximal absolute
+ * difference of the results.
+ *
+ * Then tracks the object in frames with changing brightness with the exact
+ * equalization rebuilt every frame and with the subsampled cached one. Prints
+ * preprocessing time per frame and the distance of the tracked centers from
+ * the exact ones.
+ *
+ * Finally times each vision kernel of the pipeline on its own at 720p, 1080p
+ * and 4K. Prints time per call, ns/pixel and frames/s.
+ *
+ * Usage: emily_bench [--kernels] [--json FILE]
+ *
+ *   --kernels    run only the kernel benchmarks
+ *   --json FILE  write the kernel results to FILE, to be compared between
+ *                versions
+ *
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <atomic>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+#include "Tracker.hpp"
+#include "BackProjection.hpp"
+#include "BoxBlur.hpp"
+#include "Control.hpp"
+#include "Command.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Number of frames tracked in each run
+#define BENCHMARK_FRAMES 200
+
+// Minimal time each kernel is repeated for in seconds
+#define KERNEL_TIME 0.5
+
+// Control sets it when the target is reached
+atomic<bool> target_reached(false);
+
+// Tracking mode
+struct Mode {
+    string name;
+    bool search_region_enabled;
+    int pyramid_levels;
+};
+
+// Time of one kernel
+struct KernelResult {
+    string kernel;
+    string parameters;
+    Size frame_size;
+
+    // Time per call in milliseconds
+    double time;
+
+    // Pixels processed per call, 0 if the kernel does not work on pixels
+    long pixels;
+};
+
+// Results of all kernel benchmarks
+vector<KernelResult> kernel_results;
+
+/**
+ * Create synthetic frame with the object at the given time.
+ *
+ * @param background
+ * @param frame_index
+ * @param frame
+ * @param object_box bounding box of the object
+ */
+void create_frame(Mat& background, int frame_index, Mat& frame, Rect& object_box) {
+
+    background.copyTo(frame);
+
+    // Object moves on a circle around the frame center
+    double angle = frame_index * 0.02;
+    Point center(frame.cols / 2 + (int) (frame.cols / 4 * cos(angle)), frame.rows / 2 + (int) (frame.rows / 4 * sin(angle)));
+    Size axes(frame.rows / 30, frame.rows / 60);
+
+    ellipse(frame, center, axes, angle * 180 / CV_PI, 0, 360, Scalar(0, 0, 255), -1);
+
+    object_box = Rect(center.x - axes.width, center.y - axes.width, 2 * axes.width, 2 * axes.width);
+}
+
+/**
+ * Track the object in synthetic frames of the given size.
+ *
+ * @param frame_size
+ * @param mode
+ * @param lost number of frames in which the object was not found
+ * @return time per frame in milliseconds
+ */
+double run(Size frame_size, Mode mode, int& lost) {
+
+    Settings settings;
+    settings.search_region_enabled = mode.search_region_enabled;
+    settings.pyramid_levels = mode.pyramid_levels;
+
+    Tracker tracker(settings);
+
+    // Noisy background with low saturation
+    Mat background(frame_size, CV_8UC3);
+    randu(background, Scalar(90, 90, 90), Scalar(140, 140, 140));
+
+    Mat frame;
+    Rect object_box;
+    Mat blured_frame;
+    Mat HSV_frame;
+    Mat histogram_image;
+    Rect full_frame(0, 0, frame_size.width, frame_size.height);
+
+    // Select the object in the first frame
+    create_frame(background, 0, frame, object_box);
+    tracker.preprocess(frame, full_frame, blured_frame, HSV_frame);
+    tracker.select(HSV_frame, object_box & full_frame, histogram_image);
+
+    lost = 0;
+    double processing_time = 0;
+
+    for (int i = 1; i <= BENCHMARK_FRAMES; i++) {
+
+        create_frame(background, i, frame, object_box);
+
+        int64 start = getTickCount();
+
+        RotatedRect tracking_box;
+        Mat back_projection;
+        bool found;
+
+        if (mode.pyramid_levels > 0) {
+            vector<Mat> pyramid;
+            Rect refine_region;
+            Mat equalization_table;
+            tracker.preprocess_pyramid(frame, pyramid, HSV_frame, equalization_table);
+            found = tracker.track_pyramid(pyramid, HSV_frame, equalization_table, refine_region, tracking_box, back_projection);
+        } else {
+            Rect search_region = tracker.get_search_region(frame_size);
+            if (settings.fused_back_projection) {
+                tracker.preprocess_back_projection(frame, search_region, blured_frame, back_projection);
+                found = tracker.track_back_projection(back_projection, search_region, tracking_box);
+            } else {
+                tracker.preprocess(frame, search_region, blured_frame, HSV_frame);
+                found = tracker.track(HSV_frame, search_region, tracking_box, back_projection);
+            }
+        }
+
+        processing_time += (getTickCount() - start) / getTickFrequency();
+
+        if (!found || !object_box.contains(Point(tracking_box.center))) {
+            lost++;
+        }
+    }
+
+    return processing_time * 1000 / BENCHMARK_FRAMES;
+}
+
+/**
+ * Back projection computed by the chain of OpenCV calls the fused kernel
+ * replaces.
+ *
+ * @param BGR_frame
+ * @param histogram hue histogram
+ * @param histogram_ranges
+ * @param equalization_table
+ * @param settings thresholds
+ * @param back_projection
+ */
+void back_project_chain(Mat& BGR_frame, Mat& histogram, const float * histogram_ranges, Mat& equalization_table, Settings& settings, Mat& back_projection) {
+
+    Mat HSV_frame;
+    cvtColor(BGR_frame, HSV_frame, COLOR_BGR2HSV);
+
+    vector<Mat> HSV_planes;
+    split(HSV_frame, HSV_planes);
+    LUT(HSV_planes[2], equalization_table, HSV_planes[2]);
+    merge(HSV_planes, HSV_frame);
+
+    Mat saturation_value_threshold;
+    inRange(HSV_frame, Scalar(0, settings.saturation_min, settings.value_min), Scalar(180, settings.saturation_max, settings.value_max), saturation_value_threshold);
+
+    Mat hue(HSV_frame.size(), CV_8U);
+    int chanels[] = {0, 0};
+    mixChannels(&HSV_frame, 1, &hue, 1, chanels, 1);
+
+    calcBackProject(&hue, 1, 0, histogram, back_projection, &histogram_ranges);
+
+    back_projection &= saturation_value_threshold;
+}
+
+/**
+ * Compare the fused back projection kernel with the chain of OpenCV calls.
+ *
+ * @param frame_size
+ */
+void benchmark_back_projection(Size frame_size) {
+
+    Settings settings;
+
+    // Blured frame with the object in it
+    Mat background(frame_size, CV_8UC3);
+    randu(background, Scalar(90, 90, 90), Scalar(140, 140, 140));
+    Mat frame;
+    Rect object_box;
+    create_frame(background, 0, frame, object_box);
+    GaussianBlur(frame, frame, Size(settings.blur_kernel_size | 1, settings.blur_kernel_size | 1), 0, 0);
+
+    // Any monotonic equalization
+    Mat equalization_table(1, 256, CV_8U);
+    for (int i = 0; i < 256; i++) {
+        equalization_table.at<uchar>(i) = saturate_cast<uchar> (i * 1.3 - 20);
+    }
+
+    // Histogram of the object the same way as the tracker creates it
+    Mat HSV_frame;
+    cvtColor(frame, HSV_frame, COLOR_BGR2HSV);
+    Mat hue(HSV_frame.size(), CV_8U);
+    int chanels[] = {0, 0};
+    mixChannels(&HSV_frame, 1, &hue, 1, chanels, 1);
+    Mat region_of_interest(hue, object_box & Rect(0, 0, frame_size.width, frame_size.height));
+    Mat histogram;
+    int histogram_size = 16;
+    float histogram_ranges[] = {0, 180};
+    const float * pointer_histogram_ranges = histogram_ranges;
+    calcHist(&region_of_interest, 1, 0, Mat(), histogram, 1, &histogram_size, &pointer_histogram_ranges);
+    normalize(histogram, histogram, 0, 255, NORM_MINMAX);
+
+    Mat hue_table = BackProjection::create_hue_table(histogram, histogram_ranges);
+
+    // Random frame covers all colors for the comparison
+    Mat random_frame(frame_size, CV_8UC3);
+    randu(random_frame, Scalar::all(0), Scalar::all(256));
+
+    string resolution = to_string(frame_size.width) + "x" + to_string(frame_size.height);
+
+    Mat chain_back_projection;
+    int64 start = getTickCount();
+    for (int i = 0; i < BENCHMARK_FRAMES; i++) {
+        back_project_chain(frame, histogram, histogram_ranges, equalization_table, settings, chain_back_projection);
+    }
+    double chain_time = (getTickCount() - start) / getTickFrequency() * 1000 / BENCHMARK_FRAMES;
+
+    cout << setw(12) << resolution << setw(16) << "chain" << setw(12) << fixed << setprecision(2) << chain_time << setw(12) << "" << setw(10) << "" << endl;
+
+    Mat random_chain_back_projection;
+    back_project_chain(random_frame, histogram, histogram_ranges, equalization_table, settings, random_chain_back_projection);
+
+    BackProjection back_projector;
+    int best_instruction_set = back_projector.get_instruction_set();
+
+    for (int instruction_set = BACK_PROJECTION_SCALAR; instruction_set <= best_instruction_set; instruction_set++) {
+
+        back_projector.set_instruction_set(instruction_set);
+
+        Mat back_projection;
+        start = getTickCount();
+        for (int i = 0; i < BENCHMARK_FRAMES; i++) {
+            back_projector.compute(frame, hue_table, equalization_table, settings.saturation_min, settings.saturation_max, settings.value_min, settings.value_max, back_projection);
+        }
+        double fused_time = (getTickCount() - start) / getTickFrequency() * 1000 / BENCHMARK_FRAMES;
+
+        // Differences from the chain
+        int differences = countNonZero(back_projection != chain_back_projection);
+        back_projector.compute(random_frame, hue_table, equalization_table, settings.saturation_min, settings.saturation_max, settings.value_min, settings.value_max, back_projection);
+        differences += countNonZero(back_projection != random_chain_back_projection);
+
+        cout << setw(12) << resolution << setw(16) << ("fused " + BackProjection::get_instruction_set_name(instruction_set)) << setw(12) << fixed << setprecision(2) << fused_time << setw(11) << chain_time / fused_time << "x" << setw(10) << differences << endl;
+    }
+}
+
+/**
+ * Compare the stacked box blur with GaussianBlur.
+ *
+ * @param frame_size
+ * @param kernel_size
+ */
+void benchmark_blur(Size frame_size, int kernel_size) {
+
+    Mat background(frame_size, CV_8UC3);
+    randu(background, Scalar(90, 90, 90), Scalar(140, 140, 140));
+    Mat frame;
+    Rect object_box;
+    create_frame(background, 0, frame, object_box);
+    Rect full_frame(0, 0, frame_size.width, frame_size.height);
+
+    // Fewer frames for the slow large Gaussian kernels
+    int frames = max(5, BENCHMARK_FRAMES / (1 + kernel_size / 20));
+
+    Mat gaussian_blured;
+    int64 start = getTickCount();
+    for (int i = 0; i < frames; i++) {
+        GaussianBlur(frame, gaussian_blured, Size(kernel_size, kernel_size), 0, 0);
+    }
+    double gaussian_time = (getTickCount() - start) / getTickFrequency() * 1000 / frames;
+
+    BoxBlur box_blur;
+    Mat box_blured;
+    start = getTickCount();
+    for (int i = 0; i < frames; i++) {
+        box_blur.apply(frame, full_frame, box_blured, kernel_size);
+    }
+    double box_time = (getTickCount() - start) / getTickFrequency() * 1000 / frames;
+
+    Mat difference;
+    absdiff(gaussian_blured, box_blured, difference);
+    Scalar mean_difference = mean(difference);
+    double max_difference;
+    minMaxLoc(difference.reshape(1), 0, &max_difference);
+
+    cout << setw(12) << (to_string(frame_size.width) + "x" + to_string(frame_size.height)) << setw(8) << kernel_size << setw(12) << fixed << setprecision(2) << gaussian_time << setw(12) << box_time << setw(11) << gaussian_time / box_time << "x" << setw(12) << (mean_difference[0] + mean_difference[1] + mean_difference[2]) / 3 << setw(8) << (int) max_difference << endl;
+}
+
+/**
+ * Track the object in full frames with changing brightness.
+ *
+ * @param frame_size
+ * @param sample_step equalization sampling step
+ * @param interval equalization interval
+ * @param centers tracked centers
+ * @return preprocessing time per frame in milliseconds
+ */
+double run_equalization(Size frame_size, int sample_step, int interval, vector<Point2f>& centers) {
+
+    Settings settings;
+    settings.search_region_enabled = false;
+    settings.fused_back_projection = false;
+    settings.equalization_sample_step = sample_step;
+    settings.equalization_interval = interval;
+
+    Tracker tracker(settings);
+
+    Mat background(frame_size, CV_8UC3);
+    randu(background, Scalar(90, 90, 90), Scalar(140, 140, 140));
+
+    Mat frame;
+    Rect object_box;
+    Mat blured_frame;
+    Mat HSV_frame;
+    Mat histogram_image;
+    Rect full_frame(0, 0, frame_size.width, frame_size.height);
+
+    create_frame(background, 0, frame, object_box);
+    tracker.preprocess(frame, full_frame, blured_frame, HSV_frame);
+    tracker.select(HSV_frame, object_box & full_frame, histogram_image);
+
+    centers.clear();
+    double preprocessing_time = 0;
+
+    for (int i = 1; i <= BENCHMARK_FRAMES; i++) {
+
+        // Slowly changing brightness, like clouds over the water
+        create_frame(background, i, frame, object_box);
+        frame.convertTo(frame, -1, 0.8 + 0.2 * sin(i * 0.05));
+
+        int64 start = getTickCount();
+        tracker.preprocess(frame, full_frame, blured_frame, HSV_frame);
+        preprocessing_time += (getTickCount() - start) / getTickFrequency();
+
+        RotatedRect tracking_box;
+        Mat back_projection;
+        tracker.track(HSV_frame, full_frame, tracking_box, back_projection);
+        centers.push_back(tracking_box.center);
+    }
+
+    return preprocessing_time * 1000 / BENCHMARK_FRAMES;
+}
+
+/**
+ * Compare the subsampled cached equalization with the exact one.
+ *
+ * @param frame_size
+ */
+void benchmark_equalization(Size frame_size) {
+
+    vector<Point2f> exact_centers;
+    double exact_time = run_equalization(frame_size, 1, 1, exact_centers);
+
+    Settings settings;
+    vector<Point2f> centers;
+    double time = run_equalization(frame_size, settings.equalization_sample_step, settings.equalization_interval, centers);
+
+    double mean_error = 0;
+    double max_error = 0;
+    for (int i = 0; i < centers.size(); i++) {
+        double error = norm(centers[i] - exact_centers[i]);
+        mean_error += error / centers.size();
+        max_error = max(max_error, error);
+    }
+
+    cout << setw(12) << (to_string(frame_size.width) + "x" + to_string(frame_size.height)) << setw(12) << fixed << setprecision(2) << exact_time << setw(12) << time << setw(11) << exact_time / time << "x" << setw(12) << mean_error << setw(12) << max_error << endl;
+}
+
+/**
+ * Time a kernel. It is called once to warm up, then repeatedly for at least
+ * KERNEL_TIME seconds and at least 3 times.
+ *
+ * @param kernel
+ * @param max_calls stop after this many calls even before KERNEL_TIME
+ * @return time per call in milliseconds
+ */
+double time_kernel(function<void()> kernel, int max_calls) {
+
+    kernel();
+
+    int calls = 0;
+    double elapsed = 0;
+    int64 start = getTickCount();
+
+    while (calls < 3 || (elapsed < KERNEL_TIME && calls < max_calls)) {
+        kernel();
+        calls++;
+        elapsed = (getTickCount() - start) / getTickFrequency();
+    }
+
+    return elapsed * 1000 / calls;
+}
+
+/**
+ * Print and save time of one kernel.
+ *
+ * @param frame_size
+ * @param kernel
+ * @param parameters
+ * @param time time per call in milliseconds
+ * @param pixels pixels processed per call, 0 if not applicable
+ */
+void report_kernel(Size frame_size, string kernel, string parameters, double time, long pixels) {
+
+    cout << setw(12) << (to_string(frame_size.width) + "x" + to_string(frame_size.height)) << setw(16) << kernel << setw(14) << parameters << setw(12) << fixed << setprecision(3) << time;
+
+    if (pixels > 0) {
+        cout << setw(12) << setprecision(2) << time * 1e6 / pixels;
+    } else {
+        cout << setw(12) << "-";
+    }
+
+    cout << setw(12) << setprecision(1) << 1000 / time << endl;
+
+    kernel_results.push_back({kernel, parameters, frame_size, time, pixels});
+}
+
+/**
+ * Time each vision kernel of the pipeline on a synthetic frame.
+ *
+ * @param frame_size
+ */
+void benchmark_kernels(Size frame_size) {
+
+    Settings settings;
+    settings.search_region_enabled = false;
+    settings.pyramid_levels = 0;
+    settings.fused_back_projection = false;
+
+    long pixels = (long) frame_size.width * frame_size.height;
+    Rect full_frame(0, 0, frame_size.width, frame_size.height);
+
+    Mat background(frame_size, CV_8UC3);
+    randu(background, Scalar(90, 90, 90), Scalar(140, 140, 140));
+    Mat frame;
+    Rect object_box;
+    create_frame(background, 0, frame, object_box);
+
+    // Blur with kernel sizes along the trackbar range
+    Mat blured_frame;
+    int kernel_sizes[] = {5, 21, 61, 151};
+    for (int kernel_size : kernel_sizes) {
+        double time = time_kernel([&]() {
+            GaussianBlur(frame, blured_frame, Size(kernel_size, kernel_size), 0, 0);
+        }, BENCHMARK_FRAMES);
+        report_kernel(frame_size, "GaussianBlur", "kernel " + to_string(kernel_size), time, pixels);
+    }
+
+    GaussianBlur(frame, blured_frame, Size(settings.blur_kernel_size, settings.blur_kernel_size), 0, 0);
+
+    // Color conversion
+    Mat HSV_frame;
+    double time = time_kernel([&]() {
+        cvtColor(blured_frame, HSV_frame, COLOR_BGR2HSV);
+    }, BENCHMARK_FRAMES);
+    report_kernel(frame_size, "cvtColor", "BGR2HSV", time, pixels);
+
+    // Equalization of value with the cached table and the exact one
+    Tracker tracker(settings);
+    Mat equalized_frame = HSV_frame.clone();
+    time = time_kernel([&]() {
+        tracker.equalize(equalized_frame, true);
+    }, BENCHMARK_FRAMES);
+    report_kernel(frame_size, "equalize", "cached", time, pixels);
+
+    time = time_kernel([&]() {
+        vector<Mat> HSV_planes;
+        split(HSV_frame, HSV_planes);
+        equalizeHist(HSV_planes[2], HSV_planes[2]);
+        merge(HSV_planes, equalized_frame);
+    }, BENCHMARK_FRAMES);
+    report_kernel(frame_size, "equalize", "exact", time, pixels);
+
+    // Back projection and CamShift in the full frame
+    Mat histogram_image;
+    tracker.preprocess(frame, full_frame, blured_frame, HSV_frame);
+    tracker.select(HSV_frame, object_box & full_frame, histogram_image);
+
+    time = time_kernel([&]() {
+        RotatedRect tracking_box;
+        Mat back_projection;
+        tracker.track(HSV_frame, full_frame, tracking_box, back_projection);
+    }, BENCHMARK_FRAMES);
+    report_kernel(frame_size, "CamShift", "full frame", time, pixels);
+
+    // Threshold, erode, dilate and contours the same way as the tracker does
+    // it without CamShift
+    time = time_kernel([&]() {
+
+        Mat lower_red_threshold;
+        inRange(HSV_frame, Scalar(settings.hue_1_min, settings.saturation_min, settings.value_min), Scalar(settings.hue_1_max, settings.saturation_max, settings.value_max), lower_red_threshold);
+
+        Mat upper_red_threshold;
+        inRange(HSV_frame, Scalar(settings.hue_2_min, settings.saturation_min, settings.value_min), Scalar(settings.hue_2_max, settings.saturation_max, settings.value_max), upper_red_threshold);
+
+        Mat threshold;
+        addWeighted(lower_red_threshold, 1.0, upper_red_threshold, 1.0, 0.0, threshold);
+
+        Mat eroded_dilated_threshold;
+        Mat erode_element = getStructuringElement(MORPH_RECT, Size(settings.erode_size, settings.erode_size));
+        erode(threshold, eroded_dilated_threshold, erode_element);
+        erode(eroded_dilated_threshold, eroded_dilated_threshold, erode_element);
+
+        Mat dilate_element = getStructuringElement(MORPH_RECT, Size(settings.dilate_size, settings.dilate_size));
+        dilate(eroded_dilated_threshold, eroded_dilated_threshold, dilate_element);
+        dilate(eroded_dilated_threshold, eroded_dilated_threshold, dilate_element);
+
+        vector<vector<Point> > contours;
+        vector<Vec4i> hierarchy;
+        findContours(eroded_dilated_threshold, contours, hierarchy, CV_RETR_CCOMP, CV_CHAIN_APPROX_SIMPLE);
+
+        // Largest blob within the area limits
+        double max_area = 0;
+        for (int i = 0; i >= 0 && hierarchy.size() > 0; i = hierarchy[i][0]) {
+            double area = moments((Mat) contours[i]).m00;
+            if (area > settings.MIN_BLOB_AREA && area < settings.MAX_BLOB_AREA && area > max_area) {
+                max_area = area;
+            }
+        }
+    }, BENCHMARK_FRAMES);
+    report_kernel(frame_size, "contours", "threshold", time, pixels);
+
+    // Orientation from the location history. Independent of the frame size,
+    // so measured only once.
+    if (frame_size.height == 720) {
+
+        vector<Point> location_history;
+        for (int i = 0; i < settings.EMILY_LOCATION_HISTORY_SIZE; i++) {
+            location_history.push_back(Point(100 + 4 * i, 100 + (int) (20 * sin(i * 0.1))));
+        }
+
+        double emily_angle = 0;
+        time = time_kernel([&]() {
+            vector<Point> path_polynomial_approximation;
+            Point heading_point;
+            emily_angle = Tracker::get_orientation(location_history.data(), location_history.size(), 0, settings.HEADING_LINE_LENGTH, path_polynomial_approximation, heading_point);
+        }, 1000000);
+        report_kernel(frame_size, "orientation", "history " + to_string(settings.EMILY_LOCATION_HISTORY_SIZE), time, 0);
+
+        // Control commands for a distant target
+        Control control(settings);
+        time = time_kernel([&]() {
+            Command * command = control.get_control_commands(100, 100, emily_angle, 1000, 600);
+            delete command;
+        }, 1000000);
+        report_kernel(frame_size, "control", "commands", time, 0);
+    }
+}
+
+/**
+ * Write the kernel results as JSON.
+ *
+ * @param file_name
+ * @return false if the file cannot be written
+ */
+bool write_json(string file_name) {
+
+    ofstream file(file_name);
+
+    if (!file.is_open()) {
+        cerr << "Cannot open the results file " << file_name << " for write." << endl;
+        return false;
+    }
+
+    BackProjection back_projector;
+
+    file << "{" << endl;
+    file << "  \"opencv\": \"" << CV_VERSION << "\"," << endl;
+    file << "  \"threads\": " << getNumThreads() << "," << endl;
+    file << "  \"instruction_set\": \"" << BackProjection::get_instruction_set_name(back_projector.get_instruction_set()) << "\"," << endl;
+    file << "  \"results\": [" << endl;
+
+    for (int i = 0; i < kernel_results.size(); i++) {
+
+        KernelResult& result = kernel_results[i];
+
+        file << "    {\"kernel\": \"" << result.kernel << "\", \"parameters\": \"" << result.parameters << "\", \"width\": " << result.frame_size.width << ", \"height\": " << result.frame_size.height;
+        file << fixed << setprecision(6) << ", \"ms\": " << result.time << ", \"ns_per_pixel\": ";
+
+        if (result.pixels > 0) {
+            file << result.time * 1e6 / result.pixels;
+        } else {
+            file << "null";
+        }
+
+        file << ", \"fps\": " << 1000 / result.time << "}" << (i + 1 < kernel_results.size() ? "," : "") << endl;
+    }
+
+    file << "  ]" << endl;
+    file << "}" << endl;
+
+    return file.good();
+}
+
+/**
+ * Compare the tracking modes, back projection, blur and equalization.
+ *
+ * @param frame_sizes
+ */
+void benchmark_tracking(vector<Size>& frame_sizes) {
+
+    vector<Mode> modes;
+    modes.push_back({"full frame", false, 0});
+    modes.push_back({"search region", true, 0});
+    modes.push_back({"pyramid 1", false, 1});
+    modes.push_back({"pyramid 2", false, 2});
+
+    cout << setw(12) << "resolution" << setw(16) << "mode" << setw(12) << "ms/frame" << setw(12) << "speedup" << setw(8) << "lost" << endl;
+
+    for (int i = 0; i < frame_sizes.size(); i++) {
+
+        double full_frame_time = 0;
+
+        for (int j = 0; j < modes.size(); j++) {
+
+            int lost;
+            double time_per_frame = run(frame_sizes[i], modes[j], lost);
+
+            if (j == 0) {
+                full_frame_time = time_per_frame;
+            }
+
+            cout << setw(12) << (to_string(frame_sizes[i].width) + "x" + to_string(frame_sizes[i].height)) << setw(16) << modes[j].name << setw(12) << fixed << setprecision(2) << time_per_frame << setw(11) << full_frame_time / time_per_frame << "x" << setw(8) << lost << endl;
+        }
+    }
+
+    cout << endl << setw(12) << "resolution" << setw(16) << "back projection" << setw(12) << "ms/frame" << setw(12) << "speedup" << setw(10) << "differ" << endl;
+
+    for (int i = 0; i < frame_sizes.size(); i++) {
+        benchmark_back_projection(frame_sizes[i]);
+    }
+
+    cout << endl << "Blur with " << getNumThreads() << " threads" << endl;
+    cout << setw(12) << "resolution" << setw(8) << "kernel" << setw(12) << "Gaussian" << setw(12) << "box" << setw(12) << "speedup" << setw(12) << "mean diff" << setw(8) << "max" << endl;
+
+    int kernel_sizes[] = {9, 21, 61, 151, 401};
+    for (int i = 0; i < frame_sizes.size(); i++) {
+        for (int kernel_size : kernel_sizes) {
+            benchmark_blur(frame_sizes[i], kernel_size);
+        }
+    }
+
+    cout << endl << "Equalization every frame (exact) and subsampled cached, tracking error in pixels" << endl;
+    cout << setw(12) << "resolution" << setw(12) << "exact" << setw(12) << "cached" << setw(12) << "speedup" << setw(12) << "mean error" << setw(12) << "max error" << endl;
+
+    for (int i = 0; i < frame_sizes.size(); i++) {
+        benchmark_equalization(frame_sizes[i]);
+    }
+}
+
+int main(int argc, char** argv) {
+
+    bool kernels_only = false;
+    string json_file;
+
+    for (int i = 1; i < argc; i++) {
+        string argument = argv[i];
+        if (argument == "--kernels") {
+            kernels_only = true;
+        } else if (argument == "--json" && i + 1 < argc) {
+            json_file = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [--kernels] [--json FILE]" << endl;
+            return 1;
+        }
+    }
+
+    vector<Size> frame_sizes;
+    frame_sizes.push_back(Size(1920, 1080));
+    frame_sizes.push_back(Size(3840, 2160));
+
+    if (!kernels_only) {
+        benchmark_tracking(frame_sizes);
+    }
+
+    cout << endl << "Kernels with " << getNumThreads() << " threads" << endl;
+    cout << setw(12) << "resolution" << setw(16) << "kernel" << setw(14) << "parameters" << setw(12) << "ms/call" << setw(12) << "ns/pixel" << setw(12) << "frames/s" << endl;
+
+    vector<Size> kernel_frame_sizes;
+    kernel_frame_sizes.push_back(Size(1280, 720));
+    kernel_frame_sizes.push_back(Size(1920, 1080));
+    kernel_frame_sizes.push_back(Size(3840, 2160));
+
+    for (int i = 0; i < kernel_frame_sizes.size(); i++) {
+        benchmark_kernels(kernel_frame_sizes[i]);
+    }
+
+    if (!json_file.empty() && !write_json(json_file)) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# File:   check_replay.sh
+# Author: Jan Dufek
+#
+# Check that replay is deterministic. Replays the video twice and compares the
+# binary logs, which have to be identical byte for byte.
+#
+# check_replay.sh TRACKER VIDEO X,Y,W,H X,Y [ARGUMENT]...
+#
+# TRACKER is the EMILYTracker executable, VIDEO a video file or
+# synthetic[:trajectory], X,Y,W,H the object of interest in the first frame
+# and X,Y the target. Other arguments are passed to the tracker, e.g.
+# --pyramid 2.
+#
+
+if [ $# -lt 4 ]; then
+    echo "Usage: $0 TRACKER VIDEO X,Y,W,H X,Y [ARGUMENT]..." >&2
+    exit 2
+fi
+
+tracker=$1
+video=$2
+selection=$3
+target=$4
+shift 4
+
+directory=$(mktemp -d) || exit 2
+trap 'rm -rf "$directory"' EXIT
+
+for run in 1 2; do
+    if ! "$tracker" --replay --input "$video" --select "$selection" --target "$target" --output "$directory/run_$run" "$@" > "$directory/run_$run.out" 2>&1; then
+        echo "Replay $run failed:" >&2
+        cat "$directory/run_$run.out" >&2
+        exit 1
+    fi
+done
+
+if ! cmp "$directory/run_1.log" "$directory/run_2.log"; then
+    echo "Replay is not deterministic, the logs differ." >&2
+    exit 1
+fi
+
+echo "Replay is deterministic, $(wc -c < "$directory/run_1.log") bytes of log identical."
@@ -0,0 +1,1076 @@
+/**
+ * @file    main.cpp
+ * @author  Jan Dufek
+ *
+ * Offline evaluation of the tracker against annotated positions of EMILY.
+ * Tracks EMILY without any windows in the videos of a manifest, several
+ * videos in parallel, and prints localization error, number of frames in
+ * which the track was lost and frames/s of the tracking for each video.
+ *
+ * emily_evaluate [--jobs N] [--loss-distance PIXELS] [--cache] MANIFEST
+ *
+ * Manifest has one video per line, # starts a comment:
+ *
+ *     VIDEO ANNOTATION SELECTION [SETTING=VALUE]...
+ *
+ * VIDEO is a video file or synthetic[:trajectory] as for --input of the
+ * tracker. ANNOTATION is a text file with "frame_number x y" lines giving the
+ * centroid of EMILY in pixels of the video, the same format as the ground
+ * truth written for synthetic scenes. Frames without a line are not
+ * evaluated. SELECTION is the object of interest in the first frame as
+ * x,y,w,h. For synthetic scenes both can be - to use the rendered ground
+ * truth and hull. SETTING=VALUE overrides a setting for that video, e.g. the
+ * saturation_min and value_min of the trial.
+ *
+ * emily_evaluate [--jobs N] [--loss-distance PIXELS] [--cache] --sweep FILE
+ *                [--random N] [--seed S] [--top N] MANIFEST
+ *
+ * Sweep tracks the videos of the manifest with many configurations of the
+ * settings and prints the best ones. Each line of the sweep file has a
+ * setting followed by its values, either a list a,b,c or a range
+ * start:stop:step. All combinations are tracked, or N random ones with
+ * --random. Each video is decoded once and its frames are shared by the
+ * workers, each tracking with its share of the configurations.
+ *
+ * --cache reads the videos through the frame cache, which decodes each video
+ * once into a raw file reused by later evaluations and sweeps.
+ *
+ * Frame in which the track is lost is an annotated frame in which EMILY was
+ * not found or was found further than the loss distance from the annotation.
+ * Localization error is over the annotated frames in which EMILY was found.
+ *
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+#include "Tracker.hpp"
+#include "VideoSource.hpp"
+#include "SyntheticSource.hpp"
+#include "FrameCache.hpp"
+#include "BoundedQueue.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Default distance from the annotation in pixels beyond which the track is
+// considered lost
+#define LOSS_DISTANCE 20
+
+// Number of decoded frames passed to the sweep workers at once
+#define SWEEP_BLOCK_FRAMES 8
+
+// Number of blocks waiting for each sweep worker. Bounds the memory of the
+// decoded frames, as a block is freed when the slowest worker is done with
+// it.
+#define SWEEP_QUEUE_SIZE 2
+
+// Number of best configurations printed after a sweep
+#define SWEEP_TOP 10
+
+// Evaluation of one video of the manifest
+struct Evaluation {
+
+    // Manifest line
+    string video;
+    string annotation_file;
+    string selection;
+    vector<string> settings;
+
+    // Error message if the video could not be evaluated
+    string error;
+
+    long frames = 0;
+    long annotated_frames = 0;
+    long lost_frames = 0;
+
+    // Localization errors in pixels sorted in ascending order
+    vector<double> errors;
+
+    // Time spent preprocessing and tracking in seconds
+    double processing_time = 0;
+};
+
+// Opened video of a manifest line
+struct Video {
+
+    FrameSource * frame_source;
+
+    // Rendered scene or NULL
+    SyntheticSource * synthetic_source;
+
+    // Annotated positions of EMILY in pixels of the video by frame number
+    map<long, Point2d> annotations;
+
+    // Object of interest in the first frame in pixels of the processed frames
+    Rect selection;
+
+    // Frames larger than the processing limit are scaled down
+    double scale;
+    Size processing_size;
+};
+
+// Tracker with its own settings and the comparison of its positions with the
+// annotations
+struct TrackingRun {
+
+    Settings * settings;
+
+    Tracker * tracker;
+
+    Mat blured_frame;
+    Mat HSV_frame;
+    Mat back_projection;
+    Mat histogram_image;
+
+    Evaluation * evaluation;
+};
+
+// Setting swept over a list of values
+struct SweepParameter {
+    string name;
+    vector<string> values;
+};
+
+// Decoded frames shared read-only by the sweep workers
+struct FrameBlock {
+    long first_frame_number;
+    vector<Mat> frames;
+};
+
+// Settings that can be overridden in the manifest
+struct IntegerSetting {
+    const char * name;
+    int Settings::* member;
+};
+
+struct DoubleSetting {
+    const char * name;
+    double Settings::* member;
+};
+
+struct BoolSetting {
+    const char * name;
+    bool Settings::* member;
+};
+
+static const IntegerSetting INTEGER_SETTINGS[] = {
+    {"hue_1_min", &Settings::hue_1_min},
+    {"hue_1_max", &Settings::hue_1_max},
+    {"hue_2_min", &Settings::hue_2_min},
+    {"hue_2_max", &Settings::hue_2_max},
+    {"saturation_min", &Settings::saturation_min},
+    {"saturation_max", &Settings::saturation_max},
+    {"value_min", &Settings::value_min},
+    {"value_max", &Settings::value_max},
+    {"blur_kernel_size", &Settings::blur_kernel_size},
+    {"blur_engine", &Settings::blur_engine},
+    {"pyramid_levels", &Settings::pyramid_levels},
+    {"equalization_sample_step", &Settings::equalization_sample_step},
+    {"equalization_interval", &Settings::equalization_interval},
+    {"synthetic_frames", &Settings::synthetic_frames},
+    {"synthetic_glints", &Settings::synthetic_glints},
+    {"synthetic_seed", &Settings::synthetic_seed}
+};
+
+static const DoubleSetting DOUBLE_SETTINGS[] = {
+    {"synthetic_fps", &Settings::synthetic_fps},
+    {"synthetic_altitude", &Settings::synthetic_altitude},
+    {"synthetic_field_of_view", &Settings::synthetic_field_of_view},
+    {"synthetic_camera_angle", &Settings::synthetic_camera_angle},
+    {"synthetic_hull_length", &Settings::synthetic_hull_length},
+    {"synthetic_hull_beam", &Settings::synthetic_hull_beam},
+    {"synthetic_speed", &Settings::synthetic_speed},
+    {"synthetic_trajectory_radius", &Settings::synthetic_trajectory_radius},
+    {"synthetic_noise", &Settings::synthetic_noise}
+};
+
+static const BoolSetting BOOL_SETTINGS[] = {
+    {"search_region_enabled", &Settings::search_region_enabled},
+    {"fused_back_projection", &Settings::fused_back_projection},
+    {"frame_cache", &Settings::frame_cache}
+};
+
+/**
+ * Set a setting given as "name=value".
+ *
+ * @param settings
+ * @param assignment
+ * @return false if there is no such setting or the value is not a number
+ */
+bool apply_setting(Settings& settings, string assignment) {
+
+    size_t separator = assignment.find('=');
+    if (separator == string::npos) {
+        return false;
+    }
+
+    string name = assignment.substr(0, separator);
+    istringstream value(assignment.substr(separator + 1));
+
+    for (const IntegerSetting& setting : INTEGER_SETTINGS) {
+        if (name == setting.name) {
+            return (value >> settings.*setting.member) && value.eof();
+        }
+    }
+
+    for (const DoubleSetting& setting : DOUBLE_SETTINGS) {
+        if (name == setting.name) {
+            return (value >> settings.*setting.member) && value.eof();
+        }
+    }
+
+    for (const BoolSetting& setting : BOOL_SETTINGS) {
+        if (name == setting.name) {
+            return (value >> settings.*setting.member) && value.eof();
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Read the manifest.
+ *
+ * @param file_name
+ * @param evaluations one for each video
+ * @return false if the manifest cannot be read or is not valid
+ */
+bool read_manifest(string file_name, vector<Evaluation>& evaluations) {
+
+    ifstream file(file_name);
+
+    if (!file.is_open()) {
+        cerr << "Cannot open the manifest " << file_name << "." << endl;
+        return false;
+    }
+
+    string line;
+    int line_number = 0;
+
+    while (getline(file, line)) {
+
+        line_number++;
+
+        // Comments
+        line = line.substr(0, line.find('#'));
+
+        istringstream stream(line);
+        Evaluation evaluation;
+
+        // Empty line
+        if (!(stream >> evaluation.video)) {
+            continue;
+        }
+
+        if (!(stream >> evaluation.annotation_file >> evaluation.selection)) {
+            cerr << file_name << ":" << line_number << ": expected VIDEO ANNOTATION SELECTION [SETTING=VALUE]..." << endl;
+            return false;
+        }
+
+        string assignment;
+        Settings settings;
+        while (stream >> assignment) {
+            if (!apply_setting(settings, assignment)) {
+                cerr << file_name << ":" << line_number << ": unknown setting or invalid value " << assignment << endl;
+                return false;
+            }
+            evaluation.settings.push_back(assignment);
+        }
+
+        evaluations.push_back(evaluation);
+    }
+
+    return true;
+}
+
+/**
+ * Read annotated positions of EMILY.
+ *
+ * @param file_name
+ * @param annotations positions by frame number
+ * @return false if the file cannot be read
+ */
+bool read_annotations(string file_name, map<long, Point2d>& annotations) {
+
+    ifstream file(file_name);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    string line;
+    while (getline(file, line)) {
+
+        // Header and other lines not starting with numbers are skipped
+        istringstream stream(line);
+        long frame_number;
+        Point2d position;
+        if (stream >> frame_number >> position.x >> position.y) {
+            annotations[frame_number] = position;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Open the video of a manifest line with its annotations and selection.
+ *
+ * @param evaluation manifest line, gets the error message if the video
+ * cannot be opened
+ * @param settings settings of the video, used by synthetic scenes
+ * @param video
+ * @return false if the video cannot be opened
+ */
+bool open_video(Evaluation& evaluation, Settings& settings, Video& video) {
+
+    bool opened;
+    video.synthetic_source = NULL;
+    FrameCache * frame_cache = NULL;
+
+    if (evaluation.video.compare(0, 9, "synthetic") == 0 && (evaluation.video.size() == 9 || evaluation.video[9] == ':')) {
+        video.synthetic_source = new SyntheticSource(settings);
+        video.frame_source = video.synthetic_source;
+        opened = video.synthetic_source->open(evaluation.video.size() > 9 ? evaluation.video.substr(10) : "");
+    } else {
+
+        // Decoded frames of video files are reused from the previous runs
+        frame_cache = settings.frame_cache ? FrameCache::open_video(evaluation.video, settings) : NULL;
+        video.frame_source = frame_cache;
+        opened = frame_cache != NULL;
+
+        if (!opened) {
+            VideoSource * video_source = new VideoSource();
+            video.frame_source = video_source;
+            opened = video_source->open(evaluation.video);
+        }
+    }
+
+    if (!opened) {
+        evaluation.error = "cannot open the video";
+        delete video.frame_source;
+        return false;
+    }
+
+    // Annotations and selection
+    Rect& selection = video.selection;
+
+    if (evaluation.annotation_file == "-" && video.synthetic_source != NULL) {
+        for (long i = 0; i < settings.synthetic_frames; i++) {
+            video.annotations[i] = video.synthetic_source->get_ground_truth(i).center;
+        }
+    } else if (!read_annotations(evaluation.annotation_file, video.annotations)) {
+        evaluation.error = "cannot read the annotation " + evaluation.annotation_file;
+        delete video.frame_source;
+        return false;
+    }
+
+    if (evaluation.selection == "-" && video.synthetic_source != NULL) {
+        selection = video.synthetic_source->get_hull_box(0);
+    } else {
+        string values = evaluation.selection;
+        replace(values.begin(), values.end(), ',', ' ');
+        istringstream stream(values);
+        if (!(stream >> selection.x >> selection.y >> selection.width >> selection.height) || selection.area() <= 0) {
+            evaluation.error = "selection has to be x,y,w,h";
+            delete video.frame_source;
+            return false;
+        }
+    }
+
+    // Large videos are resized the same way as by the tracker. Annotations
+    // are in pixels of the video, also when its frames were downscaled in the
+    // frame cache.
+    Size video_size = frame_cache != NULL ? frame_cache->get_source_size() : video.frame_source->get_size();
+    video.scale = 1;
+    if (video_size.height > settings.PROCESSING_VIDEO_HEIGHT_LIMIT) {
+        video.scale = (double) settings.PROCESSING_VIDEO_HEIGHT_LIMIT / video_size.height;
+    }
+    video.processing_size = Size(video_size.width * video.scale, video_size.height * video.scale);
+    if (frame_cache != NULL && frame_cache->get_size().height <= settings.PROCESSING_VIDEO_HEIGHT_LIMIT) {
+        video.processing_size = frame_cache->get_size();
+    }
+
+    double scale = video.scale;
+    selection = Rect(selection.x * scale, selection.y * scale, selection.width * scale, selection.height * scale) & Rect(Point(0, 0), video.processing_size);
+
+    return true;
+}
+
+/**
+ * Read the next frame of the video resized for processing.
+ *
+ * @param video
+ * @param frame
+ * @return false at the end of the video
+ */
+bool read_frame(Video& video, Mat& frame) {
+
+    if (!video.frame_source->read(frame)) {
+        return false;
+    }
+
+    if (frame.size() != video.processing_size) {
+        resize(frame, frame, video.processing_size, 0, 0, INTER_AREA);
+    }
+
+    return true;
+}
+
+/**
+ * Track EMILY in one frame and compare the tracked position with the
+ * annotation.
+ *
+ * @param run
+ * @param video
+ * @param frame frame resized for processing, it is not modified
+ * @param frame_number
+ * @param loss_distance
+ */
+void track_frame(TrackingRun& run, Video& video, Mat frame, long frame_number, double loss_distance) {
+
+    Settings& settings = * run.settings;
+    Tracker& tracker = * run.tracker;
+    Evaluation& evaluation = * run.evaluation;
+
+    evaluation.frames++;
+
+    int64 start = getTickCount();
+
+    // Object of interest is selected in the first frame and tracked in the
+    // following ones
+    if (frame_number == 0) {
+        tracker.preprocess(frame, Rect(Point(0, 0), video.processing_size), run.blured_frame, run.HSV_frame);
+        tracker.select(run.HSV_frame, video.selection, run.histogram_image);
+        evaluation.processing_time += (getTickCount() - start) / getTickFrequency();
+        return;
+    }
+
+    RotatedRect tracking_box;
+    bool found;
+
+    if (settings.pyramid_levels > 0) {
+        vector<Mat> pyramid;
+        Rect refine_region;
+        Mat equalization_table;
+        tracker.preprocess_pyramid(frame, pyramid, run.HSV_frame, equalization_table);
+        found = tracker.track_pyramid(pyramid, run.HSV_frame, equalization_table, refine_region, tracking_box, run.back_projection);
+    } else {
+        Rect search_region = tracker.get_search_region(video.processing_size);
+        if (settings.fused_back_projection) {
+            tracker.preprocess_back_projection(frame, search_region, run.blured_frame, run.back_projection);
+            found = tracker.track_back_projection(run.back_projection, search_region, tracking_box);
+        } else {
+            tracker.preprocess(frame, search_region, run.blured_frame, run.HSV_frame);
+            found = tracker.track(run.HSV_frame, search_region, tracking_box, run.back_projection);
+        }
+    }
+
+    evaluation.processing_time += (getTickCount() - start) / getTickFrequency();
+
+    // Compare with the annotation
+    map<long, Point2d>::iterator annotation = video.annotations.find(frame_number);
+    if (annotation == video.annotations.end()) {
+        return;
+    }
+
+    evaluation.annotated_frames++;
+
+    double error = -1;
+    if (found) {
+        Point2d center(tracking_box.center.x / video.scale, tracking_box.center.y / video.scale);
+        Point2d difference = center - annotation->second;
+        error = sqrt(difference.dot(difference));
+        evaluation.errors.push_back(error);
+    }
+
+    if (!found || error > loss_distance) {
+        evaluation.lost_frames++;
+    }
+}
+
+/**
+ * Track EMILY in one video and compare the tracked positions with the
+ * annotations.
+ *
+ * @param evaluation
+ * @param loss_distance
+ */
+void evaluate(Evaluation& evaluation, double loss_distance) {
+
+    Settings settings;
+    for (int i = 0; i < evaluation.settings.size(); i++) {
+        apply_setting(settings, evaluation.settings[i]);
+    }
+
+    Video video;
+    if (!open_video(evaluation, settings, video)) {
+        return;
+    }
+
+    TrackingRun run;
+    run.settings = &settings;
+    run.tracker = new Tracker(settings);
+    run.evaluation = &evaluation;
+
+    Mat frame;
+    long frame_number = 0;
+
+    while (read_frame(video, frame)) {
+        track_frame(run, video, frame, frame_number++, loss_distance);
+    }
+
+    sort(evaluation.errors.begin(), evaluation.errors.end());
+
+    delete run.tracker;
+    delete video.frame_source;
+}
+
+/**
+ * Print one row of the summary table.
+ *
+ * @param evaluation
+ * @param name_width
+ */
+void print_row(Evaluation& evaluation, int name_width) {
+
+    cout << left << setw(name_width) << evaluation.video << right;
+
+    if (!evaluation.error.empty()) {
+        cout << "  " << evaluation.error << endl;
+        return;
+    }
+
+    cout << setw(8) << evaluation.frames << setw(11) << evaluation.annotated_frames;
+
+    vector<double>& errors = evaluation.errors;
+
+    if (errors.empty()) {
+        cout << setw(11) << "-" << setw(11) << "-" << setw(11) << "-";
+    } else {
+        double mean_error = 0;
+        for (int i = 0; i < errors.size(); i++) {
+            mean_error += errors[i] / errors.size();
+        }
+        cout << fixed << setprecision(2) << setw(11) << mean_error << setw(11) << errors[(long) ceil(0.95 * errors.size()) - 1] << setw(11) << errors.back();
+    }
+
+    cout << setw(8) << evaluation.lost_frames << setw(10) << fixed << setprecision(1) << (evaluation.processing_time > 0 ? evaluation.frames / evaluation.processing_time : 0) << endl;
+}
+
+/**
+ * Print results of the evaluations as a table. The total row pools the
+ * frames of all evaluated videos.
+ *
+ * @param evaluations
+ */
+void print_summary(vector<Evaluation>& evaluations) {
+
+    int name_width = 10;
+    for (int i = 0; i < evaluations.size(); i++) {
+        name_width = max(name_width, (int) evaluations[i].video.size() + 2);
+    }
+
+    cout << left << setw(name_width) << "video" << right << setw(8) << "frames" << setw(11) << "annotated" << setw(11) << "mean err" << setw(11) << "p95 err" << setw(11) << "max err" << setw(8) << "lost" << setw(10) << "frames/s" << endl;
+
+    Evaluation total;
+    total.video = "total";
+
+    for (int i = 0; i < evaluations.size(); i++) {
+
+        Evaluation& evaluation = evaluations[i];
+
+        print_row(evaluation, name_width);
+
+        if (evaluation.error.empty()) {
+            total.frames += evaluation.frames;
+            total.annotated_frames += evaluation.annotated_frames;
+            total.lost_frames += evaluation.lost_frames;
+            total.processing_time += evaluation.processing_time;
+            total.errors.insert(total.errors.end(), evaluation.errors.begin(), evaluation.errors.end());
+        }
+    }
+
+    sort(total.errors.begin(), total.errors.end());
+
+    print_row(total, name_width);
+}
+
+/**
+ * Read the sweep file. Each line has a setting name followed by its values,
+ * either as a list "a,b,c" or as an inclusive range "start:stop:step".
+ *
+ * @param file_name
+ * @param parameters
+ * @return false if the file cannot be read or is not valid
+ */
+bool read_sweep(string file_name, vector<SweepParameter>& parameters) {
+
+    ifstream file(file_name);
+
+    if (!file.is_open()) {
+        cerr << "Cannot open the sweep " << file_name << "." << endl;
+        return false;
+    }
+
+    string line;
+    int line_number = 0;
+
+    while (getline(file, line)) {
+
+        line_number++;
+
+        // Comments
+        line = line.substr(0, line.find('#'));
+
+        istringstream stream(line);
+        SweepParameter parameter;
+        string values;
+
+        // Empty line
+        if (!(stream >> parameter.name)) {
+            continue;
+        }
+
+        if (!(stream >> values)) {
+            cerr << file_name << ":" << line_number << ": expected SETTING VALUES" << endl;
+            return false;
+        }
+
+        double start, stop, step;
+        char separator_1, separator_2;
+        istringstream range(values);
+
+        if (values.find(':') != string::npos && range >> start >> separator_1 >> stop >> separator_2 >> step && range.eof() && separator_1 == ':' && separator_2 == ':' && step > 0) {
+
+            for (int i = 0; start + i * step <= stop + step * 1e-9; i++) {
+                ostringstream value;
+                value << start + i * step;
+                parameter.values.push_back(value.str());
+            }
+
+        } else {
+
+            replace(values.begin(), values.end(), ',', ' ');
+            istringstream list(values);
+            string value;
+            while (list >> value) {
+                parameter.values.push_back(value);
+            }
+
+        }
+
+        // Every value has to be valid for the setting
+        Settings settings;
+        for (int i = 0; i < parameter.values.size(); i++) {
+            if (!apply_setting(settings, parameter.name + "=" + parameter.values[i])) {
+                cerr << file_name << ":" << line_number << ": unknown setting or invalid value " << parameter.name << "=" << parameter.values[i] << endl;
+                return false;
+            }
+        }
+
+        if (parameter.values.empty()) {
+            cerr << file_name << ":" << line_number << ": no values for " << parameter.name << endl;
+            return false;
+        }
+
+        parameters.push_back(parameter);
+    }
+
+    return true;
+}
+
+/**
+ * Create configurations of the sweep, either the full grid of all
+ * combinations of the values or randomly chosen different combinations.
+ *
+ * @param parameters
+ * @param random_count number of random configurations, 0 for the full grid
+ * @param seed seed of the random choice
+ * @param configurations "name=value" settings of each configuration
+ */
+void create_configurations(vector<SweepParameter>& parameters, int random_count, int seed, vector<vector<string> >& configurations) {
+
+    double grid_size = 1;
+    for (int i = 0; i < parameters.size(); i++) {
+        grid_size *= parameters[i].values.size();
+    }
+
+    // Indices of the values of each configuration
+    set<vector<int> > chosen;
+    vector<vector<int> > indices;
+
+    if (random_count > 0 && random_count < grid_size) {
+
+        mt19937 generator(seed);
+
+        while (indices.size() < random_count) {
+            vector<int> index(parameters.size());
+            for (int i = 0; i < parameters.size(); i++) {
+                index[i] = uniform_int_distribution<int>(0, parameters[i].values.size() - 1)(generator);
+            }
+            if (chosen.insert(index).second) {
+                indices.push_back(index);
+            }
+        }
+
+    } else {
+
+        // Counter with one digit per parameter
+        vector<int> index(parameters.size(), 0);
+        for (long i = 0; i < grid_size; i++) {
+            indices.push_back(index);
+            for (int j = (int) parameters.size() - 1; j >= 0 && ++index[j] == parameters[j].values.size(); j--) {
+                index[j] = 0;
+            }
+        }
+
+    }
+
+    for (int i = 0; i < indices.size(); i++) {
+        vector<string> configuration;
+        for (int j = 0; j < parameters.size(); j++) {
+            configuration.push_back(parameters[j].name + "=" + parameters[j].values[indices[i][j]]);
+        }
+        configurations.push_back(configuration);
+    }
+}
+
+/**
+ * Track EMILY in one video with each configuration. The video is decoded
+ * once and blocks of its frames are passed to all workers, each of which
+ * tracks with its share of the configurations.
+ *
+ * @param evaluation manifest line
+ * @param configurations
+ * @param results results of each configuration, the video is added to them
+ * @param thread_count
+ * @param loss_distance
+ * @return false if the video cannot be opened
+ */
+bool sweep_video(Evaluation& evaluation, vector<vector<string> >& configurations, vector<Evaluation>& results, int thread_count, double loss_distance) {
+
+    // Settings of the video, used by synthetic scenes
+    Settings video_settings;
+    for (int i = 0; i < evaluation.settings.size(); i++) {
+        apply_setting(video_settings, evaluation.settings[i]);
+    }
+
+    Video video;
+    if (!open_video(evaluation, video_settings, video)) {
+        return false;
+    }
+
+    // Settings of the video overridden by each configuration
+    vector<TrackingRun *> runs;
+    vector<Evaluation> video_results(configurations.size());
+
+    for (int i = 0; i < configurations.size(); i++) {
+
+        TrackingRun * run = new TrackingRun();
+        run->settings = new Settings();
+
+        for (int j = 0; j < evaluation.settings.size(); j++) {
+            apply_setting(* run->settings, evaluation.settings[j]);
+        }
+        for (int j = 0; j < configurations[i].size(); j++) {
+            apply_setting(* run->settings, configurations[i][j]);
+        }
+
+        run->tracker = new Tracker(* run->settings);
+        run->evaluation = &video_results[i];
+        runs.push_back(run);
+    }
+
+    thread_count = max(1, min(thread_count, (int) runs.size()));
+
+    vector<BoundedQueue<shared_ptr<FrameBlock> > *> queues;
+    for (int i = 0; i < thread_count; i++) {
+        queues.push_back(new BoundedQueue<shared_ptr<FrameBlock> >(SWEEP_QUEUE_SIZE));
+    }
+
+    // Worker i tracks with configurations i, i + thread_count, ...
+    auto worker = [&](int worker_index) {
+        shared_ptr<FrameBlock> block;
+        while (queues[worker_index]->pop(block)) {
+            for (int i = worker_index; i < runs.size(); i += thread_count) {
+                for (int j = 0; j < block->frames.size(); j++) {
+                    track_frame(* runs[i], video, block->frames[j], block->first_frame_number + j, loss_distance);
+                }
+            }
+            block.reset();
+        }
+    };
+
+    vector<thread> threads;
+    for (int i = 0; i < thread_count; i++) {
+        threads.push_back(thread(worker, i));
+    }
+
+    // Decode on this thread
+    long frame_number = 0;
+    bool more_frames = true;
+
+    while (more_frames) {
+
+        shared_ptr<FrameBlock> block(new FrameBlock());
+        block->first_frame_number = frame_number;
+
+        while (block->frames.size() < SWEEP_BLOCK_FRAMES) {
+            Mat frame;
+            if (!read_frame(video, frame)) {
+                more_frames = false;
+                break;
+            }
+            block->frames.push_back(frame);
+        }
+
+        frame_number += block->frames.size();
+
+        if (!block->frames.empty()) {
+            for (int i = 0; i < thread_count; i++) {
+                queues[i]->push(block);
+            }
+        }
+    }
+
+    for (int i = 0; i < thread_count; i++) {
+        queues[i]->close();
+    }
+    for (int i = 0; i < thread_count; i++) {
+        threads[i].join();
+        delete queues[i];
+    }
+
+    // Add the video to the results of each configuration
+    for (int i = 0; i < runs.size(); i++) {
+
+        Evaluation& result = results[i];
+        result.frames += video_results[i].frames;
+        result.annotated_frames += video_results[i].annotated_frames;
+        result.lost_frames += video_results[i].lost_frames;
+        result.processing_time += video_results[i].processing_time;
+        result.errors.insert(result.errors.end(), video_results[i].errors.begin(), video_results[i].errors.end());
+
+        delete runs[i]->tracker;
+        delete runs[i]->settings;
+        delete runs[i];
+    }
+
+    delete video.frame_source;
+
+    return true;
+}
+
+/**
+ * Run the sweep on all videos of the manifest and print the best
+ * configurations. Configurations are ranked by the number of frames in which
+ * the track was lost and then by the mean localization error.
+ *
+ * @param evaluations manifest lines
+ * @param parameters
+ * @param random_count number of random configurations, 0 for the full grid
+ * @param seed
+ * @param top number of best configurations printed
+ * @param thread_count
+ * @param loss_distance
+ * @return false if any video cannot be opened
+ */
+bool sweep(vector<Evaluation>& evaluations, vector<SweepParameter>& parameters, int random_count, int seed, int top, int thread_count, double loss_distance) {
+
+    vector<vector<string> > configurations;
+    create_configurations(parameters, random_count, seed, configurations);
+
+    cout << "Sweeping " << configurations.size() << " configurations over " << evaluations.size() << " videos with " << thread_count << " threads" << endl;
+
+    vector<Evaluation> results(configurations.size());
+    for (int i = 0; i < configurations.size(); i++) {
+        for (int j = 0; j < configurations[i].size(); j++) {
+            results[i].video += (j > 0 ? " " : "") + configurations[i][j];
+        }
+    }
+
+    bool valid = true;
+
+    for (int i = 0; i < evaluations.size(); i++) {
+
+        int64 start = getTickCount();
+
+        if (!sweep_video(evaluations[i], configurations, results, thread_count, loss_distance)) {
+            cerr << evaluations[i].video << ": " << evaluations[i].error << endl;
+            valid = false;
+            continue;
+        }
+
+        cout << evaluations[i].video << " done in " << fixed << setprecision(1) << (getTickCount() - start) / getTickFrequency() << " s" << endl;
+    }
+
+    // Rank the configurations
+    vector<double> mean_errors(results.size(), numeric_limits<double>::max());
+    for (int i = 0; i < results.size(); i++) {
+        sort(results[i].errors.begin(), results[i].errors.end());
+        if (!results[i].errors.empty()) {
+            mean_errors[i] = 0;
+            for (int j = 0; j < results[i].errors.size(); j++) {
+                mean_errors[i] += results[i].errors[j] / results[i].errors.size();
+            }
+        }
+    }
+
+    vector<int> ranking(results.size());
+    for (int i = 0; i < ranking.size(); i++) {
+        ranking[i] = i;
+    }
+
+    sort(ranking.begin(), ranking.end(), [&](int a, int b) {
+        if (results[a].lost_frames != results[b].lost_frames) {
+            return results[a].lost_frames < results[b].lost_frames;
+        }
+        return mean_errors[a] < mean_errors[b];
+    });
+
+    int name_width = 16;
+    for (int i = 0; i < results.size(); i++) {
+        name_width = max(name_width, (int) results[i].video.size() + 2);
+    }
+
+    cout << endl << left << setw(name_width) << "configuration" << right << setw(8) << "frames" << setw(11) << "annotated" << setw(11) << "mean err" << setw(11) << "p95 err" << setw(11) << "max err" << setw(8) << "lost" << setw(10) << "frames/s" << endl;
+
+    for (int i = 0; i < min(top, (int) ranking.size()); i++) {
+        print_row(results[ranking[i]], name_width);
+    }
+
+    if (!ranking.empty()) {
+        cout << endl << "Best: " << results[ranking[0]].video << endl;
+    }
+
+    return valid;
+}
+
+/**
+ * Print command line usage.
+ *
+ * @param program_name
+ */
+void print_usage(char * program_name) {
+    cerr << "Usage: " << program_name << " [--jobs N] [--loss-distance PIXELS] [--cache] MANIFEST" << endl;
+    cerr << "       " << program_name << " [--jobs N] [--loss-distance PIXELS] [--cache] --sweep FILE [--random N] [--seed S] [--top N] MANIFEST" << endl;
+    cerr << "Manifest lines: VIDEO ANNOTATION SELECTION [SETTING=VALUE]..." << endl;
+    cerr << "Sweep lines: SETTING a,b,c or SETTING start:stop:step" << endl;
+}
+
+int main(int argc, char** argv) {
+
+    int jobs = thread::hardware_concurrency();
+    double loss_distance = LOSS_DISTANCE;
+    string manifest;
+    string sweep_file;
+    int random_count = 0;
+    int seed = 1;
+    int top = SWEEP_TOP;
+    bool cache = false;
+
+    for (int i = 1; i < argc; i++) {
+        string argument = argv[i];
+        if (argument == "--jobs" && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (argument == "--loss-distance" && i + 1 < argc) {
+            loss_distance = atof(argv[++i]);
+        } else if (argument == "--sweep" && i + 1 < argc) {
+            sweep_file = argv[++i];
+        } else if (argument == "--random" && i + 1 < argc) {
+            random_count = atoi(argv[++i]);
+        } else if (argument == "--seed" && i + 1 < argc) {
+            seed = atoi(argv[++i]);
+        } else if (argument == "--top" && i + 1 < argc) {
+            top = atoi(argv[++i]);
+        } else if (argument == "--cache") {
+            cache = true;
+        } else if (manifest.empty() && argument.compare(0, 2, "--") != 0) {
+            manifest = argument;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    vector<Evaluation> evaluations;
+
+    if (manifest.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (!read_manifest(manifest, evaluations)) {
+        return 1;
+    }
+
+    if (cache) {
+        for (int i = 0; i < evaluations.size(); i++) {
+            evaluations[i].settings.push_back("frame_cache=1");
+        }
+    }
+
+    if (!sweep_file.empty()) {
+
+        vector<SweepParameter> parameters;
+        if (!read_sweep(sweep_file, parameters)) {
+            return 1;
+        }
+
+        // Each worker tracks on one core
+        int thread_count = max(1, jobs);
+        setNumThreads(1);
+
+        return sweep(evaluations, parameters, random_count, seed, top, thread_count, loss_distance) ? 0 : 1;
+    }
+
+    // Videos run in parallel, each on one core, so that the frames/s of
+    // a video does not depend on how many others are running
+    int thread_count = max(1, min(jobs, (int) evaluations.size()));
+    if (thread_count > 1) {
+        setNumThreads(1);
+    }
+
+    atomic<int> next_evaluation(0);
+
+    auto worker = [&]() {
+        int i;
+        while ((i = next_evaluation++) < evaluations.size()) {
+            evaluate(evaluations[i], loss_distance);
+        }
+    };
+
+    vector<thread> threads;
+    for (int i = 0; i < thread_count; i++) {
+        threads.push_back(thread(worker));
+    }
+    for (int i = 0; i < thread_count; i++) {
+        threads[i].join();
+    }
+
+    print_summary(evaluations);
+
+    for (int i = 0; i < evaluations.size(); i++) {
+        if (!evaluations[i].error.empty()) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
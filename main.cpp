@@ -1,9 +1,9 @@
-/** 
+/**
  * @file    main.cpp
  * @author  Jan Dufek
  * @date    07/01/2016
  * @version 2.0
- *  
+ *
  * This project uses the video from a small unmanned aerial system to
  * autonomously navigate an unmanned surface vehicle covered in a flotation
  * jacket to reach drowning victims.
@@ -18,6 +18,13 @@
 #include <time.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
 #include "opencv2/opencv.hpp"
 #include "Settings.hpp"
 #include "Control.hpp"
@@ -26,6 +33,21 @@
 #include "Communication.hpp"
 #include "UserInterface.hpp"
 #include "Undistort.hpp"
+#include "CaptureThread.hpp"
+#include "VideoSource.hpp"
+#include "SyntheticSource.hpp"
+#include "FrameCache.hpp"
+#include "PacedSource.hpp"
+#include "CommandThread.hpp"
+#include "BoundedQueue.hpp"
+#include "PipelineFrame.hpp"
+#include "Tracker.hpp"
+#include "ConsoleInput.hpp"
+#include "SharedFrames.hpp"
+#include "LatencyHistogram.hpp"
+#include "Trace.hpp"
+#include "PerfCounters.hpp"
+#include <signal.h>
 #include <sys/socket.h>
 #include <netdb.h>
 #include <stdlib.h>
@@ -58,7 +80,24 @@ Settings * settings = new Settings();
 // Video Capture
 ////////////////////////////////////////////////////////////////////////////////
 
-VideoCapture video_capture = VideoCapture(settings->video_capture_source);
+// Opened in main so that the source can be given on the command line
+FrameSource * frame_source;
+
+// Rendered scene when the input is synthetic, otherwise NULL
+SyntheticSource * synthetic_source = NULL;
+
+// Frame cache of the video file when it is enabled, otherwise NULL
+FrameCache * frame_cache = NULL;
+
+// Video file played like a live stream when it is enabled, otherwise NULL
+PacedSource * paced_source = NULL;
+
+// Sends commands at the command rate, NULL if they are sent once per frame
+CommandThread * command_thread = NULL;
+
+// Frames tracked, handed back to the preprocessing in replay mode so that it
+// never runs ahead of the tracking. NULL if not replaying.
+BoundedQueue<long> * replay_handshake = NULL;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Control
@@ -76,8 +115,9 @@ Control * control = new Control(* settings);
 // define WAIT_FOR_OBJECT_SELECTION pragma, as there would be no object selection.
 #define CAMSHIFT
 
-// Enable inverse perspective warping. This will take an angle from GUI and
-// approximate overhead view.
+// Enable inverse perspective warping. EMILY and target positions are mapped to
+// an approximate overhead view used for heading estimation and control. Frames
+// are only warped for the optional overhead view window.
 //#define INVERSE_PERSPECTIVE_WARP
 
 // This will wait for an object of interest to be selected before loading next
@@ -100,25 +140,29 @@ Control * control = new Control(* settings);
 ////////////////////////////////////////////////////////////////////////////////
 
 // Back projection mode toggle
-bool back_projection_mode = false;
+atomic<bool> back_projection_mode(false);
 
 // Select object flag
 bool select_object = false;
 
 // Track object mode toggle
-int object_selected = 0;
+atomic<int> object_selected(0);
 
 // Object selection
 Rect selection;
 
+// Guards selection and target location which are set in the GUI and read by
+// the processing threads
+mutex operator_input_mutex;
+
 // New resized size of video used in processing
 Size resized_video_size;
 
 // Indicates that resizing is necessary
 bool resize_video = false;
 
-// Original frame
-Mat original_frame;
+// First frame of the video input
+Mat first_frame;
 
 // Target location for EMILY to go to
 Point target_location;
@@ -133,13 +177,16 @@ Point * emily_location_history = new Point[settings->EMILY_LOCATION_HISTORY_SIZE
 
 Point mouse_location;
 
+// Error log file
+ofstream error_log_file;
+
 #endif
 
 // EMILY motion angle
 double emily_angle;
 
 // Target was reached
-bool target_reached = false;
+atomic<bool> target_reached(false);
 
 // Target reached in this iteration
 bool target_reached_now = false;
@@ -147,52 +194,120 @@ bool target_reached_now = false;
 // Timer to estimate EMILY heading
 int emily_location_history_pointer;
 
-// EMILY pose
-Point emily_pose_point_1;
-Point emily_pose_point_2;
-
 // Status of the algorithm
 int status = 0;
 
 // Time it takes to reach the target.
-time_t startTarget, endTarget;
+double startTarget, endTarget;
 double timeToTarget = 0;
 
+// Frame rate of the video input. Gives time of the frames in replay mode.
+double input_video_fps = 0;
+
 // Frame number
 long frame_number = -1;
 
+// Paused mode
+atomic<bool> paused(false);
+
+// Visualization of histogram
+Mat histogram_image;
+
+////////////////////////////////////////////////////////////////////////////////
+// Pipeline
+////////////////////////////////////////////////////////////////////////////////
+
+// Each stage runs on its own thread and passes frames to the next stage
+// through a bounded queue:
+//
+// capture -> preprocess -> track -> control -> render -> record
+//                                           -> log
+//
+// Control never waits for rendering or logging. If the render stage cannot
+// keep up, its queue drops the oldest frames. Control hands log records to the
+// lock-free log buffer, which is written by the logger thread. The recorder
+// follows its own policy (Settings::record_policy).
+
+// Pipeline is running
+atomic<bool> running(false);
+
+// Operator asked to stop processing (console quit command or Ctrl+C)
+atomic<bool> quit_requested(false);
+
+// Operator input from the console
+ConsoleInput * console_input;
+
+// Frames published for the viewer
+SharedFrames * shared_frames;
+
+// Video input
+CaptureThread * capture_thread;
+
+// Tracking algorithm
+Tracker * tracker;
+
+// Communication with EMILY
+Communication * communication;
+
+// Log
+Logger * logger;
+
+// Graphical user interface
+UserInterface * user_interface;
+
+// Output video
+OutputVideo * output_video;
+
+#ifdef INVERSE_PERSPECTIVE_WARP
+
+// Camera distortion
+Undistort * undistort;
+
+#endif
+
+// Queues between the stages. Each queue is named after the stage reading it.
+BoundedQueue<PipelineFrame> * track_queue;
+BoundedQueue<PipelineFrame> * control_queue;
+BoundedQueue<PipelineFrame> * render_queue;
+
+// Number of processed frames and time spent processing them in each stage
+struct StageStatistics {
+    atomic<long> frames;
+    atomic<long> busy_time;
+};
+
+StageStatistics preprocess_statistics;
+StageStatistics track_statistics;
+StageStatistics control_statistics;
+StageStatistics render_statistics;
+
+// Latency from capture to the end of each stage and to sending the commands.
+// Recorded by the control stage for every frame whose commands were sent.
+LatencyHistogram preprocess_latency;
+LatencyHistogram track_latency;
+LatencyHistogram control_latency;
+LatencyHistogram send_latency;
+LatencyHistogram total_latency;
+
+// Hardware performance counters of the stages
+PerfCounters preprocess_counters("Preprocess");
+PerfCounters track_counters("Track");
+PerfCounters control_counters("Control");
+PerfCounters render_counters("Render");
+
 /**
  * Get size of the give rectangle. The size is measured as distance of midpoints
  * of shorter sides.
- * 
+ *
  * @param rectangle
- * @return 
+ * @return
  */
 double get_size(RotatedRect rectangle) {
 
-    // Get points of bounding rectangle
-    Point2f rectangle_points[4];
-    rectangle.points(rectangle_points);
-
-    // Initialize variables to look for the rectangle shortest side
-    double shortest_axis = DBL_MAX;
-    int shortest_axis_index;
-
-    // For each side
-    for (int j = 0; j < 4; j++) {
-
-        // Line length
-        double line_length = norm(rectangle_points[j] - rectangle_points[(j + 1) % 4]);
-
-        if (line_length < shortest_axis) {
-            shortest_axis = line_length;
-            shortest_axis_index = j;
-        }
-    }
-
     // Get midpoints of the shortest sides
-    Point shortest_axis_midpoint_1 = (rectangle_points[shortest_axis_index] + rectangle_points[(shortest_axis_index + 1) % 4]) * 0.5;
-    Point shortest_axis_midpoint_2 = (rectangle_points[(shortest_axis_index + 2) % 4] + rectangle_points[(shortest_axis_index + 3) % 4]) * 0.5;
+    Point shortest_axis_midpoint_1;
+    Point shortest_axis_midpoint_2;
+    Tracker::get_principal_axis(rectangle, shortest_axis_midpoint_1, shortest_axis_midpoint_2);
 
     // Return size
     return sqrt(pow(shortest_axis_midpoint_1.x - shortest_axis_midpoint_2.x, 2) + pow(shortest_axis_midpoint_1.y - shortest_axis_midpoint_2.y, 2)) / 2;
@@ -278,7 +393,12 @@ double get_orientation(const vector<Point> &pts, Mat &img) {
  * @return Frame per seconds
  */
 double get_input_video_fps() {
-    double input_video_fps = video_capture.get(CV_CAP_PROP_FPS);
+    double input_video_fps = frame_source->get_fps();
+
+    // Replay reads only files, so the frames must not be spent on measuring
+    if (input_video_fps == 0 && settings->replay) {
+        return settings->REPLAY_DEFAULT_FPS;
+    }
 
     // If the input is video stream, we have to calculate FPS manually
     if (input_video_fps == 0) {
@@ -297,7 +417,7 @@ double get_input_video_fps() {
 
         // Load sample frames
         for (int i = 0; i < num_sample_frames; i++) {
-            video_capture >> sample_frame;
+            frame_source->read(sample_frame);
         }
 
         // End timer
@@ -324,7 +444,7 @@ double get_input_video_fps() {
  */
 void get_input_video_size() {
 
-    Size input_video_size(video_capture.get(CV_CAP_PROP_FRAME_WIDTH), video_capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+    Size input_video_size = frame_source->get_size();
 
     // If the input video exceeds processing video size limits, we will have to resize it
     if (input_video_size.height > settings->PROCESSING_VIDEO_HEIGHT_LIMIT) {
@@ -361,202 +481,158 @@ void get_input_video_size() {
 }
 
 /**
- * Equalize histogram of the given frame.
- * 
- * @param HSV_frame
+ * Get orientation of the USV based on its location history.
+ *
+ * @param frame frame to which save the approximated path and heading
  */
-void equalize(Mat& HSV_frame) {
-    vector<Mat> HSV_planes;
-    split(HSV_frame, HSV_planes);
-    equalizeHist(HSV_planes[2], HSV_planes[2]);
-    merge(HSV_planes, HSV_frame);
+void get_orientation(PipelineFrame& frame) {
+
+    // Curve polynomial tangent angle. The path and heading are drawn by the
+    // render stage.
+    emily_angle = Tracker::get_orientation(emily_location_history, settings->EMILY_LOCATION_HISTORY_SIZE, emily_location_history_pointer, settings->HEADING_LINE_LENGTH, frame.path_polynomial_approximation, frame.heading_point);
+
+    frame.heading_estimated = true;
 }
 
 /**
- * Create histogram for the area of interest.
- * 
- * @param object_of_interest
- * @param histogram_size
- * @param pointer_histogram_ranges
- * @param hue
- * @param saturation_value_threshold
- * @param histogram
- * @param histogram_image
+ * Get time between two time stamps of a frame.
+ *
+ * @param start
+ * @param end
+ * @return latency in microseconds
  */
-void create_histogram(Rect& object_of_interest, int& histogram_size, const float*& pointer_histogram_ranges, Mat& hue, Mat& saturation_value_threshold, Mat& histogram, Mat& histogram_image) {
-
-    // Region of interest
-    Mat region_of_interest(hue, selection);
-
-    // Region of interest mask
-    Mat region_of_interest_mask(saturation_value_threshold, selection);
-
-    // Calculate histogram of region of interest
-    calcHist(&region_of_interest, 1, 0, region_of_interest_mask, histogram, 1, &histogram_size, &pointer_histogram_ranges);
-
-    // Normalize histogram
-    normalize(histogram, histogram, 0, 255, NORM_MINMAX);
-
-    // Set object of interest to selection
-    object_of_interest = selection;
-
-    // Begin tracking object
-    object_selected = 1;
+long get_latency(chrono::steady_clock::time_point start, chrono::steady_clock::time_point end) {
+    return chrono::duration_cast<chrono::microseconds>(end - start).count();
+}
 
-    // Create histogram visualization
-    histogram_image = Scalar::all(0);
-    int bins_width = histogram_image.cols / histogram_size;
-    Mat buffer(1, histogram_size, CV_8UC3);
-    for (int i = 0; i < histogram_size; i++)
-        buffer.at<Vec3b>(i) = Vec3b(saturate_cast<uchar> (i * 180. / histogram_size), 255, 255);
-    cvtColor(buffer, buffer, COLOR_HSV2BGR);
-    for (int i = 0; i < histogram_size; i++) {
-        int val = saturate_cast<int> (histogram.at<float> (i) * histogram_image.rows / 255);
-        rectangle(histogram_image, Point(i*bins_width, histogram_image.rows), Point((i + 1) * bins_width, histogram_image.rows - val), Scalar(buffer.at<Vec3b>(i)), -1, 8);
+/**
+ * Record latencies of the frame whose commands were just sent. Commands sent
+ * by the command thread are recorded by the command thread.
+ *
+ * @param frame
+ */
+void record_latency(PipelineFrame& frame) {
+    preprocess_latency.record(get_latency(frame.capture_time, frame.preprocess_time));
+    track_latency.record(get_latency(frame.preprocess_time, frame.track_time));
+    control_latency.record(get_latency(frame.track_time, frame.control_time));
+    if (command_thread == NULL) {
+        send_latency.record(get_latency(frame.control_time, frame.send_time));
+        total_latency.record(get_latency(frame.capture_time, frame.send_time));
     }
 }
 
 /**
- * Get orientation of the USV based on its location history.
+ * Get latency percentiles in microseconds as metadata of the mission log.
+ *
+ * @return
  */
-void get_orientation() {
+string get_latency_metadata() {
 
-    // Initialize curve
-    vector<Point> path_polynomial_approximation;
+    // Commands sent by the command thread have only the latency from capture
+    // of the frame of the pose they were computed from
+    string names[] = {"preprocess", "track", "control", "send", "total", "command"};
+    LatencyHistogram * histograms[] = {&preprocess_latency, &track_latency, &control_latency, &send_latency, &total_latency, command_thread != NULL ? &command_thread->get_send_latency() : NULL};
 
-    // Sort EMILY location history chronologically
-    Point * emily_location_history_sorted = new Point[settings->EMILY_LOCATION_HISTORY_SIZE];
+    ostringstream metadata;
 
-    // Initialize input vector (approxPolyDP takes only vectors and not arrays)
-    vector<Point> input_points;
-
-    for (int i = 0; i < settings->EMILY_LOCATION_HISTORY_SIZE; i++) {
-        emily_location_history_sorted[i] = emily_location_history[(emily_location_history_pointer + i) % settings->EMILY_LOCATION_HISTORY_SIZE];
-        input_points.push_back(emily_location_history_sorted[i]);
-    }
-
-    // Approximate location history with a polynomial curve
-    approxPolyDP(input_points, path_polynomial_approximation, 4, false);
-
-    // Draw polynomial curve
-    for (int i = 0; i < path_polynomial_approximation.size() - 1; i++) {
-        line(original_frame, path_polynomial_approximation[i], path_polynomial_approximation[i + 1], Scalar(255, 0, 255), settings->HEADING_LINE_THICKNESS, CV_AA);
+    for (int i = 0; i < 6 && histograms[i] != NULL; i++) {
+        metadata << names[i] << "_latency_us = count " << histograms[i]->get_count() << " mean " << (long) histograms[i]->get_mean() << " p50 " << histograms[i]->get_percentile(50) << " p90 " << histograms[i]->get_percentile(90) << " p99 " << histograms[i]->get_percentile(99) << " p99.9 " << histograms[i]->get_percentile(99.9) << " max " << histograms[i]->get_max() << "\n";
     }
 
-    // Difference in x axis
-    int delta_x_curve = path_polynomial_approximation[path_polynomial_approximation.size() - 1].x - path_polynomial_approximation[path_polynomial_approximation.size() - 2].x;
-
-    // Difference in y axis
-    int delta_Y_curve = path_polynomial_approximation[path_polynomial_approximation.size() - 1].y - path_polynomial_approximation[path_polynomial_approximation.size() - 2].y;
-
-    // Angle in degrees
-    double emily_angle_polynomial_approximation = atan2(delta_Y_curve, delta_x_curve) * (180 / M_PI);
+    return metadata.str();
+}
 
-    // Compute heading point
-    Point heading_point_polynomial_approximation;
-    heading_point_polynomial_approximation.x = (int) round(path_polynomial_approximation[path_polynomial_approximation.size() - 1].x + settings->HEADING_LINE_LENGTH * cos(emily_angle_polynomial_approximation * CV_PI / 180.0));
-    heading_point_polynomial_approximation.y = (int) round(path_polynomial_approximation[path_polynomial_approximation.size() - 1].y + settings->HEADING_LINE_LENGTH * sin(emily_angle_polynomial_approximation * CV_PI / 180.0));
+/**
+ * Get time of the frame in seconds. In replay mode it is the time of the frame
+ * in the video, so it does not depend on how fast the frames are processed.
+ * Otherwise it is the current wall clock time.
+ *
+ * @param frame
+ * @return seconds since the start of the video or since the epoch
+ */
+double get_frame_time(PipelineFrame& frame) {
 
-    // Draw line between current location and heading point
-    line(original_frame, emily_location, heading_point_polynomial_approximation, Scalar(255, 255, 0), settings->HEADING_LINE_THICKNESS, 8, 0);
+    if (settings->replay) {
+        return frame.frame_number / input_video_fps;
+    }
 
-    // Use curve polynomial tangent angle
-    emily_angle = emily_angle_polynomial_approximation;
+    return chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
 }
 
 /**
  * Create one log entry with current system status.
- * 
+ *
  * @param logger
- * @param current_commands
+ * @param frame
  */
-void create_log_entry(Logger* logger, Command* current_commands) {
-
-    // Log throttle
-    logger->log_throttle(current_commands->get_throttle());
-    logger->log_throttle("\n");
-
-    // Log rudder
-    logger->log_rudder(current_commands->get_rudder());
-    logger->log_rudder("\n");
+void create_log_entry(Logger* logger, PipelineFrame& frame) {
+
+    Command& current_commands = frame.commands;
+
+    LogRecord record;
+
+    // Current time
+    record.time = llround(get_frame_time(frame) * 1000000);
+
+    record.frame_number = frame.frame_number;
+
+    // EMILY location
+    record.emily_x = frame.emily_location.x;
+    record.emily_y = frame.emily_location.y;
+
+    // EMILY pose line segment
+    record.emily_pose_1_x = frame.emily_pose_point_1.x;
+    record.emily_pose_1_y = frame.emily_pose_point_1.y;
+    record.emily_pose_2_x = frame.emily_pose_point_2.x;
+    record.emily_pose_2_y = frame.emily_pose_point_2.y;
+
+    // Target location
+    record.target_x = frame.target_location.x;
+    record.target_y = frame.target_location.y;
+
+    record.emily_angle = frame.emily_angle;
+    record.distance_to_target = current_commands.get_distance_to_target();
+    record.angle_error_to_target = current_commands.get_angle_error_to_target();
+    record.throttle = current_commands.get_throttle();
+    record.rudder = current_commands.get_rudder();
+    record.status = frame.status;
+    record.reserved = 0;
+    record.time_to_target = frame.time_to_target;
+
+    // Latencies
+    record.preprocess_latency = get_latency(frame.capture_time, frame.preprocess_time);
+    record.track_latency = get_latency(frame.preprocess_time, frame.track_time);
+    record.control_latency = get_latency(frame.track_time, frame.control_time);
+    record.send_latency = command_thread != NULL ? LATENCY_NOT_MEASURED : get_latency(frame.control_time, frame.send_time);
+    record.total_latency = command_thread != NULL ? LATENCY_NOT_MEASURED : get_latency(frame.capture_time, frame.send_time);
+    record.reserved_2 = 0;
+
+    // Replay log is the same in every run, so without latencies and records
+    // are never dropped
+    if (settings->replay) {
+        record.preprocess_latency = LATENCY_NOT_MEASURED;
+        record.track_latency = LATENCY_NOT_MEASURED;
+        record.control_latency = LATENCY_NOT_MEASURED;
+        record.send_latency = LATENCY_NOT_MEASURED;
+        record.total_latency = LATENCY_NOT_MEASURED;
+        logger->log_waiting(record);
+        return;
+    }
 
-    // Get current time
-    time_t raw_time;
-    time(&raw_time);
-    struct tm * local_time;
-    local_time = localtime(&raw_time);
-    char current_time[40];
-    strftime(current_time, 40, "%Y%m%d%H%M%S", local_time);
-
-    // Log time
-    logger->log_general(current_time);
-    logger->log_general(" ");
-
-    // Log frame number
-    logger->log_general(frame_number);
-    logger->log_general(" ");
-
-    // Log EMILY location
-    logger->log_general(emily_location.x);
-    logger->log_general(" ");
-    logger->log_general(emily_location.y);
-    logger->log_general(" ");
-
-    // Log EMILY pose line segment
-    logger->log_general(emily_pose_point_1.x);
-    logger->log_general(" ");
-    logger->log_general(emily_pose_point_1.y);
-    logger->log_general(" ");
-    logger->log_general(emily_pose_point_2.x);
-    logger->log_general(" ");
-    logger->log_general(emily_pose_point_2.y);
-    logger->log_general(" ");
-
-    // Log target location
-    logger->log_general(target_location.x);
-    logger->log_general(" ");
-    logger->log_general(target_location.y);
-    logger->log_general(" ");
-
-    // Log EMILY angle
-    logger->log_general(emily_angle);
-    logger->log_general(" ");
-
-    // Log distance to target
-    logger->log_general(current_commands->get_distance_to_target());
-    logger->log_general(" ");
-
-    // Log error angle to target
-    logger->log_general(current_commands->get_angle_error_to_target());
-    logger->log_general(" ");
-
-    // Log throttle
-    logger->log_general(current_commands->get_throttle());
-    logger->log_general(" ");
-
-    // Log rudder
-    logger->log_general(current_commands->get_rudder());
-    logger->log_general(" ");
-
-    // Log status
-    logger->log_general(status);
-    logger->log_general(" ");
-
-    // Log time to target
-    logger->log_general(timeToTarget);
-    logger->log_general("\n");
+    logger->log(record);
 }
 
 /**
  * Update USV location history.
- * 
+ *
  * @param target_set
+ * @param location current USV location
  */
-void update_history(bool target_set) {
+void update_history(bool target_set, Point location) {
     if (target_set && !target_reached) {
 
         // Save current location to history
-        emily_location_history[emily_location_history_pointer] = emily_location;
+        emily_location_history[emily_location_history_pointer] = location;
 
         // Update circular array pointer
         emily_location_history_pointer = (emily_location_history_pointer + 1) % settings->EMILY_LOCATION_HISTORY_SIZE;
@@ -565,155 +641,138 @@ void update_history(bool target_set) {
 
 /**
  * Show current object of interest selection in the GUI.
+ *
+ * @param original_frame
  */
-void show_selection() {
+void show_selection(Mat& original_frame) {
     if (select_object && selection.width > 0 && selection.height > 0) {
-        Mat roi(original_frame, selection);
+        Mat roi(original_frame, selection & Rect(0, 0, original_frame.cols, original_frame.rows));
         bitwise_not(roi, roi);
     }
 }
 
 /**
- * Autonomously navigate the USV based on the UAV video feed to reach the target.
+ * Add time spent on one frame to the stage statistics.
+ *
+ * @param stage_statistics
+ * @param stage_start time when the stage started processing the frame
  */
-int main(int argc, char** argv) {
-
-    ////////////////////////////////////////////////////////////////////////////
-    // Output video initialization
-    //////////////////////////////////////////////////////////////////////////// 
-
-    // Get FPS of the input video
-    double input_video_fps = get_input_video_fps();
-
-    // Inogeni for some reason cannot correctly estimate the FPS.
-    // Therefore we use FPS equal to 7 which is approximate frequency of this algorithm.
-#ifdef INOGENI
-
-    input_video_fps = 7;
-
-#endif
-
-    // Get the size of input video
-    get_input_video_size();
-
-    // Output video name. It is in format year_month_day_hour_minute_second.avi.
-    time_t raw_time;
-    time(&raw_time);
-    struct tm * local_time;
-    local_time = localtime(&raw_time);
-    char output_file_name[40];
-    strftime(output_file_name, 40, "output/%Y_%m_%d_%H_%M_%S", local_time);
-    string output_file_name_string(output_file_name);
-
-    OutputVideo * output_video = new OutputVideo(input_video_fps, resized_video_size, output_file_name_string);
-    VideoWriter video_writer = output_video->get_video_writer();
-
-    ////////////////////////////////////////////////////////////////////////////
-    // Log
-    ////////////////////////////////////////////////////////////////////////////
-
-    Logger * logger = new Logger(output_file_name_string);
-
-#ifdef ANALYSIS
-
-    // Open error log file
-    ofstream error_log_file;
-    error_log_file.open(output_file_name_string + "_error.txt");
-
-#endif
-
-    ////////////////////////////////////////////////////////////////////////////
-    // GUI
-    ////////////////////////////////////////////////////////////////////////////
+void record_stage_time(StageStatistics& stage_statistics, chrono::steady_clock::time_point stage_start) {
+    stage_statistics.frames++;
+    stage_statistics.busy_time += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - stage_start).count();
+}
 
-    UserInterface * user_interface = new UserInterface(* settings, resized_video_size);
+/**
+ * Print statistics of one pipeline stage. The stage with the highest time per
+ * frame is the bottleneck.
+ *
+ * @param name
+ * @param stage_statistics
+ */
+void print_stage_statistics(string name, StageStatistics& stage_statistics) {
 
-    ////////////////////////////////////////////////////////////////////////////
-    // Local variables
-    ////////////////////////////////////////////////////////////////////////////
+    long frames = stage_statistics.frames;
+    double time_per_frame = frames > 0 ? stage_statistics.busy_time / 1000.0 / frames : 0;
 
-    // Frame with edits for blob detection
-    Mat blured_frame;
+    cout << name << ": " << frames << " frames, " << time_per_frame << " ms/frame" << endl;
+}
 
-    // Rectangle representing object of interest
-    Rect object_of_interest;
+/**
+ * Print statistics of one pipeline stage and its input queue. The input queue
+ * of the bottleneck stays full.
+ *
+ * @param name
+ * @param stage_statistics
+ * @param input_queue
+ */
+template <class T>
+void print_stage_statistics(string name, StageStatistics& stage_statistics, BoundedQueue<T> * input_queue) {
 
-    // Size of histogram of object of interest
-    int histogram_size = 16;
+    long frames = stage_statistics.frames;
+    double time_per_frame = frames > 0 ? stage_statistics.busy_time / 1000.0 / frames : 0;
 
-    // Histogram ranges
-    float histogram_ranges[] = {0, 180};
-    const float * pointer_histogram_ranges = histogram_ranges;
+    cout << name << ": " << frames << " frames, " << time_per_frame << " ms/frame, queue " << input_queue->size() << "/" << input_queue->get_capacity() << " (peak " << input_queue->get_peak_size() << ", mean " << input_queue->get_mean_size() << "), dropped " << input_queue->get_dropped() << endl;
+}
 
-    // HSV hue
-    Mat hue;
+/**
+ * Print statistics of all pipeline stages.
+ */
+void print_pipeline_statistics() {
+    if (paced_source != NULL) {
+        paced_source->print_statistics();
+    }
+    capture_thread->print_statistics();
+    tracker->print_preprocessing_statistics();
+
+    // Input of the preprocessing is the frame buffer of the capture thread
+    print_stage_statistics("Preprocess", preprocess_statistics);
+    print_stage_statistics("Track", track_statistics, track_queue);
+    print_stage_statistics("Control", control_statistics, control_queue);
+    print_stage_statistics("Render", render_statistics, render_queue);
+    if (command_thread != NULL) {
+        command_thread->print_statistics();
+    }
+    output_video->print_statistics();
+    logger->print_statistics();
+    if (settings->perf_counters) {
+        preprocess_counters.print_statistics();
+        track_counters.print_statistics();
+        control_counters.print_statistics();
+        render_counters.print_statistics();
+    }
+    if (settings->trace) {
+        cout << "Trace: dropped " << Trace::get_dropped_events() << " events" << endl;
+    }
+    cout << "Latency capture to preprocessed: " << preprocess_latency.to_string() << endl;
+    cout << "Latency preprocessed to tracked: " << track_latency.to_string() << endl;
+    cout << "Latency tracked to controlled: " << control_latency.to_string() << endl;
+    if (command_thread != NULL) {
+        cout << "Latency capture to sent by command thread: " << command_thread->get_send_latency().to_string() << endl;
+    } else {
+        cout << "Latency controlled to sent: " << send_latency.to_string() << endl;
+        cout << "Latency capture to sent: " << total_latency.to_string() << endl;
+    }
+}
 
-    // Threshold on saturation and value only. Hue is not thresholded.
-    Mat saturation_value_threshold;
+/**
+ * Preprocessing stage. Takes frames from the capture thread, blurs them and
+ * converts them to HSV color space.
+ */
+void preprocess_stage() {
 
-    // Histogram of object of interest
-    Mat histogram;
+    Trace::set_thread_name("Preprocess");
 
-    // Visualization of histogram
-    Mat histogram_image = Mat::zeros(200, 320, CV_8UC3);
+    if (settings->perf_counters) {
+        preprocess_counters.open();
+    }
 
-    // Back projection of histogram
-    Mat back_projection;
+    // Frame taken from the capture thread
+    CapturedFrame captured_frame;
 
-    // Paused mode
-    bool paused = false;
+    // Last frame taken from the video input. It is processed again while paused.
+    Mat last_frame;
 
 #ifdef WAIT_FOR_OBJECT_SELECTION
-    
+
     // This will prevent the algorithm from loading second frame if the first
     // frame was not used yet. Will be set to true after the algorithm uses the
     // first frame
     bool first_frame_used = false;
-    
-#endif
-    
-    ////////////////////////////////////////////////////////////////////////////
-    // Initialization of communication
-    ////////////////////////////////////////////////////////////////////////////
-
-    Communication * communication = new Communication(settings->IP_ADDRESS, settings->PORT);
-
-    ////////////////////////////////////////////////////////////////////////////
-    // Initialization of camera distortion parameters
-    ////////////////////////////////////////////////////////////////////////////
 
-#ifdef INVERSE_PERSPECTIVE_WARP
-    Undistort * undistort = new Undistort(* settings, resized_video_size);
 #endif
 
-    ////////////////////////////////////////////////////////////////////////////
-    // Tracking
-    ////////////////////////////////////////////////////////////////////////////
-
-    //    // Load first frame
-    //    Mat first;
-    //    video_capture >> first;
+    while (running) {
 
-#ifdef WAIT_FOR_OBJECT_SELECTION
-    
-    // Always read the first frame so that the object of interest can be
-    // selected. First frame has to be stored in its own variable because the
-    // algorithm draws into original_frame and therefore it cannot be reused
-    // in the next iteration.
-    Mat first_frame;
-    video_capture >> first_frame;
-    frame_number++;
-    
-#endif
+        PipelineFrame frame;
 
-    // Iterate over each frame from the video input and wait between iterations.
-    while (waitKey(1) != 27) {
+        // New frame was taken from the video input
+        bool new_frame = false;
 
         // If not paused
         if (!paused) {
 
 #ifdef WAIT_FOR_OBJECT_SELECTION
-            
+
             // Only load new frames after object of interest was selected and is being tracked (-1 is only selected but not tracked yet, 0 is not selected at all)
             if (object_selected == 1) {
 
@@ -722,55 +781,87 @@ int main(int argc, char** argv) {
 
                     // Used the first frame (it is important to use copyTo,
                     // otherwise it will be assigned by reference and it will make the first frame dirty.
-                    first_frame.copyTo(original_frame);
-                    
+                    first_frame.copyTo(frame.original_frame);
+                    frame.frame_number = frame_number;
+
                     // Now the first frame was used, so next time load the second frame
                     first_frame_used = true;
 
                 } else {
 
-                    // Read one frame
-                    video_capture >> original_frame;
+                    // Take next frame from the capture thread
+                    if (!capture_thread->read(captured_frame)) {
+                        break;
+                    }
 
-                    // Increase frame number counter
-                    frame_number++;
+                    frame.original_frame = captured_frame.frame;
+                    frame.frame_number = captured_frame.frame_number;
+                    frame.capture_time = captured_frame.capture_time;
+                    new_frame = true;
 
                 }
 
-                // End if frame is empty
-                if (original_frame.empty()) {
-                    break;
-                }
-                
             } else {
-             
+
                 // Object is not selected so still use the first frame
-                first_frame.copyTo(original_frame);
-                
-            }
-            
-#else
+                first_frame.copyTo(frame.original_frame);
+                frame.frame_number = frame_number;
 
-            // Read one frame
-            video_capture >> original_frame;
+            }
 
-            // Increase frame number counter
-            frame_number++;
+#else
 
-            // End if frame is empty
-            if (original_frame.empty()) {
+            // Take next frame from the capture thread
+            if (!capture_thread->read(captured_frame)) {
                 break;
             }
 
+            frame.original_frame = captured_frame.frame;
+            frame.frame_number = captured_frame.frame_number;
+            frame.capture_time = captured_frame.capture_time;
+            new_frame = true;
+
 #endif
 
+            last_frame = frame.original_frame;
+
+        } else {
+
+            // Process the last frame again
+            last_frame.copyTo(frame.original_frame);
+
         }
 
-        ////////////////////////////////////////////////////////////////////////
-        // Global flags
-        ////////////////////////////////////////////////////////////////////////
+        // End if frame is empty
+        if (frame.original_frame.empty()) {
+            break;
+        }
+
+        // The same frame is processed again, so do not process it faster than
+        // the GUI can show it
+        if (!new_frame) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+            frame.capture_time = chrono::steady_clock::now();
+        }
+
+        frame.paused = paused;
+
+#ifdef WAIT_FOR_OBJECT_SELECTION
+
+        // Only create log entry after the object been selected and first frame used for tracking
+        frame.loggable = object_selected && first_frame_used;
+
+#else
+
+        frame.loggable = true;
+
+#endif
+
+        chrono::steady_clock::time_point stage_start = chrono::steady_clock::now();
 
-        bool target_set = target_location.x != 0 && target_location.y != 0;
+        TraceScope trace_scope("Preprocess");
+
+        preprocess_counters.start();
 
         ////////////////////////////////////////////////////////////////////////
         // Preprocessing
@@ -778,58 +869,124 @@ int main(int argc, char** argv) {
 
         if (resize_video) {
 
-            // Resize the input
-            // TODO enable resize
-            //resize(original_frame, original_frame, resized_video_size, 0, 0, INTER_LANCZOS4);
+            // Resize the input. Area interpolation is the fastest one without
+            // aliasing when downsampling. Tracking, drawing, display and video
+            // output all use the resized frame.
+            resize(frame.original_frame, frame.original_frame, resized_video_size, 0, 0, INTER_AREA);
 
         }
 
-        // Apply Gaussian blur filter
-        GaussianBlur(original_frame, blured_frame, Size(settings->blur_kernel_size, settings->blur_kernel_size), 0, 0);
+        // Only the region around tracked EMILY has to be preprocessed
+        Rect full_frame(0, 0, frame.original_frame.cols, frame.original_frame.rows);
 
-        // Convert to HSV color space
-        Mat HSV_frame;
-        cvtColor(blured_frame, HSV_frame, COLOR_BGR2HSV);
+        // Pixels preprocessed in this frame, for the hardware counters
+        long processed_pixels;
 
-        // Equalize on value (V)
-        equalize(HSV_frame);
+#ifdef CAMSHIFT
 
-        ////////////////////////////////////////////////////////////////////////
-        // Distortion and Inverse Perspective Warping
-        ////////////////////////////////////////////////////////////////////////
+        if (object_selected == 1 && settings->pyramid_levels > 0) {
 
-#ifdef INVERSE_PERSPECTIVE_WARP
+            // Coarse to fine tracking. Only the coarsest level is preprocessed
+            // here, the refinement region is known after coarse tracking.
+            tracker->preprocess_pyramid(frame.original_frame, frame.pyramid, frame.HSV_frame, frame.equalization_table);
+
+            processed_pixels = frame.HSV_frame.total();
+
+        } else {
+
+            frame.search_region = object_selected == 1 ? tracker->get_search_region(full_frame.size()) : full_frame;
+
+            if (object_selected == 1 && settings->fused_back_projection) {
+
+                // Blur and back project in a single pass. No HSV frame.
+                tracker->preprocess_back_projection(frame.original_frame, frame.search_region, frame.blured_frame, frame.back_projection);
+
+            } else {
 
-        // Undistort camera
-        // TODO enable undistort
-        //undistort->undistort_camera(HSV_frame, original_frame);
+                // Blur, convert to HSV color space and equalize on value (V)
+                tracker->preprocess(frame.original_frame, frame.search_region, frame.blured_frame, frame.HSV_frame);
 
-        // Camera projection matrix
-        // TODO change to automatic undistort
-        undistort->undistort_perspective_manual(HSV_frame, original_frame);
+            }
+
+            processed_pixels = frame.search_region.area();
+
+        }
+
+#else
+
+        frame.search_region = full_frame;
+
+        // Blur, convert to HSV color space and equalize on value (V)
+        tracker->preprocess(frame.original_frame, frame.search_region, frame.blured_frame, frame.HSV_frame);
+
+        processed_pixels = frame.search_region.area();
 
 #endif
 
+        preprocess_counters.stop(processed_pixels);
+
+        record_stage_time(preprocess_statistics, stage_start);
+
+        frame.preprocess_time = chrono::steady_clock::now();
+
+        // Waits if tracking is behind
+        TraceScope push_scope("Push");
+        if (!track_queue->push(frame)) {
+            break;
+        }
+
+        // In replay the next frame is preprocessed only after this one was
+        // tracked, with the search region and equalization it left behind
+        long tracked_frame_number;
+        if (replay_handshake != NULL && !replay_handshake->pop(tracked_frame_number)) {
+            break;
+        }
+    }
+
+    track_queue->close();
+}
+
+/**
+ * Tracking stage. Finds EMILY in the preprocessed frames.
+ */
+void track_stage() {
+
+    Trace::set_thread_name("Track");
+
+    if (settings->perf_counters) {
+        track_counters.open();
+    }
+
+    PipelineFrame frame;
+
+    while (track_queue->pop(frame)) {
+
+        chrono::steady_clock::time_point stage_start = chrono::steady_clock::now();
+
+        TraceScope trace_scope("Track");
+
+        track_counters.start();
+
         ////////////////////////////////////////////////////////////////////////
         // Thresholding
         ////////////////////////////////////////////////////////////////////////
 
-#ifndef CAMSHIFT        
+#ifndef CAMSHIFT
 
         // Threshold on lower red
         Mat lower_red_threshold;
-        inRange(HSV_frame, cv::Scalar(settings->hue_1_min, settings->saturation_min, settings->value_min), cv::Scalar(settings->hue_1_max, settings->saturation_max, settings->value_max), lower_red_threshold);
+        inRange(frame.HSV_frame, cv::Scalar(settings->hue_1_min, settings->saturation_min, settings->value_min), cv::Scalar(settings->hue_1_max, settings->saturation_max, settings->value_max), lower_red_threshold);
 
         // Threshold on upper red
         Mat upper_red_threshold;
-        inRange(HSV_frame, cv::Scalar(settings->hue_2_min, settings->saturation_min, settings->value_min), cv::Scalar(settings->hue_2_max, settings->saturation_max, settings->value_max), upper_red_threshold);
+        inRange(frame.HSV_frame, cv::Scalar(settings->hue_2_min, settings->saturation_min, settings->value_min), cv::Scalar(settings->hue_2_max, settings->saturation_max, settings->value_max), upper_red_threshold);
 
         // Add thresholds together
-        Mat threshold;
+        Mat& threshold = frame.threshold;
         addWeighted(lower_red_threshold, 1.0, upper_red_threshold, 1.0, 0.0, threshold);
 
         // Erode to filter noise
-        Mat eroded_dilated_threshold;
+        Mat& eroded_dilated_threshold = frame.eroded_dilated_threshold;
         Mat erode_element = getStructuringElement(MORPH_RECT, Size(settings->erode_size, settings->erode_size));
         erode(threshold, eroded_dilated_threshold, erode_element);
         erode(eroded_dilated_threshold, eroded_dilated_threshold, erode_element);
@@ -1009,90 +1166,81 @@ int main(int argc, char** argv) {
                     // Get minimum ellipse
                     min_ellipse = fitEllipse(Mat(contours[max_area_contour_index]));
 
-                    // Draw ellipse
-                    //ellipse(original_frame, min_ellipse, Scalar(255,0,0), 2, 8 );
-
-                    // Draw pose
-                    user_interface->draw_principal_axis(min_ellipse, original_frame);
-
-                    ////////////////////////////////////////////////////////////
-                    // Draw EMILY location in the image
-                    ////////////////////////////////////////////////////////////
+                    // Save EMILY pose. It is drawn by the render stage.
+                    frame.tracking_box = min_ellipse;
+                    Tracker::get_principal_axis(min_ellipse, frame.emily_pose_point_1, frame.emily_pose_point_2);
 
                     // Compute object size
-                    double object_size = get_size(min_ellipse);
-
-                    // Draw object
-                    user_interface->draw_position(max_area_object_x, max_area_object_y, object_size, original_frame);
+                    frame.object_size = get_size(min_ellipse);
 
                     // Save EMILY location
                     emily_location = Point(max_area_object_x, max_area_object_y);
+                    frame.object_found = true;
                 }
             }
-        } else {
-
-            // EMILY was not found in the image
-            putText(original_frame, "EMILY not found!", Point(50, 50), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 0, 255), 2);
-
         }
 
-#else       
+#else
 
-        if (!paused) {
+        if (!frame.paused) {
 
             if (object_selected) {
 
-                // Threshold on saturation and value, but not on hue
-                inRange(HSV_frame, Scalar(0, settings->saturation_min, settings->value_min), Scalar(180, settings->saturation_max, settings->value_max), saturation_value_threshold);
-
-                // Mix channels
-                int chanels[] = {0, 0};
-                hue.create(HSV_frame.size(), HSV_frame.depth());
-                mixChannels(&HSV_frame, 1, &hue, 1, chanels, 1);
-
                 // Object does not have histogram yet, so create it
                 if (object_selected < 0) {
 
-                    // Create histogram of region of interest
-                    create_histogram(object_of_interest, histogram_size, pointer_histogram_ranges, hue, saturation_value_threshold, histogram, histogram_image);
+                    // Get the selection made in the GUI
+                    Rect current_selection;
+                    {
+                        lock_guard<mutex> lock(operator_input_mutex);
+                        current_selection = selection;
+                    }
+
+                    // The selection could have been restarted in the meantime.
+                    // Histogram can only be created from a full HSV frame,
+                    // frames preprocessed for the previous object are skipped.
+                    if (current_selection.area() > 0 && frame.search_region.size() == frame.original_frame.size() && !frame.HSV_frame.empty()) {
 
+                        // Create histogram of region of interest
+                        tracker->select(frame.HSV_frame, current_selection, frame.histogram_image);
+
+                        // Begin tracking object
+                        object_selected = 1;
+
+                    }
                 }
 
-                // Calculate back projection
-                calcBackProject(&hue, 1, 0, histogram, back_projection, &pointer_histogram_ranges);
+                if (object_selected > 0) {
 
-                // Apply back projection on saturation value threshold
-                back_projection &= saturation_value_threshold;
+                    // CamShift algorithm
+                    if (!frame.pyramid.empty()) {
 
-                // CamShift algorithm
-                RotatedRect tracking_box = CamShift(back_projection, object_of_interest, TermCriteria(TermCriteria::EPS | TermCriteria::COUNT, 10, 1));
+                        // Coarse to fine
+                        frame.object_found = tracker->track_pyramid(frame.pyramid, frame.HSV_frame, frame.equalization_table, frame.search_region, frame.tracking_box, frame.back_projection);
 
-                // Object of interest are is too small, so inflate the tracking box
-                if (object_of_interest.area() <= 1) {
-                    int cols = back_projection.cols;
-                    int rows = back_projection.rows;
-                    int new_rectangle_size = (MIN(cols, rows) + 5) / 6;
-                    object_of_interest = Rect(object_of_interest.x - new_rectangle_size, object_of_interest.y - new_rectangle_size, object_of_interest.x + new_rectangle_size, object_of_interest.y + new_rectangle_size) & Rect(0, 0, cols, rows);
-                }
+                    } else if (frame.HSV_frame.empty()) {
 
-                // We are in back projection mode
-                if (back_projection_mode) {
-                    cvtColor(back_projection, original_frame, COLOR_GRAY2BGR);
-                }
+                        // Back projection was computed by the preprocessing
+                        frame.object_found = tracker->track_back_projection(frame.back_projection, frame.search_region, frame.tracking_box);
+
+                    } else {
 
-                // Draw bounding ellipse
-                if (tracking_box.size.height > 0 && tracking_box.size.width > 0) {
-                    ellipse(original_frame, tracking_box, settings->LOCATION_COLOR, settings->LOCATION_THICKNESS, LINE_AA);
+                        frame.object_found = tracker->track(frame.HSV_frame, frame.search_region, frame.tracking_box, frame.back_projection);
 
-                    // Draw cross hairs
-                    user_interface->draw_position(tracking_box.center.x, tracking_box.center.y, min(tracking_box.size.width, tracking_box.size.height) / 2, original_frame);
+                    }
 
-                    // Draw pose
-                    user_interface->draw_principal_axis(tracking_box, original_frame);
+                    if (frame.object_found) {
 
-                    // Save EMILY location
-                    emily_location = Point(tracking_box.center.x, tracking_box.center.y);
+                        // Size of cross hairs
+                        frame.object_size = min(frame.tracking_box.size.width, frame.tracking_box.size.height) / 2;
 
+                        // Save EMILY pose
+                        Tracker::get_principal_axis(frame.tracking_box, frame.emily_pose_point_1, frame.emily_pose_point_2);
+
+                        // Save EMILY location
+                        emily_location = Point(frame.tracking_box.center.x, frame.tracking_box.center.y);
+
+                    }
                 }
 
             }
@@ -1102,44 +1250,97 @@ int main(int argc, char** argv) {
             paused = false;
         }
 
-        // Show the selection
-        show_selection();
+#endif
+
+        // Last known EMILY location
+        frame.emily_location = emily_location;
 
-        // Show the histogram
-        user_interface->show_histogram(histogram_image);
+        track_counters.stop(frame.search_region.area());
 
-        char character = (char) waitKey(10);
-        if (character == 27)
+        record_stage_time(track_statistics, stage_start);
+
+        frame.track_time = chrono::steady_clock::now();
+
+        // Let the preprocessing continue with the next frame
+        if (replay_handshake != NULL) {
+            replay_handshake->push(frame.frame_number);
+        }
+
+        // Waits if control is behind
+        TraceScope push_scope("Push");
+        if (!control_queue->push(frame)) {
             break;
-        switch (character) {
-            case 'b':
+        }
+    }
 
-                // Toggle back projection mode
-                back_projection_mode = !back_projection_mode;
+    if (replay_handshake != NULL) {
+        replay_handshake->close();
+    }
 
-                break;
-            case 'c':
+    control_queue->close();
+}
 
-                // Stop tracking
-                object_selected = 0;
-                histogram_image = Scalar::all(0);
+/**
+ * Control stage. Estimates EMILY heading, computes control commands and sends
+ * them to EMILY.
+ */
+void control_stage() {
 
-                break;
-            case 'p':
+    Trace::set_thread_name("Control");
 
-                // Toggle pause
-                paused = !paused;
+    if (settings->perf_counters) {
+        control_counters.open();
+    }
 
-                break;
+    PipelineFrame frame;
+
+    while (control_queue->pop(frame)) {
+
+        chrono::steady_clock::time_point stage_start = chrono::steady_clock::now();
+
+        TraceScope trace_scope("Control");
+
+        control_counters.start();
+
+        ////////////////////////////////////////////////////////////////////////
+        // Global flags
+        ////////////////////////////////////////////////////////////////////////
+
+        // Get the target selected in the GUI
+        {
+            lock_guard<mutex> lock(operator_input_mutex);
+            frame.target_location = target_location;
+        }
+
+        bool target_set = frame.target_location.x != 0 && frame.target_location.y != 0;
+
+        ////////////////////////////////////////////////////////////////////////
+        // Distortion and Inverse Perspective Warping
+        ////////////////////////////////////////////////////////////////////////
+
+        frame.ground_emily_location = frame.emily_location;
+        frame.ground_target_location = frame.target_location;
+
+#ifdef INVERSE_PERSPECTIVE_WARP
+
+        // Only EMILY location and the target are mapped to the ground plane,
+        // the frames are not warped. Zero means unknown location.
+        if (frame.emily_location.x != 0 && frame.emily_location.y != 0) {
+            frame.ground_emily_location = undistort->image_to_ground(frame.emily_location);
+        }
+        if (target_set) {
+            frame.ground_target_location = undistort->image_to_ground(frame.target_location);
         }
 
 #endif
 
+        Point& emily_location = frame.ground_emily_location;
+
         ////////////////////////////////////////////////////////////////////////
         // Compute heading
         ////////////////////////////////////////////////////////////////////////
 
-        update_history(target_set);
+        update_history(target_set, emily_location);
 
         // Average of all the angles from points in history to current angle
         ////////////////////////////////////////////////////////////////////////
@@ -1210,143 +1411,11 @@ int main(int argc, char** argv) {
             ////////////////////////////////////////////////////////////////////////
 
             // Get orientation of EMILY
-            get_orientation();
-
-        }
-
-        ////////////////////////////////////////////////////////////////////////
-        // Show results
-        ////////////////////////////////////////////////////////////////////////
-
-        // Simple blob detector
-        ////////////////////////////////////////////////////////////////////////
-
-        //        drawKeypoints(original_frame, keypoints, original_frame, Scalar(0,0,255), DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
-        //        
-        //        userInterface->show_main(original_frame);
-
-        // Contours
-        ////////////////////////////////////////////////////////////////////////
-
-        //        for(int contour = 0; contour >= 0; contour = hierarchy[contour][0]) {
-        //            drawContours(original_frame, contours, contour, Scalar(255, 0, 0), CV_FILLED, 8, hierarchy);
-        //        }
-        //        
-        //        userInterface->show_main(original_frame);
-
-        // Threshold
-        ////////////////////////////////////////////////////////////////////////
-
-        //        userInterface->show_main(threshold);
-
-        // Original image
-        ////////////////////////////////////////////////////////////////////////
-
-        //        userInterface->show_main(original_frame);
-
-        // Main Window
-        ////////////////////////////////////////////////////////////////////////
-
-        // Show target location
-        user_interface->draw_target(original_frame, target_location);
-
-        // Get status as a string message
-        user_interface->print_status(original_frame, status, timeToTarget);
-
-#ifndef CAMSHIFT        
-
-        // Get size of each frame to be displayed
-        Size blured_frame_size = blured_frame.size();
-        Size threshold_size = threshold.size();
-        Size eroded_dilated_threshold_size = eroded_dilated_threshold.size();
-        Size original_frame_size = original_frame.size();
-
-        // Convert threshold to RGB color space
-        Mat threshold_color;
-        cvtColor(threshold, threshold_color, CV_GRAY2RGB);
-
-        // Convert eroded dilated threshold to RGB color space
-        Mat eroded_dilated_threshold_color;
-        cvtColor(eroded_dilated_threshold, eroded_dilated_threshold_color, CV_GRAY2RGB);
-
-#ifndef FOUR_FRAME_MODE
-
-        // Initialize output frame for 2 frames
-        Mat output(threshold_size.height, threshold_size.width + original_frame_size.width, original_frame.type());
-
-        // Initialize helper frames for 2 frames
-        Mat threshold_new(output, Rect(0, 0, threshold_size.width, threshold_size.height));
-        Mat original_frame_new(output, Rect(threshold_size.width, 0, original_frame_size.width, original_frame_size.height));
-
-        // Copy frames to helper frames for 2 frames
-        threshold_color.copyTo(threshold_new);
-        original_frame.copyTo(original_frame_new);
-
-#else
-
-        // Initialize output frame for 4 frames
-        Mat output(blured_frame_size.height + eroded_dilated_threshold_size.height, blured_frame_size.width + threshold_size.width, original_frame.type());
-
-        // Initialize helper frames for 4 frames
-        Mat blured_frame_new(output, Rect(0, 0, blured_frame_size.width, blured_frame_size.height));
-        Mat threshold_new(output, Rect(blured_frame_size.width, 0, threshold_size.width, threshold_size.height));
-        Mat eroded_dilated_threshold_new(output, Rect(0, blured_frame_size.height, eroded_dilated_threshold_size.width, eroded_dilated_threshold_size.height));
-        Mat original_frame_new(output, Rect(eroded_dilated_threshold_size.width, blured_frame_size.height, original_frame_size.width, original_frame_size.height));
-
-        // Copy frames to helper frames for 4 frames
-        blured_frame.copyTo(blured_frame_new);
-        threshold_color.copyTo(threshold_new);
-        eroded_dilated_threshold_color.copyTo(eroded_dilated_threshold_new);
-        original_frame.copyTo(original_frame_new);
-
-#endif
-
-#else
-
-        // Copy the frame to output
-        Mat output;
-        original_frame.copyTo(output);
-
-#endif
-
-        // Show output frame in the main window
-        user_interface->show_main(output);
-
-        ////////////////////////////////////////////////////////////////////////
-        // Video output
-        ////////////////////////////////////////////////////////////////////////
-
-        // Write the frame to the output video
-        video_writer << original_frame;
-        //video_writer << threshold_color;
-
-        ////////////////////////////////////////////////////////////////////////
-        // Quantitative analysis
-        ////////////////////////////////////////////////////////////////////////
-
-#ifdef ANALYSIS
-
-        // The objective of this test is to select EMILY and then keep the
-        // cursor in EMILY's center. The program will compute distance error
-        // between the cursor and tracked location.
+            get_orientation(frame);
 
-        // Only compute the error if object is selected
-
-#ifdef CAMSHIFT
-        if (object_selected) {
-#endif
-
-            // Compute distance of EMILY from the cursor
-            double distance_error = sqrt(pow(emily_location.x - mouse_location.x, 2) + pow(emily_location.y - mouse_location.y, 2));
-
-            // Log the distance error
-            error_log_file << distance_error << endl;
-
-#ifdef CAMSHIFT
         }
-#endif
 
-#endif
+        frame.emily_angle = emily_angle;
 
         ////////////////////////////////////////////////////////////////////////
         // Control
@@ -1370,10 +1439,10 @@ int main(int argc, char** argv) {
             if (target_reached_now == true) {
 
                 // End timer
-                time(&endTarget);
+                endTarget = get_frame_time(frame);
 
                 // Compute elapsed time
-                timeToTarget = difftime(endTarget, startTarget);
+                timeToTarget = endTarget - startTarget;
 
                 // Reset the flag
                 target_reached_now = false;
@@ -1397,12 +1466,13 @@ int main(int argc, char** argv) {
                 status = 2;
 
                 // Start timer
-                time(&startTarget);
+                startTarget = get_frame_time(frame);
 
             } else {
 
                 // Get rudder and throttle
-                current_commands = control->get_control_commands(emily_location.x, emily_location.y, emily_angle, target_location.x, target_location.y);
+                delete current_commands;
+                current_commands = control->get_control_commands(emily_location.x, emily_location.y, emily_angle, frame.ground_target_location.x, frame.ground_target_location.y);
 
                 // Set status
                 status = 3;
@@ -1431,42 +1501,963 @@ int main(int argc, char** argv) {
         // Communication
         ////////////////////////////////////////////////////////////////////////
 
-        communication->send_command(* current_commands);
+        frame.control_time = chrono::steady_clock::now();
 
-        ////////////////////////////////////////////////////////////////////////
-        // Log output
-        ////////////////////////////////////////////////////////////////////////
+        if (command_thread != NULL) {
+
+            // Sent by the command thread at its own rate, which records the
+            // latency of sending
+            command_thread->update(* current_commands, status == 3, emily_location, emily_angle, frame.ground_target_location, frame.capture_time);
+
+        } else {
+
+            TraceScope send_scope("Send");
+            communication->send_command(* current_commands);
+
+        }
+
+        frame.send_time = chrono::steady_clock::now();
+
+        record_latency(frame);
 
         // Debugging
         //cout << "Throttle: " << current_commands->get_throttle() << " Rudder: " << current_commands->get_rudder() << endl;
 
-#ifdef WAIT_FOR_OBJECT_SELECTION
-        
-        // Only create log entry after the object been selected and first frame used for tracking
-        if (object_selected && first_frame_used) {
-            
-#endif         
-               
-        // Log the data
-        create_log_entry(logger, current_commands);
-        
-#ifdef WAIT_FOR_OBJECT_SELECTION
-        
+        frame.commands = * current_commands;
+        frame.status = status;
+        frame.time_to_target = timeToTarget;
+
+        delete current_commands;
+
+        ////////////////////////////////////////////////////////////////////////
+        // Hand over to logging and rendering
+        ////////////////////////////////////////////////////////////////////////
+
+        // Neither of these blocks. The log record is only copied to the log
+        // buffer and the render queue drops the oldest frames if full.
+        if (frame.loggable) {
+            TraceScope log_scope("Log");
+            create_log_entry(logger, frame);
         }
-            
-#endif        
-        
+
+        control_counters.stop(0);
+
+        record_stage_time(control_statistics, stage_start);
+
+        render_queue->push(frame);
     }
 
-    // Close logs
-    delete logger;
+    render_queue->close();
+}
 
-    // Stop EMILY and close communication
-    delete communication;
+/**
+ * Show the frame in the main window. Without CamShift, thresholds are shown
+ * next to it.
+ *
+ * @param frame
+ */
+void show_output(PipelineFrame& frame) {
 
-    // Announce that the processing was finished
-    cout << "Processing finished!" << endl;
+    Mat& original_frame = frame.original_frame;
 
-    // Clean return
-    return 0;
-}
\ No newline at end of file
+#ifndef CAMSHIFT
+
+    Mat& blured_frame = frame.blured_frame;
+    Mat& threshold = frame.threshold;
+    Mat& eroded_dilated_threshold = frame.eroded_dilated_threshold;
+
+    // Get size of each frame to be displayed
+    Size blured_frame_size = blured_frame.size();
+    Size threshold_size = threshold.size();
+    Size eroded_dilated_threshold_size = eroded_dilated_threshold.size();
+    Size original_frame_size = original_frame.size();
+
+    // Convert threshold to RGB color space
+    Mat threshold_color;
+    cvtColor(threshold, threshold_color, CV_GRAY2RGB);
+
+    // Convert eroded dilated threshold to RGB color space
+    Mat eroded_dilated_threshold_color;
+    cvtColor(eroded_dilated_threshold, eroded_dilated_threshold_color, CV_GRAY2RGB);
+
+#ifndef FOUR_FRAME_MODE
+
+    // Initialize output frame for 2 frames
+    Mat output(threshold_size.height, threshold_size.width + original_frame_size.width, original_frame.type());
+
+    // Initialize helper frames for 2 frames
+    Mat threshold_new(output, Rect(0, 0, threshold_size.width, threshold_size.height));
+    Mat original_frame_new(output, Rect(threshold_size.width, 0, original_frame_size.width, original_frame_size.height));
+
+    // Copy frames to helper frames for 2 frames
+    threshold_color.copyTo(threshold_new);
+    original_frame.copyTo(original_frame_new);
+
+#else
+
+    // Initialize output frame for 4 frames
+    Mat output(blured_frame_size.height + eroded_dilated_threshold_size.height, blured_frame_size.width + threshold_size.width, original_frame.type());
+
+    // Initialize helper frames for 4 frames
+    Mat blured_frame_new(output, Rect(0, 0, blured_frame_size.width, blured_frame_size.height));
+    Mat threshold_new(output, Rect(blured_frame_size.width, 0, threshold_size.width, threshold_size.height));
+    Mat eroded_dilated_threshold_new(output, Rect(0, blured_frame_size.height, eroded_dilated_threshold_size.width, eroded_dilated_threshold_size.height));
+    Mat original_frame_new(output, Rect(eroded_dilated_threshold_size.width, blured_frame_size.height, original_frame_size.width, original_frame_size.height));
+
+    // Copy frames to helper frames for 4 frames
+    blured_frame.copyTo(blured_frame_new);
+    threshold_color.copyTo(threshold_new);
+    eroded_dilated_threshold_color.copyTo(eroded_dilated_threshold_new);
+    original_frame.copyTo(original_frame_new);
+
+#endif
+
+#else
+
+    // The frame is not modified after this point, so it can be shown directly
+    Mat& output = original_frame;
+
+#endif
+
+    // Show output frame in the main window
+    user_interface->show_main(output);
+}
+
+/**
+ * Publish the frame and tracking state to shared memory for the viewer.
+ *
+ * @param frame
+ */
+void publish_frame(PipelineFrame& frame) {
+
+    SharedFrameState state;
+    state.frame_number = frame.frame_number;
+    state.object_found = frame.object_found;
+    state.emily_location = frame.emily_location;
+    state.target_location = frame.target_location;
+    state.emily_angle = frame.emily_angle;
+    state.throttle = frame.commands.get_throttle();
+    state.rudder = frame.commands.get_rudder();
+    state.status = frame.status;
+    state.time_to_target = frame.time_to_target;
+
+    shared_frames->publish(frame.original_frame, state);
+
+    // Histogram is only published when a new one was created
+    if (!frame.histogram_image.empty()) {
+        shared_frames->publish_histogram(frame.histogram_image);
+    }
+}
+
+/**
+ * Render stage. Draws tracking information into the frame and shows it in the
+ * GUI. Runs on the main thread because of the GUI.
+ *
+ * @param frame
+ */
+void render(PipelineFrame& frame) {
+
+    chrono::steady_clock::time_point stage_start = chrono::steady_clock::now();
+
+    TraceScope trace_scope("Render");
+
+    render_counters.start();
+
+    Mat& original_frame = frame.original_frame;
+
+    // Frames of the frame cache are mapped read-only, so they are copied
+    // before drawing. Earlier stages read them in place.
+    if (frame_cache != NULL && frame_cache->is_mapped(original_frame)) {
+        original_frame = original_frame.clone();
+    }
+
+#ifndef CAMSHIFT
+
+    if (frame.object_found) {
+
+        // Draw pose
+        user_interface->draw_principal_axis(frame.emily_pose_point_1, frame.emily_pose_point_2, original_frame);
+
+        // Draw object
+        user_interface->draw_position(frame.emily_location.x, frame.emily_location.y, frame.object_size, original_frame);
+
+    } else {
+
+        // EMILY was not found in the image
+        putText(original_frame, "EMILY not found!", Point(50, 50), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 0, 255), 2);
+
+    }
+
+#else
+
+    // We are in back projection mode
+    if (back_projection_mode && !frame.back_projection.empty()) {
+
+        // Back projection covers only the search region
+        Mat back_projection_color;
+        cvtColor(frame.back_projection, back_projection_color, COLOR_GRAY2BGR);
+        original_frame = Scalar::all(0);
+        back_projection_color.copyTo(original_frame(frame.search_region));
+    }
+
+    // Draw bounding ellipse
+    if (frame.object_found) {
+        ellipse(original_frame, frame.tracking_box, settings->LOCATION_COLOR, settings->LOCATION_THICKNESS, LINE_AA);
+
+        // Draw cross hairs
+        user_interface->draw_position(frame.tracking_box.center.x, frame.tracking_box.center.y, frame.object_size, original_frame);
+
+        // Draw pose
+        user_interface->draw_principal_axis(frame.emily_pose_point_1, frame.emily_pose_point_2, original_frame);
+    }
+
+    // Show the selection
+    show_selection(original_frame);
+
+    // Histogram was created for new selection
+    if (!frame.histogram_image.empty()) {
+        histogram_image = frame.histogram_image;
+    }
+
+    // Show the histogram
+    user_interface->show_histogram(histogram_image);
+
+#endif
+
+    ////////////////////////////////////////////////////////////////////////
+    // Heading
+    ////////////////////////////////////////////////////////////////////////
+
+    if (frame.heading_estimated) {
+
+        vector<Point> path_polynomial_approximation = frame.path_polynomial_approximation;
+        Point heading_point = frame.heading_point;
+
+#ifdef INVERSE_PERSPECTIVE_WARP
+
+        // Heading was estimated on the ground plane
+        for (int i = 0; i < path_polynomial_approximation.size(); i++) {
+            path_polynomial_approximation[i] = undistort->ground_to_image(path_polynomial_approximation[i]);
+        }
+        heading_point = undistort->ground_to_image(heading_point);
+
+#endif
+
+        // Draw polynomial curve
+        for (int i = 0; i < path_polynomial_approximation.size() - 1; i++) {
+            line(original_frame, path_polynomial_approximation[i], path_polynomial_approximation[i + 1], Scalar(255, 0, 255), settings->HEADING_LINE_THICKNESS, CV_AA);
+        }
+
+        // Draw line between current location and heading point
+        line(original_frame, frame.emily_location, heading_point, Scalar(255, 255, 0), settings->HEADING_LINE_THICKNESS, 8, 0);
+
+    }
+
+#ifdef INVERSE_PERSPECTIVE_WARP
+
+    // Overhead view with everything drawn so far
+    if (settings->perspective_overlay && !settings->headless) {
+        Mat overhead_frame;
+        undistort->warp_to_ground(original_frame, overhead_frame);
+        user_interface->show_overhead(overhead_frame);
+    }
+
+#endif
+
+    ////////////////////////////////////////////////////////////////////////
+    // Show results
+    ////////////////////////////////////////////////////////////////////////
+
+    // Simple blob detector
+    ////////////////////////////////////////////////////////////////////////
+
+    //        drawKeypoints(original_frame, keypoints, original_frame, Scalar(0,0,255), DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+    //        
+    //        userInterface->show_main(original_frame);
+
+    // Contours
+    ////////////////////////////////////////////////////////////////////////
+
+    //        for(int contour = 0; contour >= 0; contour = hierarchy[contour][0]) {
+    //            drawContours(original_frame, contours, contour, Scalar(255, 0, 0), CV_FILLED, 8, hierarchy);
+    //        }
+    //        
+    //        userInterface->show_main(original_frame);
+
+    // Threshold
+    ////////////////////////////////////////////////////////////////////////
+
+    //        userInterface->show_main(threshold);
+
+    // Original image
+    ////////////////////////////////////////////////////////////////////////
+
+    //        userInterface->show_main(original_frame);
+
+    // Main Window
+    ////////////////////////////////////////////////////////////////////////
+
+    // Show target location
+    user_interface->draw_target(original_frame, frame.target_location);
+
+    // Get status as a string message
+    user_interface->print_status(original_frame, frame.status, frame.time_to_target);
+
+    if (settings->publish_frames) {
+
+        // Viewer in another process shows the frame
+        publish_frame(frame);
+
+    } else if (!settings->headless) {
+
+        // Show the frame in the main window
+        show_output(frame);
+
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+    // Video output
+    ////////////////////////////////////////////////////////////////////////
+
+    // Write the frame to the output video
+    {
+        TraceScope record_scope("Record");
+        output_video->record(original_frame);
+    }
+
+    ////////////////////////////////////////////////////////////////////////
+    // Quantitative analysis
+    ////////////////////////////////////////////////////////////////////////
+
+#ifdef ANALYSIS
+
+    // The objective of this test is to select EMILY and then keep the
+    // cursor in EMILY's center. The program will compute distance error
+    // between the cursor and tracked location.
+
+    // Only compute the error if object is selected
+
+#ifdef CAMSHIFT
+    if (object_selected) {
+#endif
+
+        // Compute distance of EMILY from the cursor
+        double distance_error = sqrt(pow(frame.emily_location.x - mouse_location.x, 2) + pow(frame.emily_location.y - mouse_location.y, 2));
+
+        // Log the distance error
+        error_log_file << distance_error << endl;
+
+#ifdef CAMSHIFT
+    }
+#endif
+
+#endif
+
+    render_counters.stop(original_frame.total());
+
+    record_stage_time(render_statistics, stage_start);
+}
+
+/**
+ * Signal handler. Stops the processing the same way as the quit command.
+ *
+ * @param signal_number
+ */
+void on_signal(int signal_number) {
+    quit_requested = true;
+}
+
+/**
+ * Print command line usage.
+ *
+ * @param program_name
+ */
+void print_usage(char* program_name) {
+    cout << "Usage: " << program_name << " [options]" << endl;
+    cout << "  --headless              run without any windows" << endl;
+    cout << "  --viewer                publish frames to shared memory for emily_viewer" << endl;
+    cout << "  --input <source>        video file, stream URL or camera index" << endl;
+    cout << "  --input synthetic[:<trajectory>]" << endl;
+    cout << "                          rendered scene with the hull on a circle, figure8, line" << endl;
+    cout << "                          or waypoints:x,y,x,y,... in meters" << endl;
+    cout << "  --pyramid <levels>      track coarse to fine using given number of pyramid levels" << endl;
+    cout << "  --search-region         process only a region around the tracked object, full frames" << endl;
+    cout << "                          only to acquire it again" << endl;
+    cout << "  --blur <gaussian|box>   blur engine, box is faster for large kernels" << endl;
+    cout << "  --perf                  count cycles, instructions and cache misses of the stages" << endl;
+    cout << "  --trace                 record timeline of the stages for chrome://tracing" << endl;
+    cout << "  --cache                 decode the video once into a frame cache reused by later runs" << endl;
+    cout << "  --replay                process a video file as fast as possible with time given by frame numbers" << endl;
+    cout << "  --output <name>         base name of the output video and logs instead of the date and time" << endl;
+    cout << "  --paced <profile>       play a video file like a live stream over clean, rtmp or mirror link" << endl;
+    cout << "  --command-rate <hz>     send commands at a fixed rate instead of once per frame" << endl;
+    cout << "  --select <x,y,w,h>      object of interest in the first frame" << endl;
+    cout << "  --target <x,y>          target location" << endl;
+    cout << "In headless mode, select, target, clear, pause and quit commands are" << endl;
+    cout << "read from the standard input, e.g. \"target 320 240\"." << endl;
+}
+
+/**
+ * Parse command line arguments.
+ *
+ * @param argc
+ * @param argv
+ * @param operator_commands commands for object selection and target given on the command line
+ * @return false if the arguments are not valid
+ */
+bool parse_arguments(int argc, char** argv, vector<string>& operator_commands) {
+
+    for (int i = 1; i < argc; i++) {
+
+        string argument = argv[i];
+
+        if (argument == "--headless") {
+
+            settings->headless = true;
+
+        } else if (argument == "--viewer") {
+
+            // Viewer runs in another process, so no windows here
+            settings->publish_frames = true;
+            settings->headless = true;
+
+        } else if (argument == "--pyramid" && i + 1 < argc) {
+
+            settings->pyramid_levels = atoi(argv[++i]);
+
+        } else if (argument == "--search-region") {
+
+            settings->search_region_enabled = true;
+
+        } else if (argument == "--blur" && i + 1 < argc) {
+
+            settings->blur_engine = string(argv[++i]) == "box" ? BLUR_BOX : BLUR_GAUSSIAN;
+
+        } else if (argument == "--perf") {
+
+            settings->perf_counters = true;
+
+        } else if (argument == "--trace") {
+
+            settings->trace = true;
+
+        } else if (argument == "--cache") {
+
+            settings->frame_cache = true;
+
+        } else if (argument == "--replay") {
+
+            // Nothing paces the processing without windows
+            settings->replay = true;
+            settings->headless = true;
+
+        } else if (argument == "--output" && i + 1 < argc) {
+
+            settings->output_name = argv[++i];
+
+        } else if (argument == "--command-rate" && i + 1 < argc) {
+
+            settings->command_rate = atof(argv[++i]);
+
+        } else if (argument == "--paced" && i + 1 < argc) {
+
+            settings->paced_source = true;
+
+            if (!PacedSource::set_profile(argv[++i], * settings)) {
+                return false;
+            }
+
+        } else if (argument == "--input" && i + 1 < argc) {
+
+            settings->video_capture_source = argv[++i];
+
+        } else if ((argument == "--select" || argument == "--target") && i + 1 < argc) {
+
+            // Same format as the console command, only separated by commas
+            string values = argv[++i];
+            replace(values.begin(), values.end(), ',', ' ');
+            operator_commands.push_back(argument.substr(2) + " " + values);
+
+        } else {
+
+            return false;
+
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Open the video input. Source "synthetic" optionally followed by a colon and
+ * a trajectory is a rendered scene, anything else a video, which is read
+ * through the frame cache if it is enabled.
+ *
+ * @return true if the video input was opened
+ */
+bool open_frame_source() {
+
+    string& source = settings->video_capture_source;
+
+    if (source.compare(0, 9, "synthetic") == 0 && (source.size() == 9 || source[9] == ':')) {
+        synthetic_source = new SyntheticSource(* settings);
+        frame_source = synthetic_source;
+        return synthetic_source->open(source.size() > 9 ? source.substr(10) : "");
+    }
+
+    // Decoded frames of video files are reused from the previous runs
+    if (settings->frame_cache) {
+
+        frame_cache = FrameCache::open_video(source, * settings);
+
+        if (frame_cache != NULL) {
+            frame_source = frame_cache;
+            return true;
+        }
+
+        cerr << "Reading " << source << " without the frame cache." << endl;
+    }
+
+    VideoSource * video_source = new VideoSource();
+    frame_source = video_source;
+    return video_source->open(source);
+}
+
+/**
+ * Write values of a matrix of doubles separated by spaces.
+ *
+ * @param stream
+ * @param matrix
+ */
+void write_matrix(ostream& stream, const Mat& matrix) {
+    for (int i = 0; i < matrix.rows; i++) {
+        for (int j = 0; j < matrix.cols; j++) {
+            stream << (i + j > 0 ? " " : "") << matrix.at<double>(i, j);
+        }
+    }
+}
+
+/**
+ * Get text describing the mission for the log header. Contains the video
+ * source, settings of the algorithm and camera calibration as "key = value"
+ * lines.
+ *
+ * @param input_video_fps
+ * @return
+ */
+string get_mission_metadata(double input_video_fps) {
+
+    ostringstream metadata;
+    metadata << setprecision(17);
+
+    // Video
+    metadata << "video_source = " << settings->video_capture_source << "\n";
+    metadata << "video_fps = " << input_video_fps << "\n";
+    metadata << "replay = " << settings->replay << "\n";
+    if (paced_source != NULL) {
+        metadata << "paced_source = jitter " << settings->paced_jitter << " burst " << settings->paced_burst_probability << " " << settings->paced_burst_frames << " stall " << settings->paced_stall_probability << " " << settings->paced_stall_time << " seed " << settings->paced_seed << "\n";
+    }
+    metadata << "video_size = " << resized_video_size.width << "x" << resized_video_size.height << "\n";
+
+    // Rendered scene
+    if (synthetic_source != NULL) {
+        metadata << "synthetic_altitude = " << settings->synthetic_altitude << "\n";
+        metadata << "synthetic_field_of_view = " << settings->synthetic_field_of_view << "\n";
+        metadata << "synthetic_camera_angle = " << settings->synthetic_camera_angle << "\n";
+        metadata << "synthetic_speed = " << settings->synthetic_speed << "\n";
+        metadata << "synthetic_noise = " << settings->synthetic_noise << "\n";
+        metadata << "synthetic_seed = " << settings->synthetic_seed << "\n";
+    }
+
+    // Algorithm
+#ifdef CAMSHIFT
+    metadata << "tracker = camshift\n";
+#else
+    metadata << "tracker = threshold\n";
+#endif
+    metadata << "hue_1 = " << settings->hue_1_min << " " << settings->hue_1_max << "\n";
+    metadata << "hue_2 = " << settings->hue_2_min << " " << settings->hue_2_max << "\n";
+    metadata << "saturation = " << settings->saturation_min << " " << settings->saturation_max << "\n";
+    metadata << "value = " << settings->value_min << " " << settings->value_max << "\n";
+    metadata << "blur_kernel_size = " << settings->blur_kernel_size << "\n";
+    metadata << "blur_engine = " << (settings->blur_engine == BLUR_BOX ? "box" : "gaussian") << "\n";
+    metadata << "erode_size = " << settings->erode_size << "\n";
+    metadata << "dilate_size = " << settings->dilate_size << "\n";
+    metadata << "search_region = " << settings->search_region_enabled << "\n";
+    metadata << "pyramid_levels = " << settings->pyramid_levels << "\n";
+    metadata << "target_radius = " << settings->target_radius << "\n";
+    metadata << "proportional = " << settings->proportional << "\n";
+    metadata << "command_rate = " << (settings->replay ? 0 : settings->command_rate) << "\n";
+    metadata << "command_timeout = " << settings->command_timeout << "\n";
+
+    // Calibration
+#ifdef INVERSE_PERSPECTIVE_WARP
+    metadata << "perspective_correction = 1\n";
+#else
+    metadata << "perspective_correction = 0\n";
+#endif
+    metadata << "camera_angle_degrees = " << settings->camera_angle_degrees << "\n";
+    metadata << "lens_undistortion = " << settings->lens_undistortion << "\n";
+    metadata << "camera_intrinsic_matrix = ";
+    write_matrix(metadata, settings->camera_intrinsic_matrix);
+    metadata << "\n";
+    metadata << "camera_distortion_vector = ";
+    write_matrix(metadata, settings->camera_distortion_vector);
+    metadata << "\n";
+
+    return metadata.str();
+}
+
+/**
+ * Autonomously navigate the USV based on the UAV video feed to reach the target.
+ */
+int main(int argc, char** argv) {
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Command line
+    ////////////////////////////////////////////////////////////////////////////
+
+    vector<string> operator_commands;
+
+    if (!parse_arguments(argc, argv, operator_commands)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (!open_frame_source()) {
+        cerr << "Cannot open video input " << settings->video_capture_source << endl;
+        return 1;
+    }
+
+    // Video file played like a live stream
+    if (settings->paced_source) {
+
+        if (frame_source->is_live() || settings->replay) {
+            cerr << "Only video files can be paced and not in replay mode." << endl;
+            return 1;
+        }
+
+        paced_source = new PacedSource(* frame_source, * settings);
+        frame_source = paced_source;
+    }
+
+    // Frames of a live stream cannot be replayed in their own time
+    if (settings->replay && frame_source->is_live()) {
+        cerr << "Replay needs a video file, " << settings->video_capture_source << " is live." << endl;
+        return 1;
+    }
+
+    // Stop cleanly on Ctrl+C so that the output video and logs are closed
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Output video initialization
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Get FPS of the input video
+    input_video_fps = get_input_video_fps();
+
+    // Inogeni for some reason cannot correctly estimate the FPS.
+    // Therefore we use FPS equal to 7 which is approximate frequency of this algorithm.
+#ifdef INOGENI
+
+    input_video_fps = 7;
+
+#endif
+
+    // Get the size of input video
+    get_input_video_size();
+
+    // Output video name. It is in format year_month_day_hour_minute_second.avi.
+    time_t raw_time;
+    time(&raw_time);
+    struct tm * local_time;
+    local_time = localtime(&raw_time);
+    char output_file_name[40];
+    strftime(output_file_name, 40, "output/%Y_%m_%d_%H_%M_%S", local_time);
+    string output_file_name_string(output_file_name);
+
+    if (!settings->output_name.empty()) {
+        output_file_name_string = settings->output_name;
+    }
+
+    output_video = new OutputVideo(*settings, input_video_fps, resized_video_size, output_file_name_string);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Log
+    ////////////////////////////////////////////////////////////////////////////
+
+    logger = new Logger(*settings, output_file_name_string, get_mission_metadata(input_video_fps));
+
+    // Exact pose of the hull in the rendered frames, for comparison with the log
+    if (synthetic_source != NULL) {
+        synthetic_source->write_ground_truth(output_file_name_string + "_ground_truth.txt");
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Trace
+    ////////////////////////////////////////////////////////////////////////////
+
+    Trace::set_thread_name("Render");
+
+    if (settings->perf_counters) {
+        render_counters.open();
+    }
+
+    if (settings->trace) {
+        Trace::start(output_file_name_string + "_trace.json", settings->TRACE_BUFFER_SIZE, settings->TRACE_WRITE_INTERVAL);
+    }
+
+#ifdef ANALYSIS
+
+    // Open error log file
+    error_log_file.open(output_file_name_string + "_error.txt");
+
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////
+    // GUI
+    ////////////////////////////////////////////////////////////////////////////
+
+    user_interface = new UserInterface(* settings, resized_video_size);
+
+    // Visualization of histogram
+    histogram_image = Mat::zeros(200, 320, CV_8UC3);
+
+    // Object of interest and target given on the command line
+    for (int i = 0; i < operator_commands.size(); i++) {
+        if (!ConsoleInput::execute(operator_commands[i], resized_video_size)) {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Frames are shown by the viewer in another process
+    if (settings->publish_frames) {
+
+        // Frames are not resized yet, so the input size is the largest possible
+        Size input_video_size = frame_source->get_size();
+        Size max_frame_size(max(input_video_size.width, resized_video_size.width), max(input_video_size.height, resized_video_size.height));
+
+        shared_frames = new SharedFrames(settings->SHARED_FRAMES_NAME, max_frame_size, settings->SHARED_FRAMES_SLOTS);
+
+        if (!shared_frames->is_open()) {
+            cerr << "Cannot create shared memory " << settings->SHARED_FRAMES_NAME << endl;
+            return 1;
+        }
+    }
+
+    // Without GUI the operator input comes from the console. Replay takes it
+    // only from the command line, console input would arrive at frames
+    // depending on timing.
+    if (settings->headless && !settings->replay) {
+        console_input = new ConsoleInput(resized_video_size);
+        console_input->start();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Initialization of communication
+    ////////////////////////////////////////////////////////////////////////////
+
+    communication = new Communication(settings->IP_ADDRESS, settings->PORT);
+
+    // Time of a frame is not the clock in replay mode, so commands cannot be
+    // sent in real time
+    if (settings->command_rate > 0 && !settings->replay) {
+        command_thread = new CommandThread(* communication, * settings);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Initialization of camera distortion parameters
+    ////////////////////////////////////////////////////////////////////////////
+
+#ifdef INVERSE_PERSPECTIVE_WARP
+    undistort = new Undistort(* settings, resized_video_size);
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Tracking
+    ////////////////////////////////////////////////////////////////////////////
+
+    tracker = new Tracker(* settings);
+
+#ifdef WAIT_FOR_OBJECT_SELECTION
+
+    // Always read the first frame so that the object of interest can be
+    // selected. First frame has to be stored in its own variable because the
+    // algorithm draws into original_frame and therefore it cannot be reused
+    // in the next iteration.
+    frame_source->read(first_frame);
+    frame_number++;
+
+#endif
+
+    // Read the following frames on a separate thread so that the decoding
+    // does not wait for the processing
+    capture_thread = new CaptureThread(* frame_source, * settings, frame_number + 1);
+    capture_thread->start();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Pipeline
+    ////////////////////////////////////////////////////////////////////////////
+
+    track_queue = new BoundedQueue<PipelineFrame>(settings->PIPELINE_QUEUE_SIZE);
+
+    if (settings->replay) {
+        replay_handshake = new BoundedQueue<long>(1);
+    }
+    control_queue = new BoundedQueue<PipelineFrame>(settings->PIPELINE_QUEUE_SIZE);
+    render_queue = new BoundedQueue<PipelineFrame>(settings->PIPELINE_QUEUE_SIZE, QUEUE_KEEP_LATEST);
+
+    running = true;
+
+    thread preprocess_thread(preprocess_stage);
+    thread track_thread(track_stage);
+    thread control_thread(control_stage);
+    if (command_thread != NULL) {
+        command_thread->start();
+    }
+    output_video->start();
+
+    // Time when the pipeline statistics were printed
+    chrono::steady_clock::time_point statistics_time = chrono::steady_clock::now();
+
+    // Render processed frames and handle user input until the video input
+    // ends, escape is pressed or quit is requested
+    PipelineFrame frame;
+
+    while (!quit_requested) {
+
+        // Without GUI there are no events to handle, so wait longer for frames
+        if (render_queue->pop_for(frame, settings->headless ? 100 : 10)) {
+
+            // Show the frame
+            render(frame);
+
+        } else if (render_queue->is_closed()) {
+
+            // Pipeline finished
+            break;
+
+        }
+
+        // Print pipeline statistics
+        if (chrono::steady_clock::now() - statistics_time > chrono::seconds(settings->PIPELINE_STATISTICS_INTERVAL)) {
+            print_pipeline_statistics();
+            statistics_time = chrono::steady_clock::now();
+        }
+
+        // Operator input from the viewer, not in replay for the same reason as
+        // the console
+        if (settings->publish_frames && !settings->replay) {
+            string command;
+            while (shared_frames->receive_command(command)) {
+                ConsoleInput::execute(command, resized_video_size);
+            }
+        }
+
+        // Operator input comes from the console in a separate thread
+        if (settings->headless) {
+            continue;
+        }
+
+#ifndef HEADLESS
+
+        char character;
+        {
+            TraceScope wait_key_scope("Wait key");
+            character = (char) waitKey(1);
+        }
+        if (character == 27)
+            break;
+
+#ifdef CAMSHIFT
+
+        switch (character) {
+            case 'b':
+
+                // Toggle back projection mode
+                back_projection_mode = !back_projection_mode;
+
+                break;
+            case 'c':
+
+                // Stop tracking
+                object_selected = 0;
+                histogram_image = Scalar::all(0);
+
+                break;
+            case 'p':
+
+                // Toggle pause
+                paused = !paused;
+
+                break;
+
+#ifdef INVERSE_PERSPECTIVE_WARP
+
+            case 'o':
+
+                // Toggle overhead view
+                settings->perspective_overlay = !settings->perspective_overlay;
+                if (!settings->perspective_overlay) {
+                    destroyWindow(settings->OVERHEAD_WINDOW);
+                }
+
+                break;
+
+#endif
+        }
+
+#endif
+
+#endif
+
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Shut down the pipeline
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Stop reading the video input. Each stage then finishes the frames in its
+    // queue and closes the queue of the next stage.
+    running = false;
+    capture_thread->stop();
+
+    preprocess_thread.join();
+    track_thread.join();
+    control_thread.join();
+
+    // Rendering has already finished, encode the remaining frames
+    output_video->stop();
+
+    Trace::stop();
+
+    print_pipeline_statistics();
+    delete capture_thread;
+    delete frame_source;
+    delete output_video;
+
+    if (settings->headless && !settings->replay) {
+        delete console_input;
+    }
+
+    if (settings->publish_frames) {
+        delete shared_frames;
+    }
+
+    // Close logs
+    logger->add_metadata(get_latency_metadata());
+    delete logger;
+
+    // Stop EMILY and close communication
+    delete command_thread;
+    delete communication;
+
+    // Announce that the processing was finished
+    cout << "Processing finished!" << endl;
+
+    // Clean return
+    return 0;
+}
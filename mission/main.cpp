@@ -0,0 +1,522 @@
+/**
+ * @file    main.cpp
+ * @author  Jan Dufek
+ *
+ * Reader of mission logs (.mission) written by EMILY Tracker. Mission logs are
+ * columnar and memory mapped, so aggregating one quantity over a whole season
+ * of missions reads only that column of each file.
+ *
+ * emily_mission info FILE...
+ *     Print metadata, columns and number of rows.
+ *
+ * emily_mission stats [--column NAME]... PATH...
+ *     Print count, minimum, maximum, mean and standard deviation of the
+ *     columns over all missions. Directories are searched recursively for
+ *     .mission files, which are processed in parallel. Latencies which were
+ *     not measured are not counted.
+ *
+ * emily_mission csv [--column NAME]... FILE
+ *     Export the columns of one mission to CSV on the standard output.
+ *
+ * emily_mission convert FILE.log...
+ *     Convert binary logs, for example of missions that did not finish
+ *     cleanly, to mission logs.
+ *
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "MissionLog.hpp"
+
+using namespace std;
+
+// Statistics of one column. Mean and sum of squared differences from the mean
+// are merged pairwise, which stays accurate for large values like timestamps.
+struct ColumnStatistics {
+    long count = 0;
+    double min = numeric_limits<double>::max();
+    double max = -numeric_limits<double>::max();
+    double mean = 0;
+    double squared_differences = 0;
+};
+
+// Statistics of a set of missions
+struct MissionStatistics {
+    long missions = 0;
+    long rows = 0;
+    double duration = 0;
+    vector<ColumnStatistics> columns;
+};
+
+/**
+ * Print usage.
+ *
+ * @param name
+ */
+void print_usage(const char * name) {
+    cout << "Usage:" << endl;
+    cout << "  " << name << " info FILE..." << endl;
+    cout << "  " << name << " stats [--column NAME]... PATH..." << endl;
+    cout << "  " << name << " csv [--column NAME]... FILE" << endl;
+    cout << "  " << name << " convert FILE.log..." << endl;
+}
+
+/**
+ * Check if string ends with given suffix.
+ *
+ * @param text
+ * @param suffix
+ * @return
+ */
+bool ends_with(const string& text, const string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/**
+ * Add mission log files found at the path. Directories are searched
+ * recursively.
+ *
+ * @param path
+ * @param files
+ */
+void collect_files(string path, vector<string>& files) {
+
+    struct stat path_status;
+    if (stat(path.c_str(), &path_status) != 0) {
+        cerr << "Cannot access " << path << "." << endl;
+        return;
+    }
+
+    if (!S_ISDIR(path_status.st_mode)) {
+        files.push_back(path);
+        return;
+    }
+
+    DIR * directory = opendir(path.c_str());
+    if (directory == NULL) {
+        cerr << "Cannot open directory " << path << "." << endl;
+        return;
+    }
+
+    vector<string> entries;
+    struct dirent * entry;
+    while ((entry = readdir(directory)) != NULL) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            entries.push_back(path + "/" + entry->d_name);
+        }
+    }
+    closedir(directory);
+
+    sort(entries.begin(), entries.end());
+
+    for (int i = 0; i < entries.size(); i++) {
+
+        struct stat entry_status;
+        if (stat(entries[i].c_str(), &entry_status) != 0) {
+            continue;
+        }
+
+        if (S_ISDIR(entry_status.st_mode)) {
+            collect_files(entries[i], files);
+        } else if (ends_with(entries[i], ".mission")) {
+            files.push_back(entries[i]);
+        }
+    }
+}
+
+/**
+ * Add statistics of another set of values to the column statistics.
+ *
+ * @param statistics
+ * @param other
+ */
+void merge_column(ColumnStatistics& statistics, const ColumnStatistics& other) {
+
+    if (other.count == 0) {
+        return;
+    }
+
+    long count = statistics.count + other.count;
+    double delta = other.mean - statistics.mean;
+
+    statistics.mean += delta * other.count / count;
+    statistics.squared_differences += other.squared_differences + delta * delta * statistics.count * other.count / count;
+    statistics.count = count;
+    statistics.min = min(statistics.min, other.min);
+    statistics.max = max(statistics.max, other.max);
+}
+
+/**
+ * Add values to the column statistics.
+ *
+ * @param values
+ * @param count
+ * @param skip_not_measured skip values equal to LATENCY_NOT_MEASURED
+ * @param statistics
+ */
+template <class T>
+void accumulate_values(const T * values, long count, bool skip_not_measured, ColumnStatistics& statistics) {
+
+    ColumnStatistics mission;
+
+    // Mean first, then squared differences from it
+    double min = mission.min;
+    double max = mission.max;
+    double sum = 0;
+    long measured = 0;
+
+    for (long i = 0; i < count; i++) {
+        double value = (double) values[i];
+        if (skip_not_measured && value == LATENCY_NOT_MEASURED) {
+            continue;
+        }
+        min = value < min ? value : min;
+        max = value > max ? value : max;
+        sum += value;
+        measured++;
+    }
+
+    if (measured == 0) {
+        return;
+    }
+
+    double mean = sum / measured;
+    double squared_differences = 0;
+
+    for (long i = 0; i < count; i++) {
+        double value = (double) values[i];
+        if (skip_not_measured && value == LATENCY_NOT_MEASURED) {
+            continue;
+        }
+        double difference = value - mean;
+        squared_differences += difference * difference;
+    }
+
+    mission.count = measured;
+
+    mission.min = min;
+    mission.max = max;
+    mission.mean = mean;
+    mission.squared_differences = squared_differences;
+
+    merge_column(statistics, mission);
+}
+
+/**
+ * Add the columns of one mission to the statistics.
+ *
+ * @param log
+ * @param column_names
+ * @param statistics
+ */
+void accumulate_mission(MissionLog& log, const vector<string>& column_names, MissionStatistics& statistics) {
+
+    long rows = log.get_row_count();
+
+    statistics.missions++;
+    statistics.rows += rows;
+
+    int time_column = log.find_column("time");
+    if (time_column >= 0 && rows > 1) {
+        statistics.duration += (log.get_value(time_column, rows - 1) - log.get_value(time_column, 0)) / 1e6;
+    }
+
+    for (int i = 0; i < column_names.size(); i++) {
+
+        int column = log.find_column(column_names[i]);
+        if (column < 0) {
+            continue;
+        }
+
+        const void * values = log.get_column_data(column);
+
+        // Latencies not measured, e.g. with the command thread
+        bool latency = ends_with(column_names[i], "_latency");
+
+        switch (log.get_column(column).type) {
+            case COLUMN_INT32:
+                accumulate_values((const int32_t *) values, rows, latency, statistics.columns[i]);
+                break;
+            case COLUMN_INT64:
+                accumulate_values((const int64_t *) values, rows, latency, statistics.columns[i]);
+                break;
+            default:
+                accumulate_values((const double *) values, rows, latency, statistics.columns[i]);
+                break;
+        }
+    }
+}
+
+/**
+ * Add statistics of another set of missions.
+ *
+ * @param statistics
+ * @param other
+ */
+void merge_statistics(MissionStatistics& statistics, const MissionStatistics& other) {
+
+    statistics.missions += other.missions;
+    statistics.rows += other.rows;
+    statistics.duration += other.duration;
+
+    for (int i = 0; i < statistics.columns.size(); i++) {
+        merge_column(statistics.columns[i], other.columns[i]);
+    }
+}
+
+/**
+ * Print metadata and columns of mission logs.
+ *
+ * @param files
+ * @return exit code
+ */
+int info(const vector<string>& files) {
+
+    int result = 0;
+
+    for (int i = 0; i < files.size(); i++) {
+
+        MissionLog log;
+        if (!log.open(files[i])) {
+            result = 1;
+            continue;
+        }
+
+        cout << files[i] << ": " << log.get_row_count() << " rows" << endl;
+        cout << log.get_metadata();
+
+        for (int j = 0; j < log.get_column_count(); j++) {
+            const MissionLogColumn& column = log.get_column(j);
+            cout << "  " << setw(24) << left << column.name << setw(8) << column.unit << right << (column.type == COLUMN_FLOAT64 ? "float64" : column.type == COLUMN_INT64 ? "int64" : "int32") << endl;
+        }
+
+        cout << endl;
+    }
+
+    return result;
+}
+
+/**
+ * Print statistics of the columns over all missions.
+ *
+ * @param paths
+ * @param column_names columns to aggregate, all if empty
+ * @return exit code
+ */
+int stats(const vector<string>& paths, vector<string> column_names) {
+
+    vector<string> files;
+    for (int i = 0; i < paths.size(); i++) {
+        collect_files(paths[i], files);
+    }
+
+    if (files.empty()) {
+        cerr << "No mission logs found." << endl;
+        return 1;
+    }
+
+    // All columns of the first mission
+    if (column_names.empty()) {
+        MissionLog log;
+        if (!log.open(files[0])) {
+            return 1;
+        }
+        for (int i = 0; i < log.get_column_count(); i++) {
+            column_names.push_back(log.get_column(i).name);
+        }
+    }
+
+    MissionStatistics statistics;
+    statistics.columns.resize(column_names.size());
+
+    atomic<int> next_file(0);
+    atomic<int> failed_files(0);
+    mutex statistics_mutex;
+
+    // Each thread takes files one by one and merges its statistics at the end
+    auto worker = [&]() {
+
+        MissionStatistics thread_statistics;
+        thread_statistics.columns.resize(column_names.size());
+
+        int i;
+        while ((i = next_file++) < (int) files.size()) {
+
+            MissionLog log;
+            if (!log.open(files[i])) {
+                failed_files++;
+                continue;
+            }
+
+            accumulate_mission(log, column_names, thread_statistics);
+        }
+
+        lock_guard<mutex> lock(statistics_mutex);
+        merge_statistics(statistics, thread_statistics);
+    };
+
+    int thread_count = max(1, min((int) thread::hardware_concurrency(), (int) files.size()));
+    vector<thread> threads;
+    for (int i = 0; i < thread_count; i++) {
+        threads.push_back(thread(worker));
+    }
+    for (int i = 0; i < thread_count; i++) {
+        threads[i].join();
+    }
+
+    cout << statistics.missions << " missions, " << statistics.rows << " rows, " << fixed << setprecision(1) << statistics.duration / 3600 << " hours";
+    if (failed_files > 0) {
+        cout << ", " << failed_files << " files skipped";
+    }
+    cout << endl;
+
+    cout.unsetf(ios::floatfield);
+    cout << setprecision(6);
+    cout << setw(24) << left << "column" << right << setw(12) << "count" << setw(14) << "min" << setw(14) << "max" << setw(14) << "mean" << setw(14) << "std" << endl;
+
+    for (int i = 0; i < column_names.size(); i++) {
+
+        ColumnStatistics& column = statistics.columns[i];
+
+        cout << setw(24) << left << column_names[i] << right << setw(12) << column.count;
+
+        if (column.count == 0) {
+            cout << endl;
+            continue;
+        }
+
+        cout << setw(14) << column.min << setw(14) << column.max << setw(14) << column.mean << setw(14) << sqrt(column.squared_differences / column.count) << endl;
+    }
+
+    return failed_files > 0 ? 1 : 0;
+}
+
+/**
+ * Export the columns of one mission to CSV.
+ *
+ * @param file
+ * @param column_names columns to export, all if empty
+ * @return exit code
+ */
+int csv(string file, const vector<string>& column_names) {
+
+    MissionLog log;
+    if (!log.open(file)) {
+        return 1;
+    }
+
+    vector<int> columns;
+    if (column_names.empty()) {
+        for (int i = 0; i < log.get_column_count(); i++) {
+            columns.push_back(i);
+        }
+    } else {
+        for (int i = 0; i < column_names.size(); i++) {
+            int column = log.find_column(column_names[i]);
+            if (column < 0) {
+                cerr << "Mission log " << file << " has no column " << column_names[i] << "." << endl;
+                return 1;
+            }
+            columns.push_back(column);
+        }
+    }
+
+    ios::sync_with_stdio(false);
+    cout << setprecision(10);
+
+    for (int i = 0; i < columns.size(); i++) {
+        cout << (i > 0 ? "," : "") << log.get_column(columns[i]).name;
+    }
+    cout << "\n";
+
+    for (long row = 0; row < log.get_row_count(); row++) {
+        for (int i = 0; i < columns.size(); i++) {
+            if (i > 0) {
+                cout << ",";
+            }
+            if (log.get_column(columns[i]).type == COLUMN_INT64) {
+                cout << ((const int64_t *) log.get_column_data(columns[i]))[row];
+            } else {
+                cout << log.get_value(columns[i], row);
+            }
+        }
+        cout << "\n";
+    }
+
+    return 0;
+}
+
+/**
+ * Convert binary logs to mission logs next to them.
+ *
+ * @param files
+ * @return exit code
+ */
+int convert(const vector<string>& files) {
+
+    int result = 0;
+
+    for (int i = 0; i < files.size(); i++) {
+
+        string name = ends_with(files[i], ".log") ? files[i].substr(0, files[i].size() - 4) : files[i];
+
+        if (MissionLog::convert(files[i], name + ".mission")) {
+            cout << name << ".mission" << endl;
+        } else {
+            result = 1;
+        }
+    }
+
+    return result;
+}
+
+int main(int argc, char** argv) {
+
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    string command = argv[1];
+
+    vector<string> column_names;
+    vector<string> files;
+
+    for (int i = 2; i < argc; i++) {
+        string argument = argv[i];
+        if (argument == "--column" && i + 1 < argc) {
+            column_names.push_back(argv[++i]);
+        } else {
+            files.push_back(argument);
+        }
+    }
+
+    if (files.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (command == "info") {
+        return info(files);
+    } else if (command == "stats") {
+        return stats(files, column_names);
+    } else if (command == "csv" && files.size() == 1) {
+        return csv(files[0], column_names);
+    } else if (command == "convert") {
+        return convert(files);
+    }
+
+    print_usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file    main.cpp
+ * @author  Jan Dufek
+ *
+ * Viewer for EMILY Tracker running with --viewer. Shows frames the tracker
+ * publishes to shared memory and sends object selections and targets back.
+ * The tracker never waits for the viewer, so a slow or frozen viewer does not
+ * affect tracking or the commands sent to EMILY.
+ *
+ */
+
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+#include "SharedFrames.hpp"
+
+using namespace cv;
+using namespace std;
+
+Settings * settings = new Settings();
+
+// Shared memory with frames
+SharedFrames * shared_frames;
+
+// Size of the last shown frame
+Size video_size;
+
+// Select object flag
+bool select_object = false;
+
+// Object selection
+Rect selection;
+
+// Original point of click
+Point origin;
+
+/**
+ * Mouse handler. Same controls as in the tracker GUI: right drag to select
+ * EMILY, left double click to choose target.
+ *
+ * @param event
+ * @param x
+ * @param y
+ * @param flags
+ */
+void on_mouse(int event, int x, int y, int flags, void*) {
+
+    // Select object mode
+    if (select_object) {
+
+        // Get selected rectangle
+        selection.x = MIN(x, origin.x);
+        selection.y = MIN(y, origin.y);
+        selection.width = abs(x - origin.x);
+        selection.height = abs(y - origin.y);
+
+        // Get intersection with the frame
+        selection &= Rect(0, 0, video_size.width, video_size.height);
+    }
+
+    ostringstream command;
+
+    switch (event) {
+
+        case EVENT_RBUTTONDOWN:
+
+            // Save current point as click origin
+            origin = Point(x, y);
+
+            // Initialize rectangle
+            selection = Rect(x, y, 0, 0);
+
+            // Start selection
+            select_object = true;
+
+            break;
+
+        case EVENT_RBUTTONUP:
+
+            // End selection
+            select_object = false;
+
+            // If the selection has been made, send it to the tracker
+            if (selection.width > 0 && selection.height > 0) {
+                command << "select " << selection.x << " " << selection.y << " " << selection.width << " " << selection.height;
+            }
+
+            break;
+
+        case EVENT_LBUTTONDBLCLK:
+
+            // Send location of the target
+            command << "target " << x << " " << y;
+
+            break;
+    }
+
+    if (!command.str().empty() && !shared_frames->send_command(command.str())) {
+        cerr << "Tracker is not reading commands" << endl;
+    }
+}
+
+/**
+ * Show frames published by the tracker until the tracker exits or escape is
+ * pressed.
+ */
+int main(int argc, char** argv) {
+
+    // Wait for the tracker to create the shared memory
+    shared_frames = new SharedFrames(settings->SHARED_FRAMES_NAME);
+    while (!shared_frames->is_open()) {
+        cout << "Waiting for EMILY Tracker..." << endl;
+        this_thread::sleep_for(chrono::seconds(1));
+        delete shared_frames;
+        shared_frames = new SharedFrames(settings->SHARED_FRAMES_NAME);
+    }
+
+    namedWindow(settings->MAIN_WINDOW, CV_GUI_NORMAL);
+    namedWindow(settings->HISTOGRAM_WINDOW, 0);
+    setMouseCallback(settings->MAIN_WINDOW, on_mouse, 0);
+
+    Mat frame;
+    Mat histogram_image;
+    SharedFrameState state;
+
+    // Last frame and histogram read from the shared memory
+    uint64_t last_frame = 0;
+    uint64_t last_histogram = 0;
+
+    while (shared_frames->is_writer_active()) {
+
+        if (shared_frames->read_latest(frame, state, last_frame)) {
+
+            video_size = frame.size();
+
+            // Show the selection
+            if (select_object && selection.width > 0 && selection.height > 0) {
+                Mat roi(frame, selection & Rect(0, 0, frame.cols, frame.rows));
+                bitwise_not(roi, roi);
+            }
+
+            imshow(settings->MAIN_WINDOW, frame);
+        }
+
+        if (shared_frames->read_histogram(histogram_image, last_histogram)) {
+            imshow(settings->HISTOGRAM_WINDOW, histogram_image);
+        }
+
+        char character = (char) waitKey(10);
+        if (character == 27)
+            break;
+
+        switch (character) {
+            case 'b':
+                shared_frames->send_command("backprojection");
+                break;
+            case 'c':
+                shared_frames->send_command("clear");
+                break;
+            case 'p':
+                shared_frames->send_command("pause");
+                break;
+        }
+    }
+
+    delete shared_frames;
+
+    return 0;
+}